@@ -0,0 +1,230 @@
+// Crawl benchmark driver.
+//
+// Starts bin/mockserver, waits for it to listen, runs bin/webcrawler
+// against the root page inside a scratch directory and reports throughput
+// together with the crawler's CPU time and peak RSS (from wait4). Page and
+// link totals come from the crawler's Prometheus textfile.
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define MAX_ARGS 64
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int wait_for_port(int port, double timeout)
+{
+    double deadline = now_seconds() + timeout;
+
+    while (now_seconds() < deadline)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr = {0};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        int ok = connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+        close(fd);
+        if (ok)
+            return 1;
+        usleep(50000);
+    }
+    return 0;
+}
+
+// Read one sample value from a Prometheus textfile
+static double read_metric(const char *path, const char *name)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return -1;
+
+    char line[512];
+    size_t len = strlen(name);
+    double value = -1;
+    while (fgets(line, sizeof(line), f))
+    {
+        if (strncmp(line, name, len) == 0 && line[len] == ' ')
+        {
+            value = atof(line + len + 1);
+            break;
+        }
+    }
+    fclose(f);
+    return value;
+}
+
+static void print_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [options] [-- mockserver options]\n", prog);
+    fprintf(stderr, "  --port N           Mock server port (default 8900)\n");
+    fprintf(stderr, "  --workdir DIR      Directory the crawler runs in (default bench/run)\n");
+    fprintf(stderr, "  --crawler PATH     Crawler binary (default bin/webcrawler)\n");
+    fprintf(stderr, "  --server PATH      Mock server binary (default bin/mockserver)\n");
+    fprintf(stderr, "  --crawler-arg ARG  Extra crawler argument (repeatable)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int port = 8900;
+    const char *workdir = "bench/run";
+    const char *crawler = "bin/webcrawler";
+    const char *server = "bin/mockserver";
+    char *crawler_args[MAX_ARGS];
+    char *server_args[MAX_ARGS];
+    int crawler_argc = 0, server_argc = 0;
+    char port_str[16];
+
+    int i = 1;
+    for (; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--") == 0)
+        {
+            i++;
+            break;
+        }
+        if (i + 1 >= argc)
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--port") == 0)
+            port = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--workdir") == 0)
+            workdir = argv[++i];
+        else if (strcmp(argv[i], "--crawler") == 0)
+            crawler = argv[++i];
+        else if (strcmp(argv[i], "--server") == 0)
+            server = argv[++i];
+        else if (strcmp(argv[i], "--crawler-arg") == 0 && crawler_argc < MAX_ARGS - 4)
+            crawler_args[1 + crawler_argc++] = argv[++i];
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // Resolve binaries before changing directory for the crawler
+    char crawler_path[4096], server_path[4096], start_url[128];
+    if (!realpath(crawler, crawler_path) || !realpath(server, server_path))
+    {
+        fprintf(stderr, "benchrun: cannot find %s or %s (run make first)\n", crawler, server);
+        return 1;
+    }
+
+    snprintf(port_str, sizeof(port_str), "%d", port);
+    snprintf(start_url, sizeof(start_url), "http://127.0.0.1:%d/p/0.html", port);
+
+    server_args[server_argc++] = server_path;
+    server_args[server_argc++] = "--port";
+    server_args[server_argc++] = port_str;
+    for (; i < argc && server_argc < MAX_ARGS - 1; i++)
+        server_args[server_argc++] = argv[i];
+    server_args[server_argc] = NULL;
+
+    crawler_args[0] = crawler_path;
+    crawler_args[1 + crawler_argc++] = start_url;
+    crawler_args[1 + crawler_argc] = NULL;
+
+    pid_t server_pid = fork();
+    if (server_pid == 0)
+    {
+        execv(server_path, server_args);
+        perror("benchrun: exec mockserver");
+        _exit(127);
+    }
+    if (server_pid < 0 || !wait_for_port(port, 5.0))
+    {
+        fprintf(stderr, "benchrun: mock server did not start on port %d\n", port);
+        if (server_pid > 0)
+            kill(server_pid, SIGTERM);
+        return 1;
+    }
+
+    double start = now_seconds();
+    pid_t crawler_pid = fork();
+    if (crawler_pid == 0)
+    {
+        // Quiet run in the scratch directory; the log keeps the crawler's output
+        if (chdir(workdir) != 0)
+        {
+            perror("benchrun: chdir");
+            _exit(127);
+        }
+        int log = open("crawler.log", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (log >= 0)
+        {
+            dup2(log, STDOUT_FILENO);
+            dup2(log, STDERR_FILENO);
+            close(log);
+        }
+        execv(crawler_path, crawler_args);
+        _exit(127);
+    }
+
+    int status = 0;
+    struct rusage usage = {0};
+    if (crawler_pid < 0 || wait4(crawler_pid, &status, 0, &usage) < 0)
+    {
+        perror("benchrun: crawler");
+        kill(server_pid, SIGTERM);
+        return 1;
+    }
+    double elapsed = now_seconds() - start;
+
+    kill(server_pid, SIGTERM);
+    waitpid(server_pid, NULL, 0);
+
+    char prom_path[4096];
+    snprintf(prom_path, sizeof(prom_path), "%s/crawler.prom", workdir);
+    double pages = read_metric(prom_path, "crawler_pages_crawled_total");
+    double links = read_metric(prom_path, "crawler_links_found_total");
+    double errors = read_metric(prom_path, "crawler_errors_total");
+    double bytes = read_metric(prom_path, "crawler_bytes_downloaded_total");
+
+    double user = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+    double sys = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+
+    printf("\n=== Crawl Benchmark ===\n");
+    printf("Crawler exit status: %d\n", WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+    printf("Wall time:      %10.2f s\n", elapsed);
+    printf("Pages crawled:  %10.0f\n", pages);
+    printf("Links found:    %10.0f\n", links);
+    printf("Errors:         %10.0f\n", errors);
+    printf("Downloaded:     %10.1f MB\n", bytes / (1024 * 1024));
+    printf("Pages/s:        %10.2f\n", elapsed > 0 ? pages / elapsed : 0);
+    printf("Links/s:        %10.2f\n", elapsed > 0 ? links / elapsed : 0);
+    printf("CPU user/sys:   %10.2f s / %.2f s\n", user, sys);
+    printf("CPU per page:   %10.3f ms\n", pages > 0 ? (user + sys) * 1000 / pages : 0);
+    printf("Peak RSS:       %10.1f MB\n", usage.ru_maxrss / 1024.0);
+
+    // One line for scripts comparing runs
+    printf("BENCH wall=%.3f pages=%.0f links=%.0f errors=%.0f pages_per_s=%.3f links_per_s=%.3f "
+           "cpu_user=%.3f cpu_sys=%.3f max_rss_kb=%ld\n",
+           elapsed, pages, links, errors, elapsed > 0 ? pages / elapsed : 0,
+           elapsed > 0 ? links / elapsed : 0, user, sys, usage.ru_maxrss);
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : 1;
+}
@@ -0,0 +1,383 @@
+// Microbenchmarks for the per-link and per-chunk hot paths.
+//
+// Runs normalize_url, resolve_url, should_skip_url, robots_match,
+// write_callback and extract_links over the corpus in bench/corpus and
+// reports ns/op, heap
+// allocations per op and throughput. Allocations are counted by wrapping
+// the glibc allocator, so libxml2 and libc allocations are included.
+// Storage calls from extract_links go to a no-op backend.
+//
+// Each result is also printed as one "MICRO key=value ..." line so runs
+// can be compared between commits.
+
+#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <libxml/parser.h>
+#include "../include/config.h"
+#include "../include/crawler.h"
+#include "../include/storage.h"
+#include "../include/robots.h"
+#include "../include/log.h"
+
+#define MIN_BENCH_SECONDS 0.5
+#define CHUNK_SIZE 16384 // CURL_MAX_WRITE_SIZE, the largest chunk curl hands over
+
+// Allocation counting through glibc's underlying allocator
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static unsigned long alloc_count = 0;
+
+void *malloc(size_t size)
+{
+    __atomic_fetch_add(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    __atomic_fetch_add(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    __atomic_fetch_add(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    __libc_free(ptr);
+}
+
+// Storage that accepts everything and stores nothing
+static int stub_is_visited(const char *url)
+{
+    (void)url;
+    return 0;
+}
+
+static int stub_enqueue(const char *url, int depth)
+{
+    (void)url;
+    (void)depth;
+    return 0;
+}
+
+static void stub_link_batch(const char *source_url, const char *const *target_urls, int count)
+{
+    (void)source_url;
+    (void)target_urls;
+    (void)count;
+}
+
+static const StorageBackend stub_backend = {
+    .name = "microbench",
+    .enqueue = stub_enqueue,
+    .is_visited = stub_is_visited,
+    .link_batch = stub_link_batch,
+};
+
+typedef struct
+{
+    char **items;
+    int count;
+} LineList;
+
+typedef struct
+{
+    char *html;
+    size_t size;
+    char base_url[MAX_URL_LENGTH];
+} CorpusPage;
+
+static LineList urls, links;
+static CorpusPage pages[16];
+static int page_count = 0;
+static size_t corpus_bytes = 0;
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char *read_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return NULL;
+
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    char *data = malloc(len + 1);
+    if (data && fread(data, 1, len, f) == (size_t)len)
+    {
+        data[len] = '\0';
+        *size = len;
+    }
+    else
+    {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    return data;
+}
+
+// Non-comment lines of a corpus file
+static int load_lines(const char *dir, const char *name, LineList *out)
+{
+    char path[1024], line[MAX_URL_LENGTH * 2];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+    FILE *f = fopen(path, "r");
+    if (!f)
+    {
+        fprintf(stderr, "microbench: cannot read %s\n", path);
+        return 0;
+    }
+
+    int capacity = 0;
+    while (fgets(line, sizeof(line), f))
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '#' || line[0] == '\0')
+            continue;
+
+        if (out->count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 256;
+            out->items = realloc(out->items, capacity * sizeof(char *));
+        }
+        out->items[out->count++] = my_strdup(line);
+    }
+    fclose(f);
+    return out->count > 0;
+}
+
+static int load_pages(const char *dir)
+{
+    LineList manifest = {0};
+    if (!load_lines(dir, "pages.txt", &manifest))
+        return 0;
+
+    for (int i = 0; i < manifest.count && page_count < (int)(sizeof(pages) / sizeof(pages[0])); i++)
+    {
+        char *tab = strchr(manifest.items[i], '\t');
+        if (!tab)
+            continue;
+        *tab = '\0';
+
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/pages/%s", dir, manifest.items[i]);
+
+        CorpusPage *page = &pages[page_count];
+        page->html = read_file(path, &page->size);
+        if (!page->html)
+        {
+            fprintf(stderr, "microbench: cannot read %s\n", path);
+            return 0;
+        }
+        snprintf(page->base_url, sizeof(page->base_url), "%s", tab + 1);
+        corpus_bytes += page->size;
+        page_count++;
+    }
+    return page_count > 0;
+}
+
+// Accumulated per benchmark: one "op" is one call of the function under test
+typedef struct
+{
+    const char *name;
+    double seconds;
+    unsigned long ops;
+    unsigned long allocs;
+    double bytes; // Input bytes processed, for throughput
+} BenchResult;
+
+typedef void (*BenchPass)(BenchResult *result);
+
+static volatile long sink; // Keeps results observable to the optimizer
+
+static void pass_normalize_url(BenchResult *r)
+{
+    char buffer[MAX_URL_LENGTH];
+    for (int i = 0; i < urls.count; i++)
+    {
+        size_t len = strlen(urls.items[i]);
+        if (len >= sizeof(buffer))
+            continue;
+        memcpy(buffer, urls.items[i], len + 1);
+        normalize_url(buffer);
+        sink += buffer[0];
+        r->bytes += len;
+        r->ops++;
+    }
+}
+
+static void pass_resolve_url(BenchResult *r)
+{
+    for (int i = 0; i < links.count; i++)
+    {
+        char *tab = strchr(links.items[i], '\t');
+        if (!tab)
+            continue;
+
+        // Split "base<TAB>href" in place for the call
+        *tab = '\0';
+        char *resolved = resolve_url(links.items[i], tab + 1);
+        *tab = '\t';
+
+        if (resolved)
+            sink += resolved[0];
+        free(resolved);
+        r->bytes += strlen(tab + 1);
+        r->ops++;
+    }
+}
+
+static void pass_should_skip_url(BenchResult *r)
+{
+    for (int i = 0; i < urls.count; i++)
+    {
+        sink += should_skip_url(urls.items[i]);
+        r->bytes += strlen(urls.items[i]);
+        r->ops++;
+    }
+}
+
+static RobotsRules *robots_rules;
+
+static void pass_robots_match(BenchResult *r)
+{
+    for (int i = 0; i < urls.count; i++)
+    {
+        // Path after the authority, as the crawler matches it
+        const char *path = strstr(urls.items[i], "://");
+        path = path ? strchr(path + 3, '/') : NULL;
+        if (!path)
+            continue;
+        sink += robots_match(robots_rules, path);
+        r->bytes += strlen(path);
+        r->ops++;
+    }
+}
+
+static void pass_write_callback(BenchResult *r)
+{
+    for (int p = 0; p < page_count; p++)
+    {
+        WebPage page = {0};
+        page.capacity = INITIAL_PAGE_SIZE;
+        page.data = malloc(page.capacity);
+
+        for (size_t offset = 0; offset < pages[p].size; offset += CHUNK_SIZE)
+        {
+            size_t chunk = pages[p].size - offset < CHUNK_SIZE ? pages[p].size - offset : CHUNK_SIZE;
+            sink += write_callback(pages[p].html + offset, 1, chunk, &page);
+            r->ops++;
+        }
+        r->bytes += pages[p].size;
+        free(page.data);
+    }
+}
+
+static void pass_extract_links(BenchResult *r)
+{
+    for (int p = 0; p < page_count; p++)
+    {
+        extract_links(pages[p].html, pages[p].base_url, 0);
+        r->bytes += pages[p].size;
+        r->ops++;
+    }
+}
+
+static void run_bench(const char *name, BenchPass pass, const char *filter)
+{
+    if (filter && !strstr(name, filter))
+        return;
+
+    BenchResult r = {name, 0, 0, 0, 0};
+
+    pass(&r); // Warm up caches and lazily initialised library state
+    r.ops = 0;
+    r.bytes = 0;
+
+    unsigned long allocs_before = __atomic_load_n(&alloc_count, __ATOMIC_RELAXED);
+    double start = now_seconds();
+    do
+    {
+        pass(&r);
+        r.seconds = now_seconds() - start;
+    } while (r.seconds < MIN_BENCH_SECONDS);
+    r.allocs = __atomic_load_n(&alloc_count, __ATOMIC_RELAXED) - allocs_before;
+
+    double ns_per_op = r.seconds * 1e9 / r.ops;
+    double allocs_per_op = (double)r.allocs / r.ops;
+    double mb_per_s = r.bytes / r.seconds / (1024 * 1024);
+
+    printf("%-16s %12.1f %12.2f %12.0f %10.1f\n", name, ns_per_op, allocs_per_op, r.ops / r.seconds, mb_per_s);
+    printf("MICRO name=%s ops=%lu ns_per_op=%.1f allocs_per_op=%.3f ops_per_s=%.0f mb_per_s=%.2f\n",
+           name, r.ops, ns_per_op, allocs_per_op, r.ops / r.seconds, mb_per_s);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *corpus = argc > 1 ? argv[1] : "bench/corpus";
+    const char *filter = argc > 2 ? argv[2] : NULL;
+
+    if (argc > 3 || (argc > 1 && argv[1][0] == '-'))
+    {
+        fprintf(stderr, "Usage: %s [corpus_dir] [benchmark_name_filter]\n", argv[0]);
+        return 1;
+    }
+
+    if (!load_lines(corpus, "urls.txt", &urls) || !load_lines(corpus, "links.txt", &links) ||
+        !load_pages(corpus))
+        return 1;
+
+    char robots_path[1024];
+    size_t robots_size = 0;
+    snprintf(robots_path, sizeof(robots_path), "%s/robots.txt", corpus);
+    char *robots_body = read_file(robots_path, &robots_size);
+    if (!robots_body)
+    {
+        fprintf(stderr, "microbench: cannot read %s\n", robots_path);
+        return 1;
+    }
+    robots_rules = robots_compile(robots_body, robots_size, "WebCrawler");
+    free(robots_body);
+
+    // Per-link debug logging would dominate extract_links
+    log_init(LOG_WARN);
+    xmlInitParser();
+    storage = &stub_backend;
+
+    printf("Corpus: %d pages (%.1f KB), %d URLs, %d links\n\n",
+           page_count, corpus_bytes / 1024.0, urls.count, links.count);
+    printf("%-16s %12s %12s %12s %10s\n", "benchmark", "ns/op", "allocs/op", "ops/s", "MB/s");
+
+    run_bench("normalize_url", pass_normalize_url, filter);
+    run_bench("resolve_url", pass_resolve_url, filter);
+    run_bench("should_skip_url", pass_should_skip_url, filter);
+    run_bench("robots_match", pass_robots_match, filter);
+    run_bench("write_callback", pass_write_callback, filter);
+    run_bench("extract_links", pass_extract_links, filter);
+
+    robots_free(robots_rules);
+    log_shutdown();
+    xmlCleanupParser();
+    return 0;
+}
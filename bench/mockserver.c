@@ -0,0 +1,451 @@
+// Mock web server for crawl benchmarks.
+//
+// Serves a deterministic synthetic site graph: page k lives on host
+// 127.0.0.(k % hosts + 1) and links to its children k*F+1 .. k*F+F down to
+// the configured depth. A share of links point back at pages that already
+// exist (duplicates) and a share of pages answer 500. Every loopback address
+// reaches the same listener, so each "host" is a distinct host name to the
+// crawler without any DNS setup. Bodies can be gzip-encoded for clients that
+// accept it, and each connection's sending rate can be capped.
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <zlib.h>
+
+#define REQUEST_BUFFER_SIZE 8192
+#define MAX_PAGE_COUNT 10000000L
+
+typedef enum
+{
+    LATENCY_FIXED,
+    LATENCY_UNIFORM,
+    LATENCY_EXP
+} LatencyKind;
+
+typedef struct
+{
+    int port;
+    int hosts;
+    int fanout;
+    int depth;
+    int page_size;
+    double error_rate;
+    double dup_ratio;
+    LatencyKind latency_kind;
+    double latency_a; // Fixed value, exponential mean or uniform minimum (ms)
+    double latency_b; // Uniform maximum (ms)
+    unsigned int seed;
+    int gzip;           // Encode bodies when the request accepts gzip
+    long bandwidth_kbs; // Per-connection sending rate in KB/s; 0 for no cap
+    long page_count;    // Derived from fanout and depth
+} ServerConfig;
+
+static ServerConfig config = {
+    .port = 8900,
+    .hosts = 4,
+    .fanout = 8,
+    .depth = 3,
+    .page_size = 16384,
+    .latency_kind = LATENCY_FIXED,
+    .seed = 1};
+
+static const char FILLER[] = "<p>Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod "
+                             "tempor incididunt ut labore et dolore magna aliqua.</p>\n";
+static const char PAGE_TAIL[] = "</body></html>\n";
+
+// Stable mix of (page, slot) so the graph is identical on every run
+static unsigned long long mix(unsigned long long a, unsigned long long b)
+{
+    unsigned long long x = a * 0x9E3779B97F4A7C15ULL ^ (b + config.seed) * 0xC2B2AE3D27D4EB4FULL;
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// Uniform double in [0, 1) from a hash
+static double unit(unsigned long long h)
+{
+    return (h >> 11) / 9007199254740992.0;
+}
+
+static int page_is_error(long page)
+{
+    return page > 0 && unit(mix(page, 0xE440)) < config.error_rate;
+}
+
+// Target of link slot on page. Leaves, and a dup_ratio share of inner
+// links, point at a lower-numbered page the crawler has already seen.
+static long link_target(long page, int slot)
+{
+    long child = page * config.fanout + slot + 1;
+    unsigned long long h = mix(page, slot + 1);
+
+    if (child < config.page_count && unit(h) >= config.dup_ratio)
+        return child;
+
+    long limit = child < config.page_count ? child : config.page_count;
+    return (long)((h >> 7) % (unsigned long long)limit);
+}
+
+static void sleep_latency(unsigned int *rng)
+{
+    double ms = config.latency_a;
+    double u = rand_r(rng) / ((double)RAND_MAX + 1.0);
+
+    if (config.latency_kind == LATENCY_UNIFORM)
+        ms = config.latency_a + u * (config.latency_b - config.latency_a);
+    else if (config.latency_kind == LATENCY_EXP)
+        ms = -config.latency_a * log(1.0 - u);
+
+    if (ms > 0)
+    {
+        struct timespec ts = {(time_t)(ms / 1000), (long)(fmod(ms, 1000.0) * 1e6)};
+        nanosleep(&ts, NULL);
+    }
+}
+
+// Render page into buf, padding with filler up to page_size; returns the length
+static size_t render_page(long page, char *buf, size_t size)
+{
+    size_t len = snprintf(buf, size, "<!DOCTYPE html>\n<html><head><title>Page %ld</title></head>\n"
+                                     "<body><h1>Page %ld</h1>\n",
+                          page, page);
+
+    for (int slot = 0; slot < config.fanout; slot++)
+    {
+        long target = link_target(page, slot);
+        len += snprintf(buf + len, size - len,
+                        "<p><a href=\"http://127.0.0.%ld:%d/p/%ld.html\">Page %ld</a></p>\n",
+                        target % config.hosts + 1, config.port, target, target);
+    }
+
+    while (len + sizeof(FILLER) + sizeof(PAGE_TAIL) <= (size_t)config.page_size)
+    {
+        memcpy(buf + len, FILLER, sizeof(FILLER) - 1);
+        len += sizeof(FILLER) - 1;
+    }
+
+    memcpy(buf + len, PAGE_TAIL, sizeof(PAGE_TAIL));
+    return len + sizeof(PAGE_TAIL) - 1;
+}
+
+// Hold the connection as long as len bytes take at the capped rate
+static void sleep_bandwidth(size_t len)
+{
+    if (config.bandwidth_kbs <= 0)
+        return;
+    double us = len * 1e6 / (config.bandwidth_kbs * 1024.0);
+    struct timespec ts = {(time_t)(us / 1e6), (long)(fmod(us, 1e6) * 1000)};
+    nanosleep(&ts, NULL);
+}
+
+static int send_all(int fd, const char *data, size_t len)
+{
+    sleep_bandwidth(len);
+    while (len > 0)
+    {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 0;
+        data += n;
+        len -= n;
+    }
+    return 1;
+}
+
+// Case-insensitive search for a header line such as "connection: close"
+static int has_header(const char *headers, const char *line)
+{
+    size_t n = strlen(line);
+    for (const char *p = headers; (p = strchr(p, '\n')) != NULL;)
+    {
+        p++;
+        size_t i = 0;
+        while (i < n && p[i] && tolower((unsigned char)p[i]) == line[i])
+            i++;
+        if (i == n)
+            return 1;
+    }
+    return 0;
+}
+
+// 1 if the request's Accept-Encoding lists gzip
+static int accepts_gzip(const char *headers)
+{
+    static const char name[] = "accept-encoding:";
+    for (const char *p = headers; (p = strchr(p, '\n')) != NULL;)
+    {
+        p++;
+        if (strncasecmp(p, name, sizeof(name) - 1) != 0)
+            continue;
+        size_t len = strcspn(p, "\r\n");
+        for (const char *q = p + sizeof(name) - 1; q + 4 <= p + len; q++)
+        {
+            if (strncasecmp(q, "gzip", 4) == 0)
+                return 1;
+        }
+    }
+    return 0;
+}
+
+// Gzip body into out; returns the encoded length, or 0 if it did not fit
+static size_t gzip_body(const char *body, size_t len, unsigned char *out, size_t out_size)
+{
+    z_stream zs = {0};
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return 0;
+    zs.next_in = (unsigned char *)body;
+    zs.avail_in = len;
+    zs.next_out = out;
+    zs.avail_out = out_size;
+    size_t encoded = deflate(&zs, Z_FINISH) == Z_STREAM_END ? zs.total_out : 0;
+    deflateEnd(&zs);
+    return encoded;
+}
+
+static int send_response(int fd, int status, const char *body, size_t body_len, const char *encoding,
+                         int head_only, int keep_alive)
+{
+    const char *reason = status == 200 ? "OK" : status == 404 ? "Not Found" : "Internal Server Error";
+    char header[320];
+    int header_len = snprintf(header, sizeof(header),
+                              "HTTP/1.1 %d %s\r\nContent-Type: text/html; charset=utf-8\r\n"
+                              "%s%s%sContent-Length: %zu\r\nConnection: %s\r\n\r\n",
+                              status, reason, encoding ? "Content-Encoding: " : "", encoding ? encoding : "",
+                              encoding ? "\r\n" : "", body_len, keep_alive ? "keep-alive" : "close");
+
+    return send_all(fd, header, header_len) && (head_only || send_all(fd, body, body_len));
+}
+
+static void *serve_connection(void *arg)
+{
+    int fd = (int)(long)arg;
+    unsigned int rng = config.seed ^ (unsigned int)fd ^ (unsigned int)time(NULL);
+    size_t body_size = config.page_size + (size_t)config.fanout * 128 + 512;
+    char *body = malloc(body_size);
+    size_t encoded_size = compressBound(body_size) + 64;
+    unsigned char *encoded = config.gzip ? malloc(encoded_size) : NULL;
+    char request[REQUEST_BUFFER_SIZE + 1];
+    size_t used = 0;
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    while (body)
+    {
+        // Read one complete request head
+        char *end;
+        request[used] = '\0';
+        while ((end = strstr(request, "\r\n\r\n")) == NULL)
+        {
+            if (used == REQUEST_BUFFER_SIZE)
+                goto done;
+            ssize_t n = recv(fd, request + used, REQUEST_BUFFER_SIZE - used, 0);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                goto done;
+            used += n;
+            request[used] = '\0';
+        }
+        *end = '\0';
+
+        char method[8], path[1024], version[16];
+        if (sscanf(request, "%7s %1023s %15s", method, path, version) != 3)
+            break;
+
+        int keep_alive = strcmp(version, "HTTP/1.1") == 0 && !has_header(request, "connection: close");
+        int head_only = strcmp(method, "HEAD") == 0;
+
+        long page = -1;
+        char extra;
+        if (strcmp(path, "/") == 0)
+            page = 0;
+        else if (sscanf(path, "/p/%ld.htm%c", &page, &extra) != 2 || extra != 'l')
+            page = -1;
+
+        sleep_latency(&rng);
+
+        int ok;
+        if (page < 0 || page >= config.page_count)
+        {
+            const char *msg = "<html><body>Not found</body></html>\n";
+            ok = send_response(fd, 404, msg, strlen(msg), NULL, head_only, keep_alive);
+        }
+        else if (page_is_error(page))
+        {
+            const char *msg = "<html><body>Server error</body></html>\n";
+            ok = send_response(fd, 500, msg, strlen(msg), NULL, head_only, keep_alive);
+        }
+        else
+        {
+            size_t len = render_page(page, body, body_size);
+            size_t gzip_len = encoded && accepts_gzip(request) ? gzip_body(body, len, encoded, encoded_size) : 0;
+            ok = gzip_len > 0 ? send_response(fd, 200, (char *)encoded, gzip_len, "gzip", head_only, keep_alive)
+                              : send_response(fd, 200, body, len, NULL, head_only, keep_alive);
+        }
+
+        if (!ok || !keep_alive)
+            break;
+
+        // Keep any pipelined bytes that followed this request
+        size_t consumed = (end + 4) - request;
+        memmove(request, request + consumed, used - consumed);
+        used -= consumed;
+    }
+
+done:
+    free(encoded);
+    free(body);
+    close(fd);
+    return NULL;
+}
+
+static int parse_latency(const char *spec)
+{
+    if (sscanf(spec, "uniform:%lf-%lf", &config.latency_a, &config.latency_b) == 2)
+        config.latency_kind = LATENCY_UNIFORM;
+    else if (sscanf(spec, "exp:%lf", &config.latency_a) == 1)
+        config.latency_kind = LATENCY_EXP;
+    else if (sscanf(spec, "fixed:%lf", &config.latency_a) == 1 || sscanf(spec, "%lf", &config.latency_a) == 1)
+        config.latency_kind = LATENCY_FIXED;
+    else
+        return 0;
+    return 1;
+}
+
+static void print_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [options]\n", prog);
+    fprintf(stderr, "  --port N           Listen port (default %d)\n", config.port);
+    fprintf(stderr, "  --hosts N          Hosts 127.0.0.1 .. 127.0.0.N (default %d)\n", config.hosts);
+    fprintf(stderr, "  --fanout N         Links per page (default %d)\n", config.fanout);
+    fprintf(stderr, "  --depth N          Levels below the root page (default %d)\n", config.depth);
+    fprintf(stderr, "  --page-size BYTES  Approximate page size (default %d)\n", config.page_size);
+    fprintf(stderr, "  --latency SPEC     fixed:MS, uniform:MIN-MAX or exp:MEAN (default 0)\n");
+    fprintf(stderr, "  --error-rate F     Share of pages answering 500 (default 0)\n");
+    fprintf(stderr, "  --dup-ratio F      Share of links to already seen pages (default 0)\n");
+    fprintf(stderr, "  --seed N           Graph seed (default %u)\n", config.seed);
+    fprintf(stderr, "  --gzip 0|1         Gzip bodies for clients that accept it (default 0)\n");
+    fprintf(stderr, "  --bandwidth KBS    Cap each connection at KBS KB/s (default 0, no cap)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *opt = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        int ok = value != NULL;
+
+        if (ok && strcmp(opt, "--port") == 0)
+            config.port = atoi(value);
+        else if (ok && strcmp(opt, "--hosts") == 0)
+            config.hosts = atoi(value);
+        else if (ok && strcmp(opt, "--fanout") == 0)
+            config.fanout = atoi(value);
+        else if (ok && strcmp(opt, "--depth") == 0)
+            config.depth = atoi(value);
+        else if (ok && strcmp(opt, "--page-size") == 0)
+            config.page_size = atoi(value);
+        else if (ok && strcmp(opt, "--latency") == 0)
+            ok = parse_latency(value);
+        else if (ok && strcmp(opt, "--error-rate") == 0)
+            config.error_rate = atof(value);
+        else if (ok && strcmp(opt, "--dup-ratio") == 0)
+            config.dup_ratio = atof(value);
+        else if (ok && strcmp(opt, "--seed") == 0)
+            config.seed = (unsigned int)strtoul(value, NULL, 10);
+        else if (ok && strcmp(opt, "--gzip") == 0)
+            config.gzip = atoi(value);
+        else if (ok && strcmp(opt, "--bandwidth") == 0)
+            config.bandwidth_kbs = atol(value);
+        else
+            ok = 0;
+
+        if (!ok)
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+
+    if (config.hosts < 1 || config.hosts > 254 || config.fanout < 1 || config.depth < 0)
+    {
+        fprintf(stderr, "Invalid graph: need 1-254 hosts, fanout >= 1 and depth >= 0\n");
+        return 1;
+    }
+
+    // Pages in a complete tree of the given fan-out and depth
+    long level = 1;
+    config.page_count = 1;
+    for (int d = 0; d < config.depth && config.page_count < MAX_PAGE_COUNT; d++)
+    {
+        level *= config.fanout;
+        config.page_count += level;
+    }
+    if (config.page_count > MAX_PAGE_COUNT)
+        config.page_count = MAX_PAGE_COUNT;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(config.port);
+
+    if (server < 0 || bind(server, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(server, 1024) != 0)
+    {
+        perror("mockserver: listen");
+        return 1;
+    }
+
+    fprintf(stderr, "mockserver: %ld pages on %d hosts, fan-out %d, listening on port %d\n",
+            config.page_count, config.hosts, config.fanout, config.port);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    for (;;)
+    {
+        int fd = accept(server, NULL, NULL);
+        if (fd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED || errno == EMFILE)
+                continue;
+            perror("mockserver: accept");
+            break;
+        }
+
+        // One thread per connection; keep-alive connections are reused by curl
+        pthread_t thread;
+        if (pthread_create(&thread, &attr, serve_connection, (void *)(long)fd) != 0)
+            close(fd);
+    }
+
+    close(server);
+    return 0;
+}
@@ -13,20 +13,47 @@
 #define MAX_DEPTH 3         // Maximum crawling depth from start URL
 #define HASH_SIZE 10007     // Hash table size for visited URLs (prime number)
 
+// Storage Settings
+#define STORAGE_BACKEND "sqlite"          // Default backend: "sqlite" or "log" (override with --backend)
+#define LOG_STORE_DIR "crawler.logstore" // Directory holding the log backend's append-only logs
+#define DEQUEUE_BATCH_SIZE 32            // URLs claimed from storage per dispatcher round
+#define SNAPSHOT_FILE "crawler.snapshot" // Scheduler state saved by an interrupted crawl for --resume
+
 // Database Settings
 #define DB_NAME "crawler.db"
 #define ENABLE_WAL_MODE 1   // Enable WAL mode for better performance
+#define DB_SHARD_COUNT 1    // Split pages/queue/links across N host-partitioned files (1 = single database)
+#define DB_SHARD_NAME_FORMAT "crawler.shard%d.db" // Shard file names when DB_SHARD_COUNT > 1
 
 // Network Settings
 #define DELAY_SECONDS 5             // Delay between requests (seconds) - be polite!
 #define REQUEST_TIMEOUT 30L         // HTTP request timeout (seconds)
 #define MAX_REDIRECTS 5L            // Maximum number of redirects to follow
 #define USER_AGENT "WebCrawler/1.0" // User agent string
+#define CONDITIONAL_RECRAWL 1       // Revalidate pages fetched by earlier sessions (0=no, 1=yes)
+#define VALIDATOR_LENGTH 256        // Longest ETag / Last-Modified value kept
+
+// Revisit Scheduling (continuous mode; see revisit.h)
+#define REVISIT_INITIAL_INTERVAL 3600        // Delay before a page's first revisit (seconds)
+#define REVISIT_MIN_INTERVAL 300             // Shortest delay between visits of a page (seconds)
+#define REVISIT_MAX_INTERVAL (30 * 86400)    // Longest delay between visits of a page (seconds)
+#define REVISIT_POLL_INTERVAL 10             // Seconds between checks for due revisits
+#define REVISIT_BATCH_SIZE 1000              // Most revisits queued per check
 
 // Thread pool settings
 #define MAX_THREADS 4          // Number of worker threads
 #define THREAD_POOL_QUEUE_SIZE 1000 // Maximum queue size
 
+// Dispatcher and per-host concurrency (AIMD; see hosts.h)
+#define HOST_INITIAL_CONCURRENCY 2  // Requests in flight to a host before any feedback
+#define HOST_MIN_CONCURRENCY 1      // Floor of a host's limit after backoffs
+#define HOST_MAX_CONCURRENCY 8      // Ceiling of a host's limit; MAX_THREADS bounds it too
+#define HOST_LATENCY_SPIKE_FACTOR 3 // First-byte time over this multiple of the host's average halves its limit
+#define DISPATCH_HELD_MAX 64        // Claimed URLs waiting for their host's limit; lookahead past busy hosts
+#define HOST_RUN_LENGTH 8           // URLs of one host a worker fetches back to back on one connection
+#define HOST_RUN_MAX_WAIT_MS 2000   // Crawl-delay waits one run may add up to; shortens runs on slow hosts
+#define DISPATCH_POLL_US 10000      // Dispatcher wait while workers or hosts are busy
+
 // SSL Settings (for production, set these to 1)
 #define SSL_VERIFY_PEER 0L // Verify SSL certificates (0=disabled, 1=enabled)
 #define SSL_VERIFY_HOST 0L // Verify SSL hostnames (0=disabled, 1=enabled)
@@ -36,6 +63,68 @@
 #define PAGE_FILE_PREFIX "page_" // Prefix for saved page files
 #define VERBOSE_OUTPUT 1         // Print detailed progress (0=quiet, 1=verbose)
 
+// Logging (asynchronous; see log.h)
+#define LOG_LEVEL (VERBOSE_OUTPUT ? 3 : 2) // 0=error, 1=warn, 2=info, 3=debug (one line per link)
+#define LOG_RING_SIZE 2048                 // Queued messages (power of two); overflow is dropped
+#define LOG_LINE_LENGTH 1024               // Longer messages are truncated
+#define LOG_BATCH_SIZE 65536               // Bytes per write by the background writer
+#define LOG_FLUSH_INTERVAL_MS 20           // Writer poll interval when idle
+
+// robots.txt (see robots.h)
+#define RESPECT_ROBOTS_TXT 1           // Fetch and obey robots.txt (0=no, 1=yes)
+#define ROBOTS_CACHE_TTL 86400         // Seconds a host's robots.txt is trusted, in memory and in storage
+#define ROBOTS_ERROR_TTL 600           // After a server error or timeout the host counts as disallowed this long
+#define ROBOTS_MAX_SIZE (500 * 1024)   // Bytes of robots.txt parsed; the rest is ignored
+#define ROBOTS_MAX_CRAWL_DELAY 30      // Upper bound on an honored Crawl-delay (seconds)
+
+// Sitemaps (see sitemap.h)
+#define SITEMAP_DISCOVERY 1                 // Ingest the Sitemap: files listed in robots.txt (0=no, 1=yes)
+#define SITEMAP_MAX_FILES 1024              // Sitemap files fetched per run, including nested ones
+#define SITEMAP_MAX_NESTING 2               // Levels of sitemap indexes followed
+#define SITEMAP_MAX_SIZE (50 * 1024 * 1024) // Bytes downloaded, and bytes parsed after gunzip, per file
+#define SITEMAP_BATCH_SIZE 512              // URLs per frontier insert
+#define SITEMAP_REFRESH_INTERVAL 86400      // Seconds before the same sitemap is read again
+#define SITEMAP_DEPTH 1                     // Crawl depth given to sitemap URLs
+
+// Host Table (see hosts.h)
+#define HOST_TABLE_SIZE 4096      // Hosts tracked (power of two); later hosts share one overflow entry
+#define HOST_PROBE_LIMIT 64       // Slots probed per host, pattern or type lookup before giving up
+#define HOST_PATTERN_SLOTS 64     // URL path patterns tracked per host (power of two)
+#define HOST_MIME_SLOTS 16        // Skipped content types tracked per host (power of two)
+#define CONTENT_SKIP_THRESHOLD 3  // Skips after which a pattern that never gave HTML is deferred
+#define CONTENT_SKIP_PROBE 16     // A deferred pattern still lets one link in this many through
+
+// Crawler traps and per-host budgets, checked before a URL is queued (see hosts.h)
+#define TRAP_MAX_URL_LENGTH 512     // Longer URLs are refused
+#define TRAP_MAX_PATH_SEGMENTS 16   // Deeper paths are refused
+#define TRAP_MAX_SEGMENT_REPEATS 2  // Refuse paths repeating a segment more often, like /a/b/a/b/a/b
+#define TRAP_MAX_QUERY_PARAMS 8     // URLs with more query parameters are refused
+#define TRAP_PATTERN_MAX_URLS 2000  // URLs queued per host and URL shape (numbers and query values masked)
+#define HOST_TRAP_SLOTS 64          // URL shapes counted per host (power of two)
+#define HOST_URL_BUDGET 50000       // URLs queued per host (0 = no limit)
+#define HOST_PAGE_BUDGET 0          // Pages fetched per host before no more of its URLs are queued (0 = no limit)
+
+// Link extraction: which link types are queued besides <a href>
+#define FOLLOW_AREA_LINKS 1      // <area href> in image maps
+#define FOLLOW_FRAME_LINKS 1     // <iframe src> and <frame src>
+#define FOLLOW_META_REFRESH 1    // <meta http-equiv="refresh"> targets
+#define FOLLOW_ALTERNATE_LINKS 1 // <link rel=alternate>: translations, feeds
+#define FOLLOW_RESOURCE_LINKS 0  // Stylesheets, icons and other subresource <link>s
+#define FOLLOW_CANONICAL_LINKS 1 // A page's rel=canonical URL
+#define CANONICAL_SAME_HOST 1    // Ignore rel=canonical pointing at another host
+
+// Redirect and canonical alias map (see redirects.h)
+#define REDIRECT_TABLE_SIZE 65536 // Redirecting URLs remembered (power of two)
+#define REDIRECT_PROBE_LIMIT 64   // Slots probed per lookup before giving up
+
+// DNS prefetch (see dns.h)
+#define DNS_PREFETCH 1        // Resolve hosts on resolver threads once their first URL is queued (0=no, 1=yes)
+#define DNS_THREADS 2         // Resolver threads
+#define DNS_CACHE_SIZE 4096   // Host names cached (power of two); later names are resolved by libcurl
+#define DNS_CACHE_TTL 300     // Seconds a resolved address is used before it is resolved again
+#define DNS_NEGATIVE_TTL 60   // Seconds before a name that failed to resolve is tried again
+#define DNS_MAX_ADDRESSES 4   // Addresses kept per name; libcurl tries them in order
+
 // Memory Settings
 #define INITIAL_PAGE_SIZE 4096           // Initial buffer size for downloaded pages
 #define MAX_PAGE_SIZE (10 * 1024 * 1024) // Maximum page size (10MB)
@@ -46,15 +135,33 @@
 #define FOLLOW_EXTERNAL_LINKS 1 // Follow links to other domains (0=no, 1=yes)
 
 // Error Handling
-#define MAX_CONSECUTIVE_ERRORS 10 // Stop crawling after this many consecutive errors
-#define RETRY_FAILED_REQUESTS 0   // Retry failed requests (0=no, 1=yes)
-#define MAX_RETRIES 3             // Maximum number of retries per URL
+#define MAX_CONSECUTIVE_ERRORS 5        // Transient failures in a row that open a host's circuit breaker
+#define RETRY_FAILED_REQUESTS 1         // Retry timeouts, connection errors, 429 and 5xx (0=no, 1=yes)
+#define MAX_RETRIES 3                   // Maximum number of retries per URL
+#define RETRY_BASE_DELAY_MS 2000        // Backoff before the first retry; doubles per attempt, with jitter
+#define RETRY_MAX_DELAY_MS (300 * 1000) // Upper bound on a backoff or an honored Retry-After
+#define RETRY_QUEUE_SIZE 65536          // Retries held in memory; failures beyond this are not retried
+#define HOST_BREAKER_COOLDOWN_MS 30000  // An open breaker's first wait before a probe; doubles per trip
+#define HOST_BREAKER_MAX_TRIPS 6        // Trips in a row after which a host is given up for the run
 
 // Performance Settings
-#define ENABLE_COMPRESSION 1   // Enable gzip compression (0=no, 1=yes)
+#define ENABLE_COMPRESSION 1   // Offer every encoding libcurl decodes (gzip, deflate, br, zstd)
+#define ENABLE_HTTP2 1         // Negotiate HTTP/2 over TLS; cleartext URLs use HTTP/1.1 keep-alive
+#define TRUNCATE_PAGE_KB 0     // Keep only the first N KB of each body for link-only crawls (0 = whole body)
 #define DNS_CACHE_TIMEOUT 60   // DNS cache timeout (seconds)
 #define CONNECTION_TIMEOUT 10L // Connection timeout (seconds)
 
+// Metrics Settings
+#define METRICS_TEXTFILE "crawler.prom" // Prometheus textfile rewritten periodically (NULL = disabled)
+#define METRICS_INTERVAL 5              // Seconds between textfile rewrites
+#define METRICS_MAX_THREADS 64          // Per-thread metric slots (extra threads share the last one)
+
+// Trace Settings (enabled with --trace / --trace-summary)
+#define TRACE_RING_SIZE 4096 // Per-thread URL records kept; the oldest are overwritten
+#define TRACE_MAX_THREADS 64 // Threads that can record traces
+#define TRACE_URL_LENGTH 256 // URL prefix kept per record
+#define TRACE_HOST_LENGTH 64 // Host name kept per record
+
 // Debug Settings
 #ifdef DEBUG
 #define ENABLE_DEBUG_OUTPUT 1
@@ -77,6 +184,14 @@ static const char *SKIP_URL_PATTERNS[] __attribute__((unused)) = {
     "mailto:", "javascript:", "tel:",
     NULL};
 
+// Content types worth parsing (prefix match, case-insensitive). Responses
+// announcing another type are aborted once their headers arrive; responses
+// without a Content-Type are kept.
+static const char *ALLOWED_CONTENT_TYPES[] __attribute__((unused)) = {
+    "text/html",
+    "application/xhtml+xml",
+    NULL};
+
 // Domain filtering (if FOLLOW_EXTERNAL_LINKS is 0)
 // Only crawl URLs from these domains (NULL = allow all)
 static const char *ALLOWED_DOMAINS[] __attribute__((unused)) = {
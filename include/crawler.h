@@ -10,16 +10,25 @@ typedef struct
     char *data;
     size_t size;
     size_t capacity;
+    size_t limit;  // Bytes kept before the transfer is cut off; 0 for no limit
+    int truncated; // Set when limit cut the body short
 } WebPage;
 
 // URL utility functions
 void normalize_url(char *url);
 char *resolve_url(const char *base_url, const char *relative_url);
 int should_skip_url(const char *url);
+void get_url_host(const char *url, char *host, size_t host_size);
 
 // Web page download functions
 size_t write_callback(void *contents, size_t size, size_t nmemb, WebPage *page);
-int crawl_url(const char *url, int depth);
+// Keep only the first kb KB of each page (0 = whole pages); default TRUNCATE_PAGE_KB
+void crawler_set_truncate_kb(long kb);
+// Links deeper than depth are not queued; default MAX_DEPTH
+void crawler_set_max_depth(int depth);
+int crawler_max_depth(void);
+// attempt counts earlier tries; transient failures are queued for a retry
+int crawl_url(const char *url, int depth, int attempt);
 
 // HTML parsing and link extraction
 void extract_links(const char *html, const char *base_url, int current_depth);
@@ -29,5 +38,6 @@ int create_pages_directory(void);
 
 // Custom string functions
 char *strdup(const char *s);
+char *my_strdup(const char *s);
 
 #endif // CRAWLER_H
\ No newline at end of file
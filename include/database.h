@@ -2,56 +2,65 @@
 #define DATABASE_H
 
 #include <sqlite3.h>
-#include <time.h>
+#include <pthread.h>
 #include "config.h"
+#include "storage.h"
 
-// Database structure
+// Shard schema version, stored in PRAGMA user_version
+#define DB_SCHEMA_VERSION 5
+#define DB_SCHEMA_VERSION_STR "5"
+
+// url_queue.status codes
+typedef enum
+{
+    QUEUE_PENDING = 0,
+    QUEUE_CRAWLED = 1,
+    QUEUE_ERROR = 2,
+    QUEUE_SKIPPED = 3
+} QueueStatus;
+
+// One host-partitioned slice of pages, url_queue and extracted_links.
+// Each shard has its own writer connection, prepared statements and lock.
 typedef struct
 {
+    char filename[256];
     sqlite3 *db;
+    pthread_mutex_t lock;
     sqlite3_stmt *insert_page;
+    sqlite3_stmt *copy_page;
     sqlite3_stmt *insert_url;
+    sqlite3_stmt *claim_url;
+    sqlite3_stmt *update_status;
+    sqlite3_stmt *insert_link;
+    sqlite3_stmt *delete_links;
+    sqlite3_stmt *get_stats;
+    sqlite3_stmt *save_validators;
+    sqlite3_stmt *delete_validators;
+    sqlite3_stmt *get_revisit;
+    sqlite3_stmt *save_revisit;
+    sqlite3_int64 next_seq; // Enqueue order for url_queue.seq
+} DBShard;
+
+// A thread's private read-only connection to one shard (SQLITE_OPEN_NOMUTEX)
+typedef struct
+{
+    sqlite3 *db;
     sqlite3_stmt *check_visited;
     sqlite3_stmt *get_queue;
-    sqlite3_stmt *update_crawled;
-    sqlite3_stmt *get_stats;
-} CrawlerDB;
+    sqlite3_stmt *get_validators;
+    sqlite3_stmt *previous_links;
+} DBReader;
 
-// Statistics structure
+// Database structure
 typedef struct
 {
-    int pages_crawled;
-    int links_found;
-    int errors;
-    int skipped_urls;
-    time_t start_time;
-    int session_id;
-} CrawlerStats;
-
-// Global database instance (extern declaration)
+    sqlite3 *db;                    // Coordinator: crawl_sessions metadata
+    DBShard shards[DB_SHARD_COUNT]; // Shard 0 shares the coordinator connection when DB_SHARD_COUNT is 1
+    int next_shard;                 // Round-robin cursor for dequeuing across shards
+    pthread_key_t reader_key;       // Per-thread DBReader array, one per shard
+} CrawlerDB;
+
+// Global database instance (extern declaration), used by sqlite_backend
 extern CrawlerDB crawler_db;
-extern CrawlerStats stats;
-
-// Database initialization and management functions
-int init_database(void);
-void cleanup_database(void);
-
-// Session management
-int create_crawl_session(const char *start_url);
-int resume_crawl_session(void);
-void print_resume_info(void);
-
-// Page and URL management
-void save_page_to_db(const char *url, const char *content, size_t content_length,
-                     long response_code, int depth);
-void add_url_to_queue(const char *url, int depth);
-int is_url_visited(const char *url);
-int get_next_url(char *url_buffer, int *depth);
-void mark_url_crawled(const char *url);
-void save_extracted_link(const char *source_url, const char *target_url);
-
-// Statistics
-void update_stats_from_db(void);
-void print_stats(void);
-
-#endif // DATABASE_H
\ No newline at end of file
+
+#endif // DATABASE_H
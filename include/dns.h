@@ -0,0 +1,28 @@
+#ifndef DNS_H
+#define DNS_H
+
+#include <curl/curl.h>
+
+// DNS prefetch. When a host's first URL is queued, its name is resolved on
+// one of DNS_THREADS resolver threads, so the worker that later fetches it
+// connects at once instead of waiting in the resolver. Answers are cached
+// for DNS_CACHE_TTL seconds (getaddrinfo does not report record TTLs) and
+// failures for DNS_NEGATIVE_TTL; an expired name is resolved again in the
+// background while fetches fall back to libcurl's own lookup. Resolution
+// goes through getaddrinfo, so /etc/hosts and the system resolver apply.
+
+// Start the resolver threads; until then dns_prefetch does nothing
+void dns_init(void);
+
+// Queue the host of url for resolution unless a fresh answer is cached or a
+// lookup is under way. Never blocks on the network.
+void dns_prefetch(const char *url);
+
+// A CURLOPT_RESOLVE list pinning the host and port of url to its cached
+// addresses, or NULL if there is no fresh answer. Free with curl_slist_free_all.
+struct curl_slist *dns_resolve_list(const char *url);
+
+// Stop the resolver threads; lookups still queued are dropped
+void dns_cleanup(void);
+
+#endif // DNS_H
@@ -0,0 +1,175 @@
+#ifndef HOSTS_H
+#define HOSTS_H
+
+#include <stdio.h>
+#include "config.h"
+
+// Outcomes of the URLs sharing one path pattern, such as "/files/*.pdf"
+typedef struct
+{
+    unsigned long fetched;  // Responses kept for parsing
+    unsigned long skipped;  // Responses rejected at the header phase
+    unsigned long deferred; // Links not queued because of the skips
+} PathPatternStats;
+
+struct RobotsRules;
+struct SnapshotReader;
+
+// Verdict on queuing a URL, see host_admit_url
+typedef enum
+{
+    URL_ADMITTED,
+    URL_TRAP_LENGTH,   // Longer than TRAP_MAX_URL_LENGTH
+    URL_TRAP_DEPTH,    // More than TRAP_MAX_PATH_SEGMENTS path segments
+    URL_TRAP_REPEATS,  // A path segment repeated, as in /a/b/a/b/a/b
+    URL_TRAP_PARAMS,   // More than TRAP_MAX_QUERY_PARAMS query parameters
+    URL_TRAP_PATTERN,  // TRAP_PATTERN_MAX_URLS of its shape already queued
+    URL_HOST_BUDGET,   // The host's HOST_URL_BUDGET or HOST_PAGE_BUDGET is spent
+    URL_ADMISSION_COUNT
+} UrlAdmission;
+
+// Per-host crawl state. Entries are created on first use and never removed;
+// all fields are read and updated with atomics.
+typedef struct
+{
+    struct RobotsRules *robots; // Published rules, see robots.h
+    int robots_loading;         // Set while one thread fetches robots.txt
+    long crawl_delay_ms;        // From robots.txt; 0 means no pacing
+    long long next_fetch_us;    // Earliest start of the next paced fetch
+    int consecutive_failures;   // Host failures since the last response
+    int breaker_trips;          // Times the breaker opened without a success since
+    int breaker_probing;        // Set while the half-open probe is out
+    long long breaker_until_us; // Open until then; 0 when closed
+    int in_flight;              // Dispatched fetches not yet finished
+    int limit_milli;            // Concurrency limit in thousandths; 0 until first used
+    long long latency_us;       // Smoothed time to first byte
+    int latency_samples;
+    long long last_decrease_us; // When the limit was last halved
+    unsigned long fetches;      // Outcomes fed to the controller
+    unsigned long decreases;
+    unsigned long long wire_bytes;    // Body bytes as transferred
+    unsigned long long decoded_bytes; // The same bodies after content decoding
+    char *pattern_keys[HOST_PATTERN_SLOTS];
+    PathPatternStats patterns[HOST_PATTERN_SLOTS];
+    char *mime_keys[HOST_MIME_SLOTS];
+    unsigned long mime_skipped[HOST_MIME_SLOTS];
+    unsigned long urls_queued; // New frontier URLs
+    unsigned long pages;       // Pages fetched and kept
+    unsigned long refused[URL_ADMISSION_COUNT];
+    char *trap_keys[HOST_TRAP_SLOTS]; // URL shapes, see host_admit_url
+    unsigned long trap_counts[HOST_TRAP_SLOTS];
+} Host;
+
+// The entry for a URL's host, inserted if new. Lock-free; returns NULL when
+// the URL has no host. A host that finds no free slot within
+// HOST_PROBE_LIMIT probes gets the shared overflow entry, so its limits,
+// breaker and pacing still apply, pooled with the other overflow hosts.
+Host *host_get(const char *url);
+
+// The entry for a URL's host if it exists, or the overflow entry; never inserts
+Host *host_find(const char *url);
+
+// Whether host is the overflow entry, which must not hold per-host state
+// such as robots.txt rules
+int host_is_shared(const Host *host);
+
+// Record whether the response for url was kept or rejected at the header
+// phase, and for rejections under which content type
+void host_record_fetch(const char *url);
+void host_record_skip(const char *url, const char *content_type);
+
+// 1 if url's path pattern has been rejected CONTENT_SKIP_THRESHOLD times
+// without ever returning HTML; one in CONTENT_SKIP_PROBE such links still
+// passes, so a pattern can recover
+int host_should_defer(const char *url);
+
+// Crawler trap detection and budgets. Calendars, endless pagination and
+// growing session paths show up as long URLs, deep or repeating paths, many
+// query parameters, or a flood of URLs of one shape: the path with every
+// segment containing a digit masked and the query reduced to its parameter
+// names, so /cal/2024/05/17?view=day becomes /cal/*/*/*?view. host_admit_url
+// checks a URL about to be queued and counts refusals per host; URLs of
+// overflow hosts, which have no budget of their own, are refused as over
+// budget. host_record_queued counts a URL that was new to the frontier
+// against its host's budgets.
+UrlAdmission host_admit_url(const char *url);
+void host_record_queued(const char *url);
+const char *url_admission_name(UrlAdmission admission);
+
+// Hosts with refused URLs, by reason, and their fullest URL shape
+void hosts_print_trap_report(FILE *out);
+
+// Circuit breaker. Failures where the host did not answer, or answered 502,
+// 503 or 504, count against it and any other response resets the count.
+// MAX_CONSECUTIVE_ERRORS in a row open the breaker for a cooldown that
+// doubles per trip; after it one probe is let through, and its outcome
+// closes or reopens the breaker. After HOST_BREAKER_MAX_TRIPS trips in a row
+// the host is given up for the run.
+typedef enum
+{
+    HOST_AVAILABLE,
+    HOST_WAIT, // Breaker open; *retry_at_us tells when to ask again
+    HOST_DOWN  // Given up
+} HostAvailability;
+
+void host_breaker_record(const char *url, int failed);
+
+// Whether a URL may be fetched now; claims the probe of a half-open breaker
+HostAvailability host_breaker_allow(const char *url, long long *retry_at_us);
+
+// 1 once the URL's host has been given up; never claims the probe
+int host_is_down(const char *url);
+
+// Adaptive per-host concurrency (AIMD). A response that shows no overload
+// raises the host's limit by 1/limit, so by one per limit's worth of
+// fetches, while its time to first byte stays under HOST_LATENCY_SPIKE_FACTOR
+// times the average. A 429 or 503, a timeout or a latency spike halves the
+// limit, at most once per two average latencies because the fetches already
+// in flight report the same overload. The limit stays within
+// [HOST_MIN_CONCURRENCY, HOST_MAX_CONCURRENCY].
+
+// Take one of the host's slots for a dispatched run of fetches; 0 if all are in use
+int host_acquire_slot(const char *url);
+void host_release_slot(const char *url);
+
+// Whether host_acquire_slot would succeed now; claims nothing
+int host_slot_free(const char *url);
+
+// Feed a fetch outcome to the controller. latency_us is the time to first
+// byte, or -1 when no response arrived; overloaded marks 429, 503 and timeouts.
+void host_record_latency(const char *url, long long latency_us, int overloaded);
+
+// Limits of the busiest hosts; prints nothing before the first fetch
+void hosts_print_concurrency_report(FILE *out);
+
+// Body bytes of a fetch before and after content decoding
+void host_record_transfer(const char *url, long long wire_bytes, long long decoded_bytes);
+
+// Transfer volume and compression ratio of the hosts that sent the most bytes
+void hosts_print_transfer_report(FILE *out);
+
+// Wait until the host's Crawl-delay allows another fetch. Concurrent callers
+// reserve consecutive slots; returns at once for hosts without a delay.
+void host_pace(const char *url);
+
+// Index of the URL's host in the host table, the same for every URL of the
+// host; -1 for overflow hosts
+int host_id(const char *url);
+
+// URLs of the host one worker may fetch back to back on one connection:
+// HOST_RUN_LENGTH, fewer when its Crawl-delay would make the run wait
+// longer than HOST_RUN_MAX_WAIT_MS, and at least 1
+int host_run_length(const char *url);
+
+// Per-host counts of skipped content types; prints nothing if there are none
+void hosts_print_skip_report(FILE *out);
+
+// Scheduler state for a crawl snapshot: concurrency limits and latencies,
+// budget and trap counts, and path pattern outcomes. Breakers and
+// Crawl-delays are not saved; breakers start closed and robots.txt is read
+// again. hosts_snapshot_read runs before the first fetch and returns the
+// hosts restored.
+void hosts_snapshot_write(FILE *out);
+int hosts_snapshot_read(struct SnapshotReader *in);
+
+#endif // HOSTS_H
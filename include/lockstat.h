@@ -0,0 +1,61 @@
+#ifndef LOCKSTAT_H
+#define LOCKSTAT_H
+
+#include <stdio.h>
+#include <pthread.h>
+
+// Instrumented locks, grouped by role
+typedef enum
+{
+    LOCK_DB_SHARD,   // Per-shard SQLite writer locks
+    LOCK_LOG_STORE,  // Log backend index and files
+    LOCK_WORK_QUEUE, // Thread pool work queue
+    LOCK_DNS_CACHE,  // DNS prefetch cache
+    LOCK_CLASS_COUNT
+} LockClass;
+
+// What the slow path records; see lockstat_enable()
+#define LOCKSTAT_COLLECT 1     // Acquisitions, wait and hold histograms
+#define LOCKSTAT_TRACE_WAITS 2 // Charge wait time to the current trace record
+
+extern int lockstat_flags;
+
+void lock_acquire_slow(pthread_mutex_t *mutex, LockClass lock_class);
+void lock_release_slow(pthread_mutex_t *mutex, LockClass lock_class);
+void lock_cond_wait_slow(pthread_cond_t *cond, pthread_mutex_t *mutex, LockClass lock_class);
+
+// Drop-in replacements for pthread_mutex_lock/unlock and pthread_cond_wait.
+// With instrumentation off they add a single predictable branch.
+static inline void lock_acquire(pthread_mutex_t *mutex, LockClass lock_class)
+{
+    if (__builtin_expect(lockstat_flags == 0, 1))
+        pthread_mutex_lock(mutex);
+    else
+        lock_acquire_slow(mutex, lock_class);
+}
+
+static inline void lock_release(pthread_mutex_t *mutex, LockClass lock_class)
+{
+    if (__builtin_expect(lockstat_flags == 0, 1))
+        pthread_mutex_unlock(mutex);
+    else
+        lock_release_slow(mutex, lock_class);
+}
+
+static inline void lock_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex, LockClass lock_class)
+{
+    if (__builtin_expect(lockstat_flags == 0, 1))
+        pthread_cond_wait(cond, mutex);
+    else
+        lock_cond_wait_slow(cond, mutex, lock_class);
+}
+
+// Turn on LOCKSTAT_* flags; call before worker threads start
+void lockstat_enable(int flags);
+int lockstat_is_collecting(void);
+
+// Shutdown report and Prometheus export (no-ops unless collecting)
+void lockstat_print_report(FILE *out);
+void lockstat_write_prometheus(FILE *out);
+
+#endif // LOCKSTAT_H
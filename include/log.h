@@ -0,0 +1,31 @@
+#ifndef LOG_H
+#define LOG_H
+
+typedef enum
+{
+    LOG_ERROR,
+    LOG_WARN,
+    LOG_INFO,
+    LOG_DEBUG
+} LogLevel;
+
+// Start the background writer. Until then, and after log_shutdown(),
+// messages are written synchronously.
+int log_init(LogLevel level);
+
+// Write out everything queued and stop the writer thread. Call once the
+// worker threads have stopped logging.
+void log_shutdown(void);
+
+// Format a message on the calling thread and queue it without locking.
+// If the ring is full the message is dropped and counted.
+void log_message(LogLevel level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+unsigned long log_dropped(void);
+
+#define log_error(...) log_message(LOG_ERROR, __VA_ARGS__)
+#define log_warn(...) log_message(LOG_WARN, __VA_ARGS__)
+#define log_info(...) log_message(LOG_INFO, __VA_ARGS__)
+#define log_debug(...) log_message(LOG_DEBUG, __VA_ARGS__)
+
+#endif // LOG_H
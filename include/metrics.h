@@ -0,0 +1,72 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+#include "storage.h"
+
+// Monotonic counters
+typedef enum
+{
+    METRIC_PAGES_CRAWLED,
+    METRIC_LINKS_FOUND,
+    METRIC_ERRORS,
+    METRIC_SKIPPED_URLS,
+    METRIC_BYTES_DOWNLOADED,
+    METRIC_NOT_MODIFIED,
+    METRIC_PAGES_CHANGED,
+    METRIC_REVISITS,
+    METRIC_CONTENT_SKIPPED,
+    METRIC_ROBOTS_DISALLOWED,
+    METRIC_SITEMAP_URLS,
+    METRIC_RETRIES,
+    METRIC_BREAKER_TRIPS,
+    METRIC_BYTES_DECODED,
+    METRIC_PAGES_TRUNCATED,
+    METRIC_REDIRECTS_REWRITTEN,
+    METRIC_ALIAS_DUPLICATES,
+    METRIC_TRAP_URLS,
+    METRIC_BUDGET_REFUSED,
+    METRIC_CONNECTIONS,
+    METRIC_DNS_PREFETCHED,
+    METRIC_DNS_CACHE_HITS,
+    METRIC_COUNTER_COUNT
+} MetricCounter;
+
+// Values that go up and down
+typedef enum
+{
+    GAUGE_QUEUE_DEPTH, // Pending URLs in storage
+    GAUGE_IN_FLIGHT,   // URLs being fetched or parsed
+    GAUGE_COUNT
+} MetricGauge;
+
+// Latency histograms
+typedef enum
+{
+    HIST_FETCH,
+    HIST_PARSE,
+    HIST_DB,
+    HIST_COUNT
+} MetricHistogram;
+
+// Updates are lock-free and land in the calling thread's own slot;
+// readers merge all slots on demand
+void metrics_add(MetricCounter counter, long delta);
+void metrics_gauge_add(MetricGauge gauge, long delta);
+void metrics_observe(MetricHistogram histogram, long long usec);
+
+long metrics_get(MetricCounter counter);
+long metrics_gauge_get(MetricGauge gauge);
+
+// Microseconds on the monotonic clock, for timing observations
+long long metrics_now_us(void);
+
+// Start counters from totals already stored for a resumed session
+void metrics_seed(const CrawlerStats *counts);
+
+// Write all metrics in Prometheus text format. The textfile variant writes
+// to a temporary file and renames it, so scrapers never see a partial file.
+void metrics_write_prometheus(FILE *out);
+int metrics_write_textfile(const char *path);
+
+#endif // METRICS_H
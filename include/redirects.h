@@ -0,0 +1,29 @@
+#ifndef REDIRECTS_H
+#define REDIRECTS_H
+
+#include <stdio.h>
+
+struct SnapshotReader;
+
+// URL alias map. Each fetch that followed redirects records its source URL
+// against the final one, and each page whose rel=canonical names another URL
+// records itself against that URL. Links to a known source are rewritten to
+// its target before the visited check, and a queued source is fetched at its
+// target directly, or skipped once the target is stored. The map lives for
+// the run, in a lock-free insert-only table of REDIRECT_TABLE_SIZE entries;
+// later aliases are not recorded.
+
+// Record that source ended at target; the first target recorded stays
+void redirect_record(const char *source, const char *target);
+
+// The final URL of source, or NULL if it is not known to redirect
+const char *redirect_lookup(const char *source);
+
+// Sources recorded so far
+int redirect_count(void);
+
+// The map for a crawl snapshot; reading returns the aliases restored
+void redirects_snapshot_write(FILE *out);
+int redirects_snapshot_read(struct SnapshotReader *in);
+
+#endif // REDIRECTS_H
@@ -0,0 +1,34 @@
+#ifndef RETRY_H
+#define RETRY_H
+
+// Fetches waiting to be attempted again, in a min-heap keyed by the time
+// they become due. The main loop dispatches due entries before new URLs.
+
+// A fetch to attempt again; url is malloc'd and owned by whoever holds it
+typedef struct
+{
+    char *url;
+    int depth;
+    int attempt; // Retries so far
+    long long due_us;
+} RetryEntry;
+
+// Queue retry number attempt (1 for the first) of a failed fetch after an
+// exponential backoff with jitter, or at not_before_us if that is later
+// (Retry-After). Returns 0 if retries are off, attempt exceeds MAX_RETRIES
+// or the queue is full.
+int retry_schedule(const char *url, int depth, int attempt, long long not_before_us);
+
+// Hold a URL until due_us without using up a retry, for hosts whose
+// circuit breaker is open. Returns 0 if the queue is full.
+int retry_defer(const char *url, int depth, int attempt, long long due_us);
+
+// Move up to max entries due by now_us into out, earliest first
+int retry_pop_due(RetryEntry *out, int max, long long now_us);
+
+// Entries waiting, due or not
+int retry_pending(void);
+
+void retry_cleanup(void);
+
+#endif // RETRY_H
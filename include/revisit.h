@@ -0,0 +1,21 @@
+#ifndef REVISIT_H
+#define REVISIT_H
+
+#include <time.h>
+
+// Visit history of one URL across sessions, as kept by storage
+typedef struct
+{
+    int visits;         // Fetches that returned the page (200 or 304)
+    int changes;        // Revisits that found the content changed
+    time_t first_visit; // Time of the first fetch
+} RevisitHistory;
+
+// Delay until a page should be fetched again, from its history including the
+// visit that just happened. Pages seen only once wait REVISIT_INITIAL_INTERVAL.
+// Pages that never changed back off exponentially. Pages that did change are
+// revisited after their estimated mean time between changes. The result is
+// clamped to [REVISIT_MIN_INTERVAL, REVISIT_MAX_INTERVAL].
+time_t revisit_interval(const RevisitHistory *history, time_t now);
+
+#endif // REVISIT_H
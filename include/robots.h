@@ -0,0 +1,30 @@
+#ifndef ROBOTS_H
+#define ROBOTS_H
+
+#include <stddef.h>
+
+// A host's compiled robots.txt group for our user agent. Plain Allow and
+// Disallow paths form a trie that is walked once per URL, remembering the
+// longest rule passed; rules with '*' are few and matched separately. The
+// longest matching rule wins and Allow wins ties (RFC 9309).
+typedef struct RobotsRules RobotsRules;
+
+// Compile a robots.txt body for the agent's product token ("WebCrawler").
+// Groups naming the agent are used if present, otherwise the "*" group.
+RobotsRules *robots_compile(const char *body, size_t length, const char *agent);
+void robots_free(RobotsRules *rules);
+
+// 1 if the path (with query) may be fetched
+int robots_match(const RobotsRules *rules, const char *path);
+long robots_crawl_delay_ms(const RobotsRules *rules);
+
+// Link-time check: lock-free, and allows URLs whose host has no rules yet
+int robots_allowed(const char *url);
+
+// Fetch-time check: loads the host's rules first if they are missing or
+// expired, from storage or else over the network (one thread per host, the
+// others wait), applies their Crawl-delay to the host's pacing and submits
+// the Sitemap: files they list (see sitemap.h)
+int robots_check(const char *url);
+
+#endif // ROBOTS_H
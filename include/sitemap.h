@@ -0,0 +1,22 @@
+#ifndef SITEMAP_H
+#define SITEMAP_H
+
+#include "threads.h"
+
+// Sitemap ingestion. A sitemap or sitemap index is downloaded to a temporary
+// file and stream-parsed through zlib (gzipped or plain) with the libxml2
+// reader, so memory use does not grow with its size. Its URLs go into the
+// frontier in batches, with their lastmod as a revisit hint; nested sitemaps
+// are queued as further tasks up to SITEMAP_MAX_NESTING levels.
+
+// Run sitemap tasks on pool; sitemaps submitted before this are ignored
+void sitemap_init(ThreadPool *pool);
+
+// Queue a sitemap for ingestion on a worker. Only its URLs on the host of
+// scope_url are accepted. Returns 0 if it was read within
+// SITEMAP_REFRESH_INTERVAL, SITEMAP_MAX_FILES is reached, or there is no pool.
+int sitemap_submit(const char *sitemap_url, const char *scope_url);
+
+void sitemap_cleanup(void);
+
+#endif // SITEMAP_H
@@ -0,0 +1,39 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// Crawl snapshot. The per-host scheduler state and the redirect map live
+// only for the run, so an interrupted crawl writes them to SNAPSHOT_FILE and
+// --resume maps the file and restores them before the first fetch. The
+// frontier and the visited set stay in storage, where the interrupted URLs
+// are pending again. The file is native-endian and only read back on the
+// machine and by the backend that wrote it.
+
+// Cursor over a mapped snapshot; reads past end set failed and return zeros
+typedef struct SnapshotReader
+{
+    const char *pos;
+    const char *end;
+    int failed;
+} SnapshotReader;
+
+void snapshot_put(FILE *out, const void *data, size_t size);
+void snapshot_put_string(FILE *out, const char *s);
+void snapshot_get(SnapshotReader *in, void *data, size_t size);
+// Read a string into buf; fails if it does not fit in buf_size
+void snapshot_get_string(SnapshotReader *in, char *buf, size_t buf_size);
+
+// Write the state of session_id through a temporary file; returns 0 on failure
+int snapshot_write(const char *path, int session_id);
+
+// Restore a snapshot of session_id written by the current backend. Returns 0
+// if there is none or it does not match; the crawl then starts cold.
+int snapshot_load(const char *path, int session_id);
+
+// Remove the snapshot if it belongs to session_id and the current backend,
+// leaving another session's in place; returns 1 if it was removed
+int snapshot_remove(const char *path, int session_id);
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,138 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "config.h"
+
+// Statistics structure
+typedef struct
+{
+    int pages_crawled;
+    int links_found;
+    int errors;
+    int skipped_urls;
+    int pending_urls;
+    time_t start_time;
+    int session_id;
+} CrawlerStats;
+
+// A URL handed out by dequeue_batch
+typedef struct
+{
+    char url[MAX_URL_LENGTH];
+    int depth;
+} QueuedURL;
+
+// Final state of a dequeued URL
+typedef enum
+{
+    URL_CRAWLED,
+    URL_ERROR,
+    URL_SKIPPED,
+    URL_PENDING // Back in the frontier unfetched, for an interrupted crawl
+} URLStatus;
+
+// HTTP cache validators of a fetched page; empty when the server sent none
+typedef struct
+{
+    char etag[VALIDATOR_LENGTH];
+    char last_modified[VALIDATOR_LENGTH];
+} PageValidators;
+
+// Receives one stored page during replay; content is only valid during the call
+typedef void (*StoredPageFn)(const char *url, const char *content, size_t content_length,
+                             int depth, void *arg);
+
+// Receives one stored link target; the URL is only valid during the call
+typedef void (*StoredLinkFn)(const char *target_url, void *arg);
+
+// Storage backend interface. Every operation acts on the current session
+// (stats.session_id) and is safe to call from any thread.
+typedef struct
+{
+    const char *name;
+
+    int (*init)(void);
+    void (*cleanup)(int completed); // completed marks the current session completed
+
+    // Session management
+    int (*create_session)(const char *start_url);
+    int (*resume_session)(void); // Latest running session, or -1
+    int (*get_session)(int session_id, char *start_url, size_t url_size, time_t *start_time);
+    void (*print_resume_info)(void);
+
+    // Pages, frontier and link graph
+    void (*save_page)(const char *url, const char *content, size_t content_length,
+                      long response_code, int depth);
+    int (*enqueue)(const char *url, int depth); // 1 if the URL was new to the session
+    int (*is_visited)(const char *url);
+    int (*dequeue_batch)(QueuedURL *out, int max); // Claims up to max unvisited URLs
+    int (*has_pending)(void);
+    void (*mark)(const char *url, URLStatus status);
+    void (*link_batch)(const char *source_url, const char *const *target_urls, int count);
+
+    // Fill the counters of *out from stored data
+    void (*stats)(CrawlerStats *out);
+
+    // Offline replay; NULL when the backend does not support it.
+    // replay_reset drops the session's link graph and pending frontier and
+    // returns 1, or -1 if the session does not exist, 0 on error;
+    // for_each_page streams its stored pages in crawl order to fn on the
+    // calling thread and returns how many there were, or -1 on error.
+    int (*replay_reset)(void);
+    int (*for_each_page)(StoredPageFn fn, void *arg);
+
+    // Conditional re-crawl; NULL when the backend does not support it.
+    // Validators are kept per URL across sessions, together with the session
+    // that last fetched the page. get_validators returns 1 if there are any;
+    // previous_links streams the links that session stored for the page and
+    // returns their count. save_validators makes the current session the
+    // owner, or forgets the URL when both validators are empty.
+    // save_unchanged_page stores a 304 as a page of the current session with
+    // the owner's body; call it before save_validators.
+    int (*get_validators)(const char *url, PageValidators *out);
+    int (*previous_links)(const char *url, StoredLinkFn fn, void *arg);
+    void (*save_validators)(const char *url, const PageValidators *validators);
+    void (*save_unchanged_page)(const char *url, int depth);
+
+    // Change tracking and revisits; NULL when the backend does not support it.
+    // record_visit adds a fetch to the URL's history across sessions, after
+    // a 200 (with the body's content_hash) or a 304 (not_modified), schedules
+    // its next visit and returns 1 if a revisit found the page changed.
+    // schedule_revisits puts up to max crawled URLs of the current session
+    // that are due by now back into the frontier and returns how many.
+    int (*record_visit)(const char *url, int not_modified, uint64_t content_hash);
+    int (*schedule_revisits)(time_t now, int max);
+
+    // robots.txt cache; NULL when the backend does not support it. Keeps the
+    // last response per host (status 0 = unreachable). load_robots returns 1
+    // if there is one, with a malloc'd body the caller frees.
+    int (*load_robots)(const char *host, long *status, char **body, size_t *length, time_t *fetched);
+    void (*save_robots)(const char *host, long status, const char *body, size_t length, time_t fetched);
+
+    // Bulk frontier insert for sitemaps; NULL when the backend does not
+    // support it, and callers fall back to enqueue. Returns how many URLs
+    // were new. A lastmod (0 = unknown) later than a URL's last visit makes
+    // its revisit due now.
+    int (*enqueue_batch)(const char *const *urls, const time_t *lastmod, int count, int depth);
+} StorageBackend;
+
+extern const StorageBackend sqlite_backend;
+extern const StorageBackend log_backend;
+
+// Active backend, selected before init
+extern const StorageBackend *storage;
+
+// Global session state (extern declaration); live counters are in metrics.h
+extern CrawlerStats stats;
+
+// Select a backend by name ("sqlite" or "log"); returns 0 if unknown
+int storage_select(const char *name);
+
+// Statistics
+void load_session_stats(void);
+void print_stats(void);
+
+#endif // STORAGE_H
@@ -34,6 +34,7 @@ ThreadPool *thread_pool_create(size_t num_threads);
 void thread_pool_destroy(ThreadPool *pool);
 bool thread_pool_add_work(ThreadPool *pool, void (*func)(void *), void *arg);
 void thread_pool_wait(ThreadPool *pool);
+size_t thread_pool_pending(ThreadPool *pool); // Queued plus running work items
 bool thread_pool_is_working(ThreadPool *pool);
 
 #endif // THREADS_H
\ No newline at end of file
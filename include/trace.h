@@ -0,0 +1,46 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <curl/curl.h>
+#include "config.h"
+
+// Per-URL timing breakdown. Curl phases are cumulative offsets from the
+// start of the transfer, as libcurl reports them; the rest are durations.
+typedef struct
+{
+    char url[TRACE_URL_LENGTH];
+    char host[TRACE_HOST_LENGTH];
+    long long start_us; // Monotonic clock, see metrics_now_us()
+    long long namelookup_us;
+    long long connect_us;
+    long long appconnect_us; // 0 for plain HTTP
+    long long starttransfer_us;
+    long long total_us;
+    long long parse_us;
+    long long db_us;        // Time inside storage calls, including lock waits
+    long long lock_wait_us; // Time blocked on storage locks
+    long response_code;
+    size_t bytes;
+    int thread;
+} TraceRecord;
+
+// Off until trace_enable(); when off every call below is a cheap no-op
+int trace_enable(void);
+int trace_is_enabled(void);
+
+// Start a record for url on the calling thread; returns NULL when disabled.
+// Fields are filled in by the caller and published by trace_end().
+TraceRecord *trace_begin(const char *url);
+TraceRecord *trace_current(void);
+void trace_set_curl_times(TraceRecord *record, CURL *curl);
+void trace_end(void);
+
+// Charge time spent blocked on a storage lock to the current URL
+void trace_add_lock_wait(long long usec);
+
+// Exports, run once all workers have finished
+int trace_write_chrome(const char *path);
+void trace_print_host_summary(FILE *out);
+
+#endif // TRACE_H
@@ -4,32 +4,27 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <unistd.h>
+#include <stdint.h>
 #include <time.h>
 #include <sys/stat.h>
 #include <sys/types.h>
-#include <stdarg.h>
 #include <curl/curl.h>
 #include <libxml/HTMLparser.h>
-#include <libxml/xpath.h>
 #include <libxml/uri.h>
-#include <signal.h>
+#include <pthread.h>
 #include "../include/config.h"
 #include "../include/crawler.h"
-#include "../include/database.h"
-#include "../include/threads.h"
-
-ThreadPool *thread_pool = NULL;
-pthread_mutex_t db_mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t console_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-// Structure to pass URL and depth to worker threads
-typedef struct
-{
-    char *url;
-    int depth;
-} CrawlTask;
+#include "../include/dns.h"
+#include "../include/storage.h"
+#include "../include/metrics.h"
+#include "../include/log.h"
+#include "../include/trace.h"
+#include "../include/hosts.h"
+#include "../include/robots.h"
+#include "../include/retry.h"
+#include "../include/redirects.h"
 
 char *my_strdup(const char *s)
 {
@@ -46,72 +41,6 @@ char *my_strdup(const char *s)
     return dup;
 }
 
-void safe_printf(const char *format, ...)
-{
-    va_list args;
-    va_start(args, format);
-
-    pthread_mutex_lock(&console_mutex);
-    vprintf(format, args);
-    fflush(stdout);
-    pthread_mutex_unlock(&console_mutex);
-
-    va_end(args);
-}
-
-// Database operations
-void safe_save_page_to_db(const char *url, const char *content, size_t content_length,
-                          long response_code, int depth)
-{
-    pthread_mutex_lock(&db_mutex);
-    save_page_to_db(url, content, content_length, response_code, depth);
-    pthread_mutex_unlock(&db_mutex);
-}
-
-void safe_add_url_to_queue(const char *url, int depth)
-{
-    pthread_mutex_lock(&db_mutex);
-    add_url_to_queue(url, depth);
-    pthread_mutex_unlock(&db_mutex);
-}
-
-int safe_is_url_visited(const char *url)
-{
-    pthread_mutex_lock(&db_mutex);
-    int result = is_url_visited(url);
-    pthread_mutex_unlock(&db_mutex);
-    return result;
-}
-
-void safe_mark_url_crawled(const char *url)
-{
-    pthread_mutex_lock(&db_mutex);
-    mark_url_crawled(url);
-    pthread_mutex_unlock(&db_mutex);
-}
-
-void safe_save_extracted_link(const char *source_url, const char *target_url)
-{
-    pthread_mutex_lock(&db_mutex);
-    save_extracted_link(source_url, target_url);
-    pthread_mutex_unlock(&db_mutex);
-}
-
-// Stats update
-void safe_increment_pages_crawled()
-{
-    pthread_mutex_lock(&stats_mutex);
-    stats.pages_crawled++;
-    pthread_mutex_unlock(&stats_mutex);
-}
-
-void safe_increment_errors()
-{
-    pthread_mutex_lock(&stats_mutex);
-    stats.errors++;
-    pthread_mutex_unlock(&stats_mutex);
-}
-
 // Function to create pages directory if it doesn't exist
 int create_pages_directory()
 {
@@ -157,6 +86,13 @@ size_t write_callback(void *contents, size_t size, size_t nmemb, WebPage *page)
         return 0;
     }
 
+    // Link-only crawls keep the start of the body and end the transfer there
+    if (page->limit > 0 && page->size + real_size > page->limit)
+    {
+        real_size = page->limit - page->size;
+        page->truncated = 1;
+    }
+
     // Check if we would exceed maximum page size
     if (page->size + real_size > MAX_PAGE_SIZE)
     {
@@ -188,7 +124,139 @@ size_t write_callback(void *contents, size_t size, size_t nmemb, WebPage *page)
     page->size += real_size;
     page->data[page->size] = '\0';
 
-    return real_size;
+    return page->truncated ? 0 : real_size; // A short count aborts the transfer
+}
+
+// Copy a header value without surrounding whitespace; values that do not
+// fit are dropped, since a truncated validator would never match
+static void copy_header_value(char *out, size_t out_size, const char *value, size_t len)
+{
+    while (len > 0 && (*value == ' ' || *value == '\t'))
+    {
+        value++;
+        len--;
+    }
+    while (len > 0 && (value[len - 1] == '\r' || value[len - 1] == '\n' ||
+                       value[len - 1] == ' ' || value[len - 1] == '\t'))
+        len--;
+
+    if (len < out_size)
+    {
+        memcpy(out, value, len);
+        out[len] = '\0';
+    }
+    else
+    {
+        out[0] = '\0';
+    }
+}
+
+// What the header callback learned about the response being received
+typedef struct
+{
+    PageValidators validators;
+    long status;              // Status code of the latest response
+    char content_type[128];   // Media type, lowercased, without parameters
+    long long content_length; // -1 when not announced
+    long retry_after;         // Seconds from a Retry-After delay, 0 when absent
+    int rejected;             // Transfer aborted at the header phase
+    int temporary_redirects;  // 302, 303 and 307 hops followed so far
+} ResponseHeaders;
+
+static int content_type_allowed(const char *type)
+{
+    if (!type[0])
+        return 1;
+
+    for (int i = 0; ALLOWED_CONTENT_TYPES[i] != NULL; i++)
+    {
+        if (strncmp(type, ALLOWED_CONTENT_TYPES[i], strlen(ALLOWED_CONTENT_TYPES[i])) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+static size_t truncate_bytes = (size_t)TRUNCATE_PAGE_KB * 1024;
+static int max_depth = MAX_DEPTH;
+
+void crawler_set_truncate_kb(long kb)
+{
+    truncate_bytes = kb > 0 ? (size_t)kb * 1024 : 0;
+}
+
+void crawler_set_max_depth(int depth)
+{
+    max_depth = depth >= 0 ? depth : MAX_DEPTH;
+}
+
+int crawler_max_depth(void)
+{
+    return max_depth;
+}
+
+// Callback for libcurl response headers. Only the last response counts, so a
+// redirect's own headers are discarded. Once the headers of a 200 are
+// complete, a body that is not HTML or is announced as larger than
+// MAX_PAGE_SIZE is refused before any of it is downloaded; when pages are
+// truncated anyway, only the content type matters.
+static size_t header_callback(char *buffer, size_t size, size_t nitems, void *userdata)
+{
+    ResponseHeaders *headers = userdata;
+    size_t len = size * nitems;
+
+    if (len >= 5 && strncmp(buffer, "HTTP/", 5) == 0)
+    {
+        // A new response, after a redirect or an interim 1xx
+        int temporary_redirects = headers->temporary_redirects;
+        memset(headers, 0, sizeof(*headers));
+        headers->content_length = -1;
+        const char *code = memchr(buffer, ' ', len);
+        headers->status = code ? strtol(code + 1, NULL, 10) : 0;
+        headers->temporary_redirects = temporary_redirects + (headers->status == 302 ||
+                                                              headers->status == 303 ||
+                                                              headers->status == 307);
+    }
+    else if (len > 5 && strncasecmp(buffer, "ETag:", 5) == 0)
+    {
+        copy_header_value(headers->validators.etag, sizeof(headers->validators.etag), buffer + 5, len - 5);
+    }
+    else if (len > 14 && strncasecmp(buffer, "Last-Modified:", 14) == 0)
+    {
+        copy_header_value(headers->validators.last_modified, sizeof(headers->validators.last_modified),
+                          buffer + 14, len - 14);
+    }
+    else if (len > 13 && strncasecmp(buffer, "Content-Type:", 13) == 0)
+    {
+        char *type = headers->content_type;
+        copy_header_value(type, sizeof(headers->content_type), buffer + 13, len - 13);
+        type[strcspn(type, "; ")] = '\0';
+        for (char *p = type; *p; p++)
+        {
+            if (*p >= 'A' && *p <= 'Z')
+                *p += 'a' - 'A';
+        }
+    }
+    else if (len > 15 && strncasecmp(buffer, "Content-Length:", 15) == 0)
+    {
+        // Header lines end in a newline, which stops the conversion
+        headers->content_length = strtoll(buffer + 15, NULL, 10);
+    }
+    else if (len > 12 && strncasecmp(buffer, "Retry-After:", 12) == 0)
+    {
+        // Only the delay-seconds form; an HTTP date leaves the backoff alone
+        headers->retry_after = strtol(buffer + 12, NULL, 10);
+    }
+    else if (headers->status == 200 && (buffer[0] == '\r' || buffer[0] == '\n'))
+    {
+        if (!content_type_allowed(headers->content_type) ||
+            (headers->content_length > MAX_PAGE_SIZE && truncate_bytes == 0))
+        {
+            headers->rejected = 1;
+            return 0; // Aborts the transfer
+        }
+    }
+
+    return len;
 }
 
 // Clean and normalize URL
@@ -215,6 +283,35 @@ void normalize_url(char *url)
     }
 }
 
+// Copy the lowercased host name of an absolute URL into host (empty if none)
+void get_url_host(const char *url, char *host, size_t host_size)
+{
+    if (!host || host_size == 0)
+        return;
+    host[0] = '\0';
+
+    if (!url)
+        return;
+
+    const char *start = strstr(url, "://");
+    start = start ? start + 3 : url;
+
+    // Skip any user:password@ prefix within the authority
+    const char *end = start + strcspn(start, "/?#");
+    const char *at = memchr(start, '@', end - start);
+    if (at)
+        start = at + 1;
+
+    size_t len = 0;
+    while (start[len] && !strchr(":/?#", start[len]) && len < host_size - 1)
+    {
+        char c = start[len];
+        host[len] = (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+        len++;
+    }
+    host[len] = '\0';
+}
+
 // Resolve relative URL to absolute URL
 char *resolve_url(const char *base_url, const char *relative_url)
 {
@@ -237,467 +334,809 @@ char *resolve_url(const char *base_url, const char *relative_url)
     return result;
 }
 
-// Extract links from HTML content
-void extract_links(const char *html, const char *base_url, int current_depth)
+// Links accepted from one page, stored in one batch
+typedef struct
 {
-    if (!html || !base_url)
+    char **urls;
+    int count;
+    int capacity;
+    int depth;         // Depth of the page the links came from
+    long long db_usec; // Storage time, reported separately from parsing
+} LinkList;
+
+// Filter a normalized absolute URL, enqueue it if unvisited and add it to the
+// page's links. Takes ownership of url.
+static void link_list_add(LinkList *list, char *url)
+{
+    // A link to a URL known to redirect stands for its final URL
+    const char *target = redirect_lookup(url);
+    char *rewritten = target ? my_strdup(target) : NULL;
+    if (rewritten)
     {
-        return;
+        metrics_add(METRIC_REDIRECTS_REWRITTEN, 1);
+        free(url);
+        url = rewritten;
     }
 
-    // Suppress libxml2 error messages
-    xmlSetGenericErrorFunc(NULL, NULL);
-
-    htmlDocPtr doc = htmlReadMemory(html, strlen(html), base_url, NULL,
-                                    HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING | HTML_PARSE_RECOVER);
-    if (!doc)
+    // Path patterns that keep answering with non-HTML content are deferred
+    if (should_skip_url(url) || host_should_defer(url) || host_is_down(url))
     {
-        safe_increment_errors();
+        metrics_add(METRIC_SKIPPED_URLS, 1);
+        free(url);
         return;
     }
-
-    xmlXPathContextPtr context = xmlXPathNewContext(doc);
-    if (!context)
+    if (!robots_allowed(url))
     {
-        xmlFreeDoc(doc);
-        safe_increment_errors();
+        metrics_add(METRIC_ROBOTS_DISALLOWED, 1);
+        free(url);
         return;
     }
 
-    // Look for both <a href> and <link href> tags
-    const char *xpath_expressions[] = {
-        "//a[@href]",
-        "//link[@href]",
-        NULL};
+    // Links beyond the maximum depth, or refused as traps or over budget, stay in
+    // the link graph but are not queued
+    long long db_start = metrics_now_us();
+    if (!storage->is_visited(url))
+    {
+        UrlAdmission admission;
+        if (list->depth + 1 > max_depth)
+            metrics_add(METRIC_SKIPPED_URLS, 1);
+        else if ((admission = host_admit_url(url)) != URL_ADMITTED)
+            metrics_add(admission == URL_HOST_BUDGET ? METRIC_BUDGET_REFUSED : METRIC_TRAP_URLS, 1);
+        else if (storage->enqueue(url, list->depth + 1))
+        {
+            host_record_queued(url);
+            dns_prefetch(url);
+            log_debug("Found link: %s (depth %d)\n", url, list->depth + 1);
+        }
+    }
+    list->db_usec += metrics_now_us() - db_start;
 
-    for (int expr_idx = 0; xpath_expressions[expr_idx] != NULL; expr_idx++)
+    // Every accepted link is an edge of the link graph,
+    // whether or not its target was already crawled
+    if (list->count == list->capacity)
     {
-        xmlXPathObjectPtr result = xmlXPathEvalExpression(
-            (xmlChar *)xpath_expressions[expr_idx], context);
+        int new_capacity = list->capacity ? list->capacity * 2 : 32;
+        char **ptr = realloc(list->urls, new_capacity * sizeof(char *));
+        if (ptr)
+        {
+            list->urls = ptr;
+            list->capacity = new_capacity;
+        }
+    }
+    if (list->count < list->capacity)
+        list->urls[list->count++] = url;
+    else
+        free(url);
+}
 
-        if (!result)
-            continue;
+// Store the page's links as one batch and release them
+static void link_list_store(LinkList *list, const char *source_url)
+{
+    long long db_start = metrics_now_us();
+    storage->link_batch(source_url, (const char *const *)list->urls, list->count);
+    list->db_usec += metrics_now_us() - db_start;
+
+    for (int i = 0; i < list->count; i++)
+        free(list->urls[i]);
+    free(list->urls);
+    list->urls = NULL;
+    list->count = list->capacity = 0;
+}
+
+// Kinds of link found in a page; LINK_FOLLOW says which ones are queued
+typedef enum
+{
+    LINK_ANCHOR,    // <a href>, and <link> navigation such as rel=next
+    LINK_AREA,      // <area href> in image maps
+    LINK_FRAME,     // <iframe src> and <frame src>
+    LINK_REFRESH,   // <meta http-equiv="refresh" content="N; url=...">
+    LINK_ALTERNATE, // <link rel=alternate>: translations, feeds, print versions
+    LINK_RESOURCE,  // Other <link href>: stylesheets, icons, preloads
+    LINK_CANONICAL, // <link rel=canonical>, handled before the other links
+    LINK_TYPE_COUNT
+} LinkType;
+
+static const int LINK_FOLLOW[LINK_TYPE_COUNT] = {
+    [LINK_ANCHOR] = 1,
+    [LINK_AREA] = FOLLOW_AREA_LINKS,
+    [LINK_FRAME] = FOLLOW_FRAME_LINKS,
+    [LINK_REFRESH] = FOLLOW_META_REFRESH,
+    [LINK_ALTERNATE] = FOLLOW_ALTERNATE_LINKS,
+    [LINK_RESOURCE] = FOLLOW_RESOURCE_LINKS,
+    [LINK_CANONICAL] = FOLLOW_CANONICAL_LINKS};
+
+// rel tokens of <link> elements that load part of the page, not another page
+static const char *RESOURCE_RELS[] = {
+    "stylesheet", "icon", "shortcut", "apple-touch-icon", "mask-icon", "manifest", "preload",
+    "modulepreload", "prefetch", "preconnect", "dns-prefetch", "prerender", "pingback", NULL};
+
+// Classify a <link> by its space-separated rel tokens
+static LinkType link_rel_type(const char *rel)
+{
+    LinkType type = LINK_ANCHOR;
+
+    for (const char *p = rel; p && *p;)
+    {
+        p += strspn(p, " \t\r\n");
+        size_t len = strcspn(p, " \t\r\n");
 
-        xmlNodeSetPtr nodes = result->nodesetval;
-        if (nodes)
+        if (len == 9 && strncasecmp(p, "canonical", 9) == 0)
+            return LINK_CANONICAL;
+        if (len == 9 && strncasecmp(p, "alternate", 9) == 0)
+        {
+            if (type == LINK_ANCHOR)
+                type = LINK_ALTERNATE;
+        }
+        else
         {
-            for (int i = 0; i < nodes->nodeNr; i++)
+            for (int i = 0; RESOURCE_RELS[i]; i++)
             {
-                xmlNodePtr node = nodes->nodeTab[i];
-                if (!node)
-                    continue;
-
-                xmlChar *href = xmlGetProp(node, (xmlChar *)"href");
-                if (href)
-                {
-                    char *absolute_url = resolve_url(base_url, (char *)href);
-                    if (absolute_url)
-                    {
-                        // Only process HTTP/HTTPS URLs
-                        if ((strncmp(absolute_url, "http://", 7) == 0 ||
-                             strncmp(absolute_url, "https://", 8) == 0) &&
-                            strlen(absolute_url) < MAX_URL_LENGTH)
-                        {
-
-                            normalize_url(absolute_url);
-
-                            if (!safe_is_url_visited(absolute_url) && !should_skip_url(absolute_url))
-                            {
-                                safe_add_url_to_queue(absolute_url, current_depth + 1);
-                                safe_save_extracted_link(base_url, absolute_url);
-
-                                if (VERBOSE_OUTPUT)
-                                {
-                                    safe_printf("Found link: %s (depth %d)\n", absolute_url, current_depth + 1);
-                                }
-                            }
-                        }
-                        free(absolute_url);
-                    }
-                    xmlFree(href);
-                }
+                if (strlen(RESOURCE_RELS[i]) == len && strncasecmp(p, RESOURCE_RELS[i], len) == 0)
+                    type = LINK_RESOURCE;
             }
         }
-        xmlXPathFreeObject(result);
+        p += len;
     }
+    return type;
+}
 
-    xmlXPathFreeContext(context);
-    xmlFreeDoc(doc);
+// The URL of a refresh directive such as "5; url='/next'" copied into buf,
+// or NULL if it has none
+static const char *refresh_url(const char *content, char *buf, size_t size)
+{
+    const char *p = content + strcspn(content, ";,");
+    if (!*p)
+        return NULL;
+    p++;
+    p += strspn(p, " \t");
+
+    if (strncasecmp(p, "url", 3) == 0)
+    {
+        const char *q = p + 3 + strspn(p + 3, " \t");
+        if (*q == '=')
+            p = q + 1 + strspn(q + 1, " \t");
+    }
+
+    char quote = (*p == '\'' || *p == '"') ? *p++ : '\0';
+    size_t len = quote ? strcspn(p, quote == '\'' ? "'" : "\"") : strlen(p);
+    while (len > 0 && (p[len - 1] == ' ' || p[len - 1] == '\t' || p[len - 1] == '\r' || p[len - 1] == '\n'))
+        len--;
+    if (len == 0 || len >= size)
+        return NULL;
+
+    memcpy(buf, p, len);
+    buf[len] = '\0';
+    return buf;
 }
 
-// Download and process a single URL
-int crawl_url(const char *url, int depth)
+// Resolve href against base to a normalized HTTP(S) URL, or NULL
+static char *absolute_link(const char *base, const char *href)
 {
+    char *url = resolve_url(base, href);
     if (!url)
-        return 0;
-
-    safe_printf("Thread %ld crawling: %s (depth %d)\n", (long)pthread_self(), url, depth);
+        return NULL;
 
-    CURL *curl = curl_easy_init();
-    if (!curl)
+    if ((strncmp(url, "http://", 7) == 0 || strncmp(url, "https://", 8) == 0) &&
+        strlen(url) < MAX_URL_LENGTH)
     {
-        safe_printf("Thread %ld: Failed to initialize curl for %s\n", (long)pthread_self(), url);
-        safe_increment_errors();
-        return 0;
+        normalize_url(url);
+        return url;
     }
+    free(url);
+    return NULL;
+}
 
-    WebPage page = {0};
-    page.capacity = INITIAL_PAGE_SIZE;
-    page.data = malloc(page.capacity);
-    if (!page.data)
+// Read <base href> and <link rel=canonical> from the document head; both
+// apply to the whole page. *base is the URL relative links resolve against.
+static void scan_head(htmlDocPtr doc, const char *page_url, char **base, char **canonical)
+{
+    xmlNodePtr root = xmlDocGetRootElement(doc);
+    xmlNodePtr head = root ? root->children : NULL;
+    while (head && !(head->type == XML_ELEMENT_NODE && strcmp((const char *)head->name, "head") == 0))
+        head = head->next;
+
+    for (xmlNodePtr node = head ? head->children : NULL; node; node = node->next)
     {
-        safe_printf("Thread %ld: Failed to allocate memory for %s\n", (long)pthread_self(), url);
-        curl_easy_cleanup(curl);
-        safe_increment_errors();
-        return 0;
-    }
+        if (node->type != XML_ELEMENT_NODE)
+            continue;
 
-    // Configure curl
-    curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &page);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl, CURLOPT_MAXREDIRS, MAX_REDIRECTS);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, REQUEST_TIMEOUT);
-    curl_easy_setopt(curl, CURLOPT_USERAGENT, USER_AGENT);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, SSL_VERIFY_PEER);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, SSL_VERIFY_HOST);
+        const char *name = (const char *)node->name;
+        if (!*base && strcmp(name, "base") == 0)
+        {
+            // Not normalized: a trailing slash decides how links resolve
+            xmlChar *href = xmlGetProp(node, (xmlChar *)"href");
+            if (href)
+            {
+                *base = resolve_url(page_url, (const char *)href);
+                xmlFree(href);
+            }
+        }
+        else if (!*canonical && strcmp(name, "link") == 0)
+        {
+            xmlChar *rel = xmlGetProp(node, (xmlChar *)"rel");
+            xmlChar *href = rel && link_rel_type((const char *)rel) == LINK_CANONICAL
+                                ? xmlGetProp(node, (xmlChar *)"href")
+                                : NULL;
+            if (href)
+                *canonical = absolute_link(page_url, (const char *)href);
+            xmlFree(href);
+            xmlFree(rel);
+        }
+    }
+}
 
-    CURLcode res = curl_easy_perform(curl);
-    long response_code = 0;
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+// Type of the link an element carries and the attribute holding it;
+// LINK_TYPE_COUNT if it carries none
+static LinkType element_link(xmlNodePtr node, const char **attribute)
+{
+    const char *name = (const char *)node->name;
+    *attribute = "href";
 
-    int success = 0;
-    if (res != CURLE_OK)
+    switch (name[0])
     {
-        safe_printf("Thread %ld: curl failed for %s: %s\n",
-                    (long)pthread_self(), url, curl_easy_strerror(res));
-        safe_increment_errors();
+    case 'a':
+        if (strcmp(name, "a") == 0)
+            return LINK_ANCHOR;
+        if (strcmp(name, "area") == 0)
+            return LINK_AREA;
+        break;
+    case 'f':
+    case 'i':
+        if (strcmp(name, "iframe") == 0 || strcmp(name, "frame") == 0)
+        {
+            *attribute = "src";
+            return LINK_FRAME;
+        }
+        break;
+    case 'l':
+        if (strcmp(name, "link") == 0)
+        {
+            xmlChar *rel = xmlGetProp(node, (xmlChar *)"rel");
+            LinkType type = link_rel_type((const char *)rel);
+            xmlFree(rel);
+            return type;
+        }
+        break;
+    case 'm':
+        if (strcmp(name, "meta") == 0)
+        {
+            xmlChar *equiv = xmlGetProp(node, (xmlChar *)"http-equiv");
+            int refresh = equiv && strcasecmp((const char *)equiv, "refresh") == 0;
+            xmlFree(equiv);
+            *attribute = "content";
+            return refresh ? LINK_REFRESH : LINK_TYPE_COUNT;
+        }
+        break;
     }
-    else if (response_code == 200 && page.data && page.size > 0)
+    return LINK_TYPE_COUNT;
+}
+
+// Extract links from HTML content. A page whose rel=canonical names another
+// URL makes its own URL an alias of that one; if the canonical page is
+// already stored, the page is a duplicate and its links are not followed.
+void extract_links(const char *html, const char *base_url, int current_depth)
+{
+    if (!html || !base_url)
     {
-        safe_printf("Thread %ld: Successfully downloaded %s (%zu bytes)\n",
-                    (long)pthread_self(), url, page.size);
+        return;
+    }
 
-        safe_increment_pages_crawled();
-        success = 1;
+    long long parse_start = metrics_now_us();
 
-        // Save to database
-        safe_save_page_to_db(url, page.data, page.size, response_code, depth);
+    // Suppress libxml2 error messages
+    xmlSetGenericErrorFunc(NULL, NULL);
 
-        // Extract links from the page
-        extract_links(page.data, url, depth);
+    htmlDocPtr doc = htmlReadMemory(html, strlen(html), base_url, NULL,
+                                    HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING | HTML_PARSE_RECOVER);
+    if (!doc)
+    {
+        metrics_add(METRIC_ERRORS, 1);
+        return;
+    }
 
-        // Save page content if enabled
-        if (SAVE_PAGES)
-        {
-            static int file_counter = 0;
-            static pthread_mutex_t file_mutex = PTHREAD_MUTEX_INITIALIZER;
+    LinkList links = {.depth = current_depth};
+    char *base = NULL;
+    char *canonical = NULL;
+    scan_head(doc, base_url, &base, &canonical);
+    const char *resolve_base = base ? base : base_url;
 
-            pthread_mutex_lock(&file_mutex);
-            file_counter++;
-            char filename[512];
-            snprintf(filename, sizeof(filename), "pages/%sthread_%ld_%d.html",
-                     PAGE_FILE_PREFIX, (long)pthread_self(), file_counter);
-            pthread_mutex_unlock(&file_mutex);
+    if (canonical)
+    {
+        char page[MAX_URL_LENGTH];
+        char page_host[256], canonical_host[256];
+        snprintf(page, sizeof(page), "%s", base_url);
+        normalize_url(page);
+        get_url_host(page, page_host, sizeof(page_host));
+        get_url_host(canonical, canonical_host, sizeof(canonical_host));
+
+        if (strcmp(canonical, page) == 0 || (CANONICAL_SAME_HOST && strcmp(page_host, canonical_host) != 0))
+        {
+            free(canonical);
+            canonical = NULL;
+        }
+        else
+        {
+            redirect_record(page, canonical);
+            long long db_start = metrics_now_us();
+            int duplicate = storage->is_visited(canonical);
+            links.db_usec += metrics_now_us() - db_start;
 
-            FILE *f = fopen(filename, "w");
-            if (f)
+            if (duplicate)
             {
-                fwrite(page.data, 1, page.size, f);
-                fclose(f);
-                safe_printf("Thread %ld: Saved content to %s\n", (long)pthread_self(), filename);
+                log_info("Not following links of %s, an alternate of %s\n", page, canonical);
+                metrics_add(METRIC_ALIAS_DUPLICATES, 1);
+                free(canonical);
+                canonical = NULL;
+                goto done;
             }
         }
     }
+
+    if (canonical && LINK_FOLLOW[LINK_CANONICAL])
+        link_list_add(&links, canonical);
     else
+        free(canonical);
+
+    // Walk the element tree in document order
+    xmlNodePtr node = doc->children;
+    while (node)
     {
-        safe_printf("Thread %ld: HTTP error %ld for %s\n", (long)pthread_self(), response_code, url);
-        safe_increment_errors();
+        const char *attribute;
+        LinkType type = node->type == XML_ELEMENT_NODE ? element_link(node, &attribute) : LINK_TYPE_COUNT;
+
+        if (type != LINK_TYPE_COUNT && type != LINK_CANONICAL && LINK_FOLLOW[type])
+        {
+            xmlChar *value = xmlGetProp(node, (xmlChar *)attribute);
+            char refresh[MAX_URL_LENGTH];
+            const char *href = !value ? NULL
+                               : type == LINK_REFRESH ? refresh_url((const char *)value, refresh, sizeof(refresh))
+                                                      : (const char *)value;
+            char *url = href ? absolute_link(resolve_base, href) : NULL;
+            if (url)
+                link_list_add(&links, url);
+            xmlFree(value);
+        }
+
+        if (node->type == XML_ELEMENT_NODE && node->children)
+        {
+            node = node->children;
+            continue;
+        }
+        while (node && !node->next)
+            node = node->parent;
+        if (node)
+            node = node->next;
     }
 
-    if (page.data)
-        free(page.data);
-    curl_easy_cleanup(curl);
+done:
+    link_list_store(&links, base_url);
+    long long db_usec = links.db_usec;
 
-    return success;
+    free(base);
+    xmlFreeDoc(doc);
+
+    long long parse_usec = metrics_now_us() - parse_start - db_usec;
+    metrics_observe(HIST_DB, db_usec);
+    metrics_observe(HIST_PARSE, parse_usec);
+
+    TraceRecord *trace = trace_current();
+    if (trace)
+    {
+        trace->parse_us = parse_usec;
+        trace->db_us += db_usec;
+    }
 }
 
-// Worker function for thread pool
-static void crawl_task_worker(void *arg)
+// 64-bit FNV-1a hash of a page body, for change detection across visits
+static uint64_t content_hash(const char *data, size_t size)
 {
-    CrawlTask *task = (CrawlTask *)arg;
-    if (task)
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++)
     {
-        crawl_url(task->url, task->depth);
-        free(task->url);
-        free(task);
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
     }
+    return hash;
 }
 
-// Performance monitoring function
-void print_performance_stats()
+static void add_previous_link(const char *target_url, void *arg)
 {
-    static time_t last_check = 0;
-    static int last_pages_crawled = 0;
-
-    time_t current_time = time(NULL);
-    if (current_time - last_check >= 60)
-    { // Print every 60 seconds
-        pthread_mutex_lock(&stats_mutex);
-        int current_pages = stats.pages_crawled;
-        pthread_mutex_unlock(&stats_mutex);
+    char *url = my_strdup(target_url);
+    if (url)
+        link_list_add(arg, url);
+}
 
-        if (last_check > 0)
-        {
-            double rate = (double)(current_pages - last_pages_crawled) / (current_time - last_check);
-            safe_printf("Performance: %.2f pages/second (Total: %d pages)\n", rate, current_pages);
-        }
+// A 304 means the links stored by the session that last fetched the page
+// still hold; adopt them into this session without downloading or parsing.
+// Returns the storage time spent.
+static long long relink_unchanged_page(const char *url, int depth)
+{
+    LinkList links = {.depth = depth};
+    storage->previous_links(url, add_previous_link, &links);
+    link_list_store(&links, url);
+    return links.db_usec;
+}
 
-        last_check = current_time;
-        last_pages_crawled = current_pages;
-    }
+// Validators are looked up under the queued URL by later sessions, and
+// joined to the stored links under the URL the page was served from
+static void save_validators(const char *url, const char *page_url, const PageValidators *validators)
+{
+    storage->save_validators(url, validators);
+    if (strcmp(page_url, url) != 0)
+        storage->save_validators(page_url, validators);
 }
 
-int main(int argc, char *argv[])
+// Request headers that revalidate a page fetched by an earlier session
+static struct curl_slist *validator_headers(const PageValidators *validators)
 {
-    int resume_mode = 0;
-    char *start_url = NULL;
+    struct curl_slist *headers = NULL;
+    char header[VALIDATOR_LENGTH + 32];
 
-    // Parse command line arguments
-    if (argc == 2)
+    if (validators->etag[0])
     {
-        if (strcmp(argv[1], "--resume") == 0)
-        {
-            resume_mode = 1;
-        }
-        else
-        {
-            start_url = argv[1];
-        }
+        snprintf(header, sizeof(header), "If-None-Match: %s", validators->etag);
+        headers = curl_slist_append(headers, header);
     }
-    else if (argc == 3 && strcmp(argv[1], "--resume") == 0)
+    if (validators->last_modified[0])
     {
-        resume_mode = 1;
-        stats.session_id = atoi(argv[2]);
+        snprintf(header, sizeof(header), "If-Modified-Since: %s", validators->last_modified);
+        headers = curl_slist_append(headers, header);
     }
-    else if (argc != 2)
+    return headers;
+}
+
+// Failures worth retrying
+static int transient_failure(CURLcode res, long response_code)
+{
+    switch (res)
     {
-        fprintf(stderr, "Usage: %s <starting_url>\n", argv[0]);
-        fprintf(stderr, "       %s --resume [session_id]\n", argv[0]);
-        fprintf(stderr, "Examples:\n");
-        fprintf(stderr, "  %s https://example.com\n", argv[0]);
-        fprintf(stderr, "  %s --resume\n", argv[0]);
-        fprintf(stderr, "  %s --resume 5\n", argv[0]);
+    case CURLE_OK:
+        return response_code == 408 || response_code == 429 || response_code >= 500;
+    case CURLE_COULDNT_RESOLVE_HOST:
+    case CURLE_COULDNT_CONNECT:
+    case CURLE_OPERATION_TIMEDOUT:
+    case CURLE_SEND_ERROR:
+    case CURLE_RECV_ERROR:
+    case CURLE_GOT_NOTHING:
+    case CURLE_PARTIAL_FILE:
+    case CURLE_SSL_CONNECT_ERROR:
         return 1;
+    default:
+        return 0;
     }
+}
 
-    // Validate starting URL if not in resume mode
-    if (!resume_mode && start_url)
-    {
-        if (strncmp(start_url, "http://", 7) != 0 && strncmp(start_url, "https://", 8) != 0)
-        {
-            fprintf(stderr, "Error: URL must start with http:// or https://\n");
-            return 1;
-        }
-    }
+// Failures that count against the host's breaker: it did not answer, or its
+// gateway reported it unavailable. Other errors belong to the page, and a host
+// with a few broken pages would otherwise trip once only those are left.
+static int host_failure(CURLcode res, long response_code)
+{
+    if (res != CURLE_OK)
+        return transient_failure(res, 0);
+    return response_code == 502 || response_code == 503 || response_code == 504;
+}
 
-    // Initialize database
-    if (!init_database())
+// Record a failed fetch and queue its next attempt if the failure was transient
+static void fetch_failed(const char *url, int depth, int attempt, CURLcode res, long response_code,
+                         long retry_after)
+{
+    int transient = transient_failure(res, response_code);
+    metrics_add(METRIC_ERRORS, 1);
+    storage->mark(url, URL_ERROR);
+    host_breaker_record(url, host_failure(res, response_code));
+
+    if (retry_after > RETRY_MAX_DELAY_MS / 1000)
+        retry_after = RETRY_MAX_DELAY_MS / 1000;
+    long long not_before = retry_after > 0 ? metrics_now_us() + retry_after * 1000000LL : 0;
+    if (transient && retry_schedule(url, depth, attempt + 1, not_before))
     {
-        fprintf(stderr, "Failed to initialize database\n");
-        return 1;
+        metrics_add(METRIC_RETRIES, 1);
+        log_info("Thread %ld: Will retry %s (attempt %d of %d)\n",
+                 (long)pthread_self(), url, attempt + 1, MAX_RETRIES);
     }
+}
 
-    // Initialize thread pool
-    safe_printf("Creating thread pool with %d threads\n", MAX_THREADS);
-    thread_pool = thread_pool_create(MAX_THREADS);
-    if (!thread_pool)
-    {
-        fprintf(stderr, "Failed to create thread pool\n");
-        return 1;
-    }
+// After a transfer that followed redirects, return the final URL
+// (normalized into buf); otherwise return url. url is mapped to it only if
+// every hop was permanent, so a bounce to a login page or a locale does not
+// rewrite later links.
+static const char *record_redirect(CURL *curl, const char *url, int permanent, char *buf, size_t size)
+{
+    char *effective = NULL;
+    curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &effective);
+    if (!effective || strlen(effective) >= size)
+        return url;
+
+    // Redirects that only differ in what normalize_url drops (fragment,
+    // trailing slash) cannot be told apart from the source
+    char source[MAX_URL_LENGTH];
+    snprintf(source, sizeof(source), "%s", url);
+    normalize_url(source);
+    strcpy(buf, effective);
+    normalize_url(buf);
+    if (strcmp(buf, source) == 0)
+        return url;
+
+    if (permanent)
+        redirect_record(url, buf);
+    return buf;
+}
 
-    // Handle resume mode
-    if (resume_mode)
-    {
-        if (stats.session_id == 0)
-        {
-            // Auto-resume latest session
-            stats.session_id = resume_crawl_session();
-            if (stats.session_id == -1)
-            {
-                print_resume_info();
-                cleanup_database();
-                return 1;
-            }
-        }
+static pthread_key_t handle_key;
+static pthread_once_t handle_once = PTHREAD_ONCE_INIT;
 
-        // Verify session exists and is active
-        const char *sql = "SELECT start_url, start_time FROM crawl_sessions WHERE id = ? AND status = 'running'";
-        sqlite3_stmt *stmt;
-        if (sqlite3_prepare_v2(crawler_db.db, sql, -1, &stmt, NULL) != SQLITE_OK)
-        {
-            fprintf(stderr, "Database error\n");
-            cleanup_database();
-            return 1;
-        }
+static void free_handle(void *curl)
+{
+    curl_easy_cleanup(curl);
+}
 
-        sqlite3_bind_int(stmt, 1, stats.session_id);
-        if (sqlite3_step(stmt) != SQLITE_ROW)
-        {
-            fprintf(stderr, "Session %d not found or not active\n", stats.session_id);
-            sqlite3_finalize(stmt);
-            print_resume_info();
-            cleanup_database();
-            return 1;
-        }
+static void create_handle_key(void)
+{
+    pthread_key_create(&handle_key, free_handle);
+}
 
-        const char *db_url = (const char *)sqlite3_column_text(stmt, 0);
-        start_url = my_strdup(db_url);
-        if (!start_url)
-        {
-            fprintf(stderr, "Failed to allocate memory for start URL\n");
-            sqlite3_finalize(stmt);
-            cleanup_database();
-            return 1;
-        }
+// The calling thread's curl handle, reset to default options. Its connection
+// cache, DNS cache and TLS sessions survive the reset, so consecutive fetches
+// from one host reuse the connection.
+static CURL *thread_handle(void)
+{
+    pthread_once(&handle_once, create_handle_key);
+    CURL *curl = pthread_getspecific(handle_key);
+    if (curl)
+        curl_easy_reset(curl);
+    else if ((curl = curl_easy_init()) != NULL)
+        pthread_setspecific(handle_key, curl);
+    return curl;
+}
 
-        stats.start_time = sqlite3_column_int64(stmt, 1);
-        sqlite3_finalize(stmt);
+// Download and process a single URL. Queue state and revisit history are
+// kept under url, which later sessions queue again; the page and its links
+// under the URL it was finally served from; validators under both.
+int crawl_url(const char *url, int depth, int attempt)
+{
+    if (!url)
+        return 0;
 
-        printf("Resuming crawl session %d\n", stats.session_id);
-        printf("Original start URL: %s\n", start_url);
+    // A URL queued before it was known to redirect, or to be an alternate
+    // of a canonical URL, is fetched at its target or not at all
+    const char *fetch_url = redirect_lookup(url);
+    if (fetch_url && storage->is_visited(fetch_url))
+    {
+        log_info("Thread %ld: %s is stored as %s\n", (long)pthread_self(), url, fetch_url);
+        metrics_add(METRIC_ALIAS_DUPLICATES, 1);
+        storage->mark(url, URL_SKIPPED);
+        return 0;
     }
+    if (fetch_url)
+        metrics_add(METRIC_REDIRECTS_REWRITTEN, 1);
     else
+        fetch_url = url;
+
+    // Links are checked against the rules known when they were found; the
+    // host's robots.txt is only certain to be loaded here
+    if (!robots_check(fetch_url))
     {
-        // Create new session
-        stats.session_id = create_crawl_session(start_url);
-        if (stats.session_id == -1)
-        {
-            fprintf(stderr, "Failed to create crawl session\n");
-            cleanup_database();
-            return 1;
-        }
+        log_info("Thread %ld: Disallowed by robots.txt: %s\n", (long)pthread_self(), url);
+        metrics_add(METRIC_ROBOTS_DISALLOWED, 1);
+        storage->mark(url, URL_SKIPPED);
+        return 0;
+    }
+    host_pace(fetch_url);
 
-        stats.start_time = time(NULL);
+    log_info("Thread %ld crawling: %s (depth %d)\n", (long)pthread_self(), fetch_url, depth);
 
-        // Add initial URL to queue
-        add_url_to_queue(start_url, 0);
+    CURL *curl = thread_handle();
+    if (!curl)
+    {
+        log_error("Thread %ld: Failed to initialize curl for %s\n", (long)pthread_self(), url);
+        metrics_add(METRIC_ERRORS, 1);
+        return 0;
+    }
 
-        printf("Starting new crawl session %d\n", stats.session_id);
+    WebPage page = {0};
+    page.capacity = INITIAL_PAGE_SIZE;
+    page.limit = truncate_bytes;
+    page.data = malloc(page.capacity);
+    if (!page.data)
+    {
+        log_error("Thread %ld: Failed to allocate memory for %s\n", (long)pthread_self(), url);
+        metrics_add(METRIC_ERRORS, 1);
+        return 0;
     }
 
-    // Create pages directory if it doesn't exist
-    if (!create_pages_directory())
+    // Configure curl
+    curl_easy_setopt(curl, CURLOPT_URL, fetch_url);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &page);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_MAXREDIRS, MAX_REDIRECTS);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, REQUEST_TIMEOUT);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, USER_AGENT);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, SSL_VERIFY_PEER);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, SSL_VERIFY_HOST);
+    if (ENABLE_COMPRESSION)
+        curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, ""); // Decoded before write_callback
+    if (ENABLE_HTTP2)
+        curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+
+    // Connect to the prefetched address without a lookup of our own
+    struct curl_slist *resolve = dns_resolve_list(fetch_url);
+    if (resolve)
+        curl_easy_setopt(curl, CURLOPT_RESOLVE, resolve);
+
+    ResponseHeaders response = {.content_length = -1};
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_callback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &response);
+
+    // Revalidate if an earlier session already fetched the page
+    int conditional = CONDITIONAL_RECRAWL && storage->get_validators != NULL;
+    PageValidators previous = {"", ""};
+    PageValidators *received = &response.validators;
+    struct curl_slist *headers = NULL;
+    if (conditional)
     {
-        fprintf(stderr, "Failed to create pages directory. Continuing without saving pages.\n");
+        long long db_start = metrics_now_us();
+        if (storage->get_validators(fetch_url, &previous))
+            headers = validator_headers(&previous);
+        metrics_observe(HIST_DB, metrics_now_us() - db_start);
+
+        if (headers)
+            curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
     }
 
-    // Initialize libraries
-    curl_global_init(CURL_GLOBAL_DEFAULT);
-    xmlInitParser();
-    LIBXML_TEST_VERSION;
+    TraceRecord *trace = trace_begin(url);
 
-    // Start/Resume crawling
-    printf("=====================================\n");
-    printf("Session ID: %d\n", stats.session_id);
-    printf("Start URL: %s\n", start_url);
-    printf("Max depth: %d\n", MAX_DEPTH);
-    printf("Max URLs: %d\n", MAX_URLS);
-    printf("Delay between requests: %d seconds\n", DELAY_SECONDS);
-    printf("Database: %s\n", DB_NAME);
-    printf("=====================================\n\n");
+    long long fetch_start = metrics_now_us();
+    CURLcode res = curl_easy_perform(curl);
+    metrics_observe(HIST_FETCH, metrics_now_us() - fetch_start);
+    long response_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
 
-    // Main crawling loop
-    char current_url[MAX_URL_LENGTH];
-    int current_depth;
-    int urls_processed = 0;
+    // A body cut off at the truncation limit is a complete link-only fetch
+    if (res == CURLE_WRITE_ERROR && page.truncated)
+    {
+        res = CURLE_OK;
+        metrics_add(METRIC_PAGES_TRUNCATED, 1);
+    }
 
-    while (stats.pages_crawled < MAX_URLS)
+    // Body bytes as sent, which are compressed when the server encoded them
+    curl_off_t wire_bytes = 0;
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &wire_bytes);
+    metrics_add(METRIC_BYTES_DOWNLOADED, (long)wire_bytes);
+    metrics_add(METRIC_BYTES_DECODED, (long)page.size);
+    host_record_transfer(url, wire_bytes, page.size);
+
+    long connects = 0;
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+    metrics_add(METRIC_CONNECTIONS, connects);
+
+    // Only a redirect that ends at a page is worth mapping
+    char final_url[MAX_URL_LENGTH];
+    const char *page_url = fetch_url;
+    if (res == CURLE_OK && (response_code == 200 || response_code == 304))
+        page_url = record_redirect(curl, url, !response.temporary_redirects, final_url, sizeof(final_url));
+
+    // Time to first byte drives the host's concurrency limit
+    curl_off_t first_byte_us = -1;
+    if (response_code > 0)
+        curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &first_byte_us);
+    host_record_latency(url, first_byte_us,
+                        res == CURLE_OPERATION_TIMEDOUT || response_code == 429 || response_code == 503);
+
+    if (trace)
     {
-        // Get next URL with proper locking
-        pthread_mutex_lock(&db_mutex);
-        int has_url = get_next_url(current_url, &current_depth);
+        trace_set_curl_times(trace, curl);
+        trace->response_code = response_code;
+        trace->bytes = page.size;
+    }
 
-        if (!has_url)
-        {
-            pthread_mutex_unlock(&db_mutex);
-            // Wait a bit and check again, or break if no more work
-            usleep(500000); // 0.5 second
+    int success = 0;
+    if (response.rejected)
+    {
+        const char *reason = content_type_allowed(response.content_type) ? "oversized" : response.content_type;
+        log_info("Thread %ld: Skipped %s (%s, %lld bytes announced)\n",
+                 (long)pthread_self(), url, reason, response.content_length);
+        metrics_add(METRIC_CONTENT_SKIPPED, 1);
+        host_record_skip(url, reason);
+        host_breaker_record(url, 0);
+        storage->mark(url, URL_SKIPPED);
+    }
+    else if (res != CURLE_OK)
+    {
+        log_warn("Thread %ld: curl failed for %s: %s\n",
+                 (long)pthread_self(), url, curl_easy_strerror(res));
+        fetch_failed(url, depth, attempt, res, 0, 0);
+    }
+    else if (response_code == 200 && page.data && page.size > 0)
+    {
+        log_info("Thread %ld: Successfully downloaded %s (%zu bytes)\n",
+                 (long)pthread_self(), url, page.size);
 
-            // Check if thread pool is idle and no more URLs
-            pthread_mutex_lock(&db_mutex);
-            int queue_empty = !get_next_url(current_url, &current_depth);
-            pthread_mutex_unlock(&db_mutex);
+        metrics_add(METRIC_PAGES_CRAWLED, 1);
+        host_record_fetch(url);
+        host_breaker_record(url, 0);
+        success = 1;
 
-            if (queue_empty && thread_pool->working_count == 0)
-            {
-                break; // No more work to do
-            }
-            continue;
-        }
+        // Save to storage
+        long long db_start = metrics_now_us();
+        storage->save_page(page_url, page.data, page.size, response_code, depth);
+        if (conditional)
+            save_validators(url, page_url, received);
+        if (storage->record_visit && storage->record_visit(url, 0, content_hash(page.data, page.size)))
+            metrics_add(METRIC_PAGES_CHANGED, 1);
+        long long db_usec = metrics_now_us() - db_start;
+        metrics_observe(HIST_DB, db_usec);
+        if (trace)
+            trace->db_us += db_usec;
 
-        // Check if already visited while holding the lock
-        int already_visited = is_url_visited(current_url);
-        if (!already_visited)
-        {
-            // Mark as visited immediately to prevent other threads from picking it up
-            mark_url_crawled(current_url);
-        }
-        pthread_mutex_unlock(&db_mutex);
+        // Extract links from the page
+        extract_links(page.data, page_url, depth);
 
-        if (!already_visited)
+        // Save page content if enabled
+        if (SAVE_PAGES)
         {
-            // Create a task for the thread pool
-            CrawlTask *task = malloc(sizeof(CrawlTask));
-            if (task)
+            static int file_counter = 0;
+            static pthread_mutex_t file_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+            pthread_mutex_lock(&file_mutex);
+            file_counter++;
+            char filename[512];
+            snprintf(filename, sizeof(filename), "pages/%sthread_%ld_%d.html",
+                     PAGE_FILE_PREFIX, (long)pthread_self(), file_counter);
+            pthread_mutex_unlock(&file_mutex);
+
+            FILE *f = fopen(filename, "w");
+            if (f)
             {
-                task->url = my_strdup(current_url);
-                task->depth = current_depth;
-
-                if (task->url)
-                {
-                    thread_pool_add_work(thread_pool, crawl_task_worker, task);
-                    urls_processed++;
-
-                    safe_printf("Added URL %d to queue: %s (depth %d)\n",
-                                urls_processed, current_url, current_depth);
-                }
-                else
-                {
-                    free(task);
-                }
+                fwrite(page.data, 1, page.size, f);
+                fclose(f);
+                log_info("Thread %ld: Saved content to %s\n", (long)pthread_self(), filename);
             }
         }
-
-        print_performance_stats();
-
-        // Small delay to prevent overwhelming the queue
-        usleep(100000); // 0.1 second
     }
+    else if (response_code == 304 && headers)
+    {
+        log_info("Thread %ld: Not modified %s\n", (long)pthread_self(), url);
 
-    safe_printf("Waiting for all threads to complete...\n");
-    thread_pool_wait(thread_pool);
-    safe_printf("All threads completed!\n");
-
-    // Cleanup
-    print_stats();
-    thread_pool_destroy(thread_pool);
-
-    pthread_mutex_destroy(&db_mutex);
-    pthread_mutex_destroy(&stats_mutex);
-    pthread_mutex_destroy(&console_mutex);
+        metrics_add(METRIC_PAGES_CRAWLED, 1);
+        metrics_add(METRIC_NOT_MODIFIED, 1);
+        host_record_fetch(url);
+        host_breaker_record(url, 0);
+        success = 1;
 
-    if (resume_mode && start_url)
+        // A 304 may refresh either validator; keep the old value otherwise
+        if (!received->etag[0])
+            strcpy(received->etag, previous.etag);
+        if (!received->last_modified[0])
+            strcpy(received->last_modified, previous.last_modified);
+
+        long long db_usec = relink_unchanged_page(page_url, depth);
+        long long db_start = metrics_now_us();
+        storage->save_unchanged_page(page_url, depth);
+        save_validators(url, page_url, received);
+        if (storage->record_visit)
+            storage->record_visit(url, 1, 0);
+        db_usec += metrics_now_us() - db_start;
+        metrics_observe(HIST_DB, db_usec);
+        if (trace)
+            trace->db_us += db_usec;
+    }
+    else
     {
-        free(start_url);
+        log_warn("Thread %ld: HTTP error %ld for %s\n", (long)pthread_self(), response_code, url);
+        fetch_failed(url, depth, attempt, res, response_code, response.retry_after);
     }
 
-    cleanup_database();
-    xmlCleanupParser();
-    curl_global_cleanup();
+    // An earlier attempt left the URL marked as failed
+    if (success && attempt > 0)
+        storage->mark(url, URL_CRAWLED);
 
-    safe_printf("\nCrawling completed!\n");
-    return 0;
-}
\ No newline at end of file
+    trace_end();
+
+    if (page.data)
+        free(page.data);
+    curl_slist_free_all(headers);
+    curl_slist_free_all(resolve);
+
+    return success;
+}
@@ -5,129 +5,437 @@
 #include <sqlite3.h>
 #include "../include/crawler.h"
 #include "../include/database.h"
+#include "../include/metrics.h"
+#include "../include/lockstat.h"
+#include "../include/revisit.h"
 
-CrawlerStats stats = {0};
 CrawlerDB crawler_db = {0};
 
-int init_database(void)
+// Enable WAL mode on a freshly opened connection
+static void enable_wal_mode(sqlite3 *db)
 {
-    int rc = sqlite3_open(DB_NAME, &crawler_db.db);
-    if (rc != SQLITE_OK)
-    {
-        fprintf(stderr, "Can't open database: %s\n", sqlite3_errmsg(crawler_db.db));
-        return 0;
-    }
-
-    // Enable WAL mode for better performance
     if (ENABLE_WAL_MODE)
     {
         char *err_msg = 0;
-        rc = sqlite3_exec(crawler_db.db, "PRAGMA journal_mode=WAL;", 0, 0, &err_msg);
+        int rc = sqlite3_exec(db, "PRAGMA journal_mode=WAL;", 0, 0, &err_msg);
         if (rc != SQLITE_OK)
         {
             fprintf(stderr, "Failed to enable WAL mode: %s\n", err_msg);
             sqlite3_free(err_msg);
         }
     }
+}
 
-    // Create tables
-    const char *create_tables_sql =
-        "CREATE TABLE IF NOT EXISTS crawl_sessions ("
-        "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "    start_url TEXT NOT NULL,"
-        "    start_time INTEGER NOT NULL,"
-        "    end_time INTEGER,"
-        "    status TEXT DEFAULT 'running'"
-        ");"
+// Map a URL to its shard by hashing the host name (FNV-1a)
+static DBShard *shard_for_url(const char *url)
+{
+    if (DB_SHARD_COUNT == 1)
+        return &crawler_db.shards[0];
 
-        "CREATE TABLE IF NOT EXISTS pages ("
-        "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "    session_id INTEGER,"
-        "    url TEXT NOT NULL,"
-        "    content TEXT,"
-        "    content_length INTEGER,"
-        "    response_code INTEGER,"
-        "    crawl_time INTEGER,"
-        "    depth INTEGER,"
-        "    FOREIGN KEY(session_id) REFERENCES crawl_sessions(id),"
-        "    UNIQUE(session_id, url)"
-        ");"
-
-        "CREATE TABLE IF NOT EXISTS url_queue ("
-        "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "    session_id INTEGER,"
-        "    url TEXT NOT NULL,"
-        "    depth INTEGER,"
-        "    status TEXT DEFAULT 'pending',"
-        "    added_time INTEGER,"
-        "    crawled_time INTEGER,"
-        "    error_count INTEGER DEFAULT 0,"
-        "    FOREIGN KEY(session_id) REFERENCES crawl_sessions(id),"
-        "    UNIQUE(session_id, url)"
-        ");"
-
-        "CREATE TABLE IF NOT EXISTS extracted_links ("
-        "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "    session_id INTEGER,"
-        "    source_url TEXT NOT NULL,"
-        "    target_url TEXT NOT NULL,"
-        "    discovered_time INTEGER,"
-        "    FOREIGN KEY(session_id) REFERENCES crawl_sessions(id)"
-        ");"
+    char host[256];
+    get_url_host(url, host, sizeof(host));
+
+    unsigned int hash = 2166136261u;
+    for (const char *p = host; *p; p++)
+    {
+        hash ^= (unsigned char)*p;
+        hash *= 16777619u;
+    }
+
+    return &crawler_db.shards[hash % DB_SHARD_COUNT];
+}
+
+// Open this thread's read-only connection to a shard and prepare its lookups
+static DBReader *open_reader(DBReader *reader, const DBShard *shard)
+{
+    if (sqlite3_open_v2(shard->filename, &reader->db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK)
+    {
+        fprintf(stderr, "Can't open reader for %s: %s\n", shard->filename, sqlite3_errmsg(reader->db));
+        sqlite3_close(reader->db);
+        reader->db = NULL;
+        return NULL;
+    }
+
+    // Readers only wait while the writer checkpoints or recovers the WAL
+    sqlite3_busy_timeout(reader->db, 5000);
+
+    const char *check_visited_sql =
+        "SELECT 1 FROM pages WHERE session_id = ? AND url = ? LIMIT 1";
+
+    // A pending URL whose page was stored after it was queued is done already;
+    // a revisit requeues with a newer added_time, so the old copy is stale
+    const char *get_queue_sql =
+        "SELECT q.url, q.depth, EXISTS (SELECT 1 FROM pages p WHERE p.session_id = q.session_id "
+        "                               AND p.url = q.url AND p.crawl_time >= q.added_time) "
+        "FROM url_queue q WHERE q.session_id = ? AND q.status = 0 ORDER BY q.depth, q.seq LIMIT ?";
+
+    const char *get_validators_sql =
+        "SELECT etag, last_modified FROM page_validators WHERE url = ?";
+
+    // Links stored by the session that last fetched the page
+    const char *previous_links_sql =
+        "SELECT l.target_url FROM page_validators v "
+        "JOIN extracted_links l ON l.session_id = v.session_id AND l.source_url = v.url "
+        "WHERE v.url = ?";
+
+    if (sqlite3_prepare_v2(reader->db, check_visited_sql, -1, &reader->check_visited, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(reader->db, get_queue_sql, -1, &reader->get_queue, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(reader->db, get_validators_sql, -1, &reader->get_validators, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(reader->db, previous_links_sql, -1, &reader->previous_links, NULL) != SQLITE_OK)
+    {
+        fprintf(stderr, "Failed to prepare reader statements: %s\n", sqlite3_errmsg(reader->db));
+        sqlite3_finalize(reader->check_visited);
+        sqlite3_finalize(reader->get_queue);
+        sqlite3_finalize(reader->get_validators);
+        sqlite3_finalize(reader->previous_links);
+        sqlite3_close(reader->db);
+        memset(reader, 0, sizeof(*reader));
+        return NULL;
+    }
+
+    return reader;
+}
+
+static void close_readers(void *arg)
+{
+    DBReader *readers = arg;
+    if (!readers)
+        return;
+
+    for (int i = 0; i < DB_SHARD_COUNT; i++)
+    {
+        sqlite3_finalize(readers[i].check_visited);
+        sqlite3_finalize(readers[i].get_queue);
+        sqlite3_finalize(readers[i].get_validators);
+        sqlite3_finalize(readers[i].previous_links);
+        sqlite3_close(readers[i].db);
+    }
+    free(readers);
+}
 
-        "CREATE INDEX IF NOT EXISTS idx_url_queue_status ON url_queue(session_id, status);"
-        "CREATE INDEX IF NOT EXISTS idx_pages_url ON pages(session_id, url);"
-        "CREATE INDEX IF NOT EXISTS idx_extracted_links_source ON extracted_links(session_id, source_url);";
+// The calling thread's reader for a shard, opened on first use. Each thread
+// owns its connections, so lookups need no lock and run in parallel under WAL.
+static DBReader *get_reader(const DBShard *shard)
+{
+    DBReader *readers = pthread_getspecific(crawler_db.reader_key);
+    if (!readers)
+    {
+        readers = calloc(DB_SHARD_COUNT, sizeof(DBReader));
+        if (!readers)
+            return NULL;
+        pthread_setspecific(crawler_db.reader_key, readers);
+    }
+
+    DBReader *reader = &readers[shard - crawler_db.shards];
+    return reader->db ? reader : open_reader(reader, shard);
+}
+
+// Schema v2: integer queue status, a partial index over pending rows only,
+// WITHOUT ROWID tables keyed by their natural key and no redundant indexes.
+// pages keeps its rowid because its rows carry the full page content.
+static const char *SHARD_SCHEMA_V2_SQL =
+    "CREATE TABLE IF NOT EXISTS pages ("
+    "    id INTEGER PRIMARY KEY,"
+    "    session_id INTEGER NOT NULL,"
+    "    url TEXT NOT NULL,"
+    "    content TEXT,"
+    "    content_length INTEGER,"
+    "    response_code INTEGER,"
+    "    crawl_time INTEGER,"
+    "    depth INTEGER,"
+    "    UNIQUE(session_id, url)"
+    ");"
+
+    "CREATE TABLE IF NOT EXISTS url_queue ("
+    "    session_id INTEGER NOT NULL,"
+    "    url TEXT NOT NULL,"
+    "    seq INTEGER NOT NULL,"
+    "    depth INTEGER,"
+    "    status INTEGER NOT NULL DEFAULT 0,"
+    "    added_time INTEGER,"
+    "    crawled_time INTEGER,"
+    "    error_count INTEGER NOT NULL DEFAULT 0,"
+    "    PRIMARY KEY(session_id, url)"
+    ") WITHOUT ROWID;"
+
+    "CREATE TABLE IF NOT EXISTS extracted_links ("
+    "    session_id INTEGER NOT NULL,"
+    "    source_url TEXT NOT NULL,"
+    "    target_url TEXT NOT NULL,"
+    "    discovered_time INTEGER,"
+    "    PRIMARY KEY(session_id, source_url, target_url)"
+    ") WITHOUT ROWID;"
+
+    "CREATE INDEX IF NOT EXISTS idx_url_queue_pending ON url_queue(session_id, depth, seq) WHERE status = 0;";
+
+// Schema v3: HTTP validators per URL for conditional re-crawls. They outlive
+// sessions; session_id is the session whose extracted_links describe the page.
+static const char *SHARD_SCHEMA_V3_SQL =
+    "CREATE TABLE IF NOT EXISTS page_validators ("
+    "    url TEXT PRIMARY KEY,"
+    "    session_id INTEGER NOT NULL,"
+    "    etag TEXT,"
+    "    last_modified TEXT,"
+    "    fetched_time INTEGER"
+    ") WITHOUT ROWID;";
+
+// Schema v4: each URL's visit history across sessions, for the revisit scheduler
+static const char *SHARD_SCHEMA_V4_SQL =
+    "CREATE TABLE IF NOT EXISTS url_revisits ("
+    "    url TEXT PRIMARY KEY,"
+    "    content_hash INTEGER,"
+    "    visits INTEGER NOT NULL,"
+    "    changes INTEGER NOT NULL,"
+    "    first_visit INTEGER NOT NULL,"
+    "    last_visit INTEGER NOT NULL,"
+    "    last_change INTEGER NOT NULL,"
+    "    next_visit INTEGER NOT NULL"
+    ") WITHOUT ROWID;"
+
+    "CREATE INDEX IF NOT EXISTS idx_url_revisits_due ON url_revisits(next_visit);";
+
+// Schema v5: the last robots.txt response per host, kept in the host's shard
+static const char *SHARD_SCHEMA_V5_SQL =
+    "CREATE TABLE IF NOT EXISTS robots_cache ("
+    "    host TEXT PRIMARY KEY,"
+    "    status INTEGER NOT NULL,"
+    "    body BLOB,"
+    "    fetched_time INTEGER NOT NULL"
+    ") WITHOUT ROWID;";
+
+// Set v1 tables (TEXT status, AUTOINCREMENT ids, duplicate indexes) aside...
+static const char *SHARD_RENAME_V1_SQL =
+    "ALTER TABLE pages RENAME TO pages_v1;"
+    "ALTER TABLE url_queue RENAME TO url_queue_v1;"
+    "ALTER TABLE extracted_links RENAME TO extracted_links_v1;";
+
+// ...and copy them into the v2 tables. The old queue id becomes seq.
+static const char *SHARD_COPY_V1_SQL =
+    "INSERT INTO pages (id, session_id, url, content, content_length, response_code, crawl_time, depth) "
+    "    SELECT id, session_id, url, content, content_length, response_code, crawl_time, depth FROM pages_v1;"
+    "INSERT OR IGNORE INTO url_queue (session_id, url, seq, depth, status, added_time, crawled_time, error_count) "
+    "    SELECT session_id, url, id, depth,"
+    "           CASE status WHEN 'pending' THEN 0 WHEN 'error' THEN 2 WHEN 'skipped' THEN 3 ELSE 1 END,"
+    "           added_time, crawled_time, error_count FROM url_queue_v1;"
+    "INSERT OR IGNORE INTO extracted_links (session_id, source_url, target_url, discovered_time) "
+    "    SELECT session_id, source_url, target_url, discovered_time FROM extracted_links_v1 ORDER BY id;"
+    "DROP TABLE pages_v1;"
+    "DROP TABLE url_queue_v1;"
+    "DROP TABLE extracted_links_v1;";
+
+// Bring a shard to the current schema, migrating v1 data in place (tracked in user_version)
+static int migrate_shard_schema(DBShard *shard)
+{
+    int version = 0;
+    int has_v1_tables = 0;
+    sqlite3_stmt *stmt;
+
+    if (sqlite3_prepare_v2(shard->db, "PRAGMA user_version", -1, &stmt, NULL) == SQLITE_OK)
+    {
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+            version = sqlite3_column_int(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+
+    if (version >= DB_SCHEMA_VERSION)
+        return 1;
+
+    // Unversioned databases that already have tables are v1
+    if (version < 2 &&
+        sqlite3_prepare_v2(shard->db, "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'url_queue'",
+                           -1, &stmt, NULL) == SQLITE_OK)
+    {
+        has_v1_tables = sqlite3_step(stmt) == SQLITE_ROW;
+        sqlite3_finalize(stmt);
+    }
+
+    if (has_v1_tables)
+        printf("Migrating %s to schema v%d...\n", shard->filename, DB_SCHEMA_VERSION);
 
     char *err_msg = 0;
-    rc = sqlite3_exec(crawler_db.db, create_tables_sql, 0, 0, &err_msg);
+    int rc = sqlite3_exec(shard->db, "BEGIN IMMEDIATE", 0, 0, &err_msg);
+    if (rc == SQLITE_OK && has_v1_tables)
+        rc = sqlite3_exec(shard->db, SHARD_RENAME_V1_SQL, 0, 0, &err_msg);
+    if (rc == SQLITE_OK)
+        rc = sqlite3_exec(shard->db, SHARD_SCHEMA_V2_SQL, 0, 0, &err_msg);
+    if (rc == SQLITE_OK && has_v1_tables)
+        rc = sqlite3_exec(shard->db, SHARD_COPY_V1_SQL, 0, 0, &err_msg);
+    if (rc == SQLITE_OK)
+        rc = sqlite3_exec(shard->db, SHARD_SCHEMA_V3_SQL, 0, 0, &err_msg);
+    if (rc == SQLITE_OK)
+        rc = sqlite3_exec(shard->db, SHARD_SCHEMA_V4_SQL, 0, 0, &err_msg);
+    if (rc == SQLITE_OK)
+        rc = sqlite3_exec(shard->db, SHARD_SCHEMA_V5_SQL, 0, 0, &err_msg);
+    if (rc == SQLITE_OK)
+        rc = sqlite3_exec(shard->db, "PRAGMA user_version = " DB_SCHEMA_VERSION_STR ";", 0, 0, &err_msg);
+
     if (rc != SQLITE_OK)
     {
-        fprintf(stderr, "SQL error: %s\n", err_msg);
+        fprintf(stderr, "Schema migration failed for %s: %s\n", shard->filename, err_msg);
         sqlite3_free(err_msg);
+        sqlite3_exec(shard->db, "ROLLBACK", 0, 0, 0);
         return 0;
     }
 
+    sqlite3_exec(shard->db, "COMMIT", 0, 0, 0);
+
+    // Give the space freed by the old tables and indexes back to the filesystem
+    if (has_v1_tables)
+        sqlite3_exec(shard->db, "VACUUM", 0, 0, 0);
+
+    return 1;
+}
+
+// Open a shard, create its tables and prepare its statements
+static int init_shard(DBShard *shard, int index)
+{
+    pthread_mutex_init(&shard->lock, NULL);
+
+    if (DB_SHARD_COUNT == 1)
+    {
+        snprintf(shard->filename, sizeof(shard->filename), "%s", DB_NAME);
+        shard->db = crawler_db.db;
+    }
+    else
+    {
+        snprintf(shard->filename, sizeof(shard->filename), DB_SHARD_NAME_FORMAT, index);
+
+        if (sqlite3_open(shard->filename, &shard->db) != SQLITE_OK)
+        {
+            fprintf(stderr, "Can't open shard %s: %s\n", shard->filename, sqlite3_errmsg(shard->db));
+            return 0;
+        }
+        enable_wal_mode(shard->db);
+    }
+
+    if (!migrate_shard_schema(shard))
+        return 0;
+
+    // Next enqueue sequence number; seq orders pending URLs within a depth
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(shard->db, "SELECT COALESCE(MAX(seq), 0) FROM url_queue", -1, &stmt, NULL) == SQLITE_OK)
+    {
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+            shard->next_seq = sqlite3_column_int64(stmt, 0) + 1;
+        sqlite3_finalize(stmt);
+    }
+
     // Prepare statements
     const char *insert_page_sql =
         "INSERT OR REPLACE INTO pages (session_id, url, content, content_length, response_code, crawl_time, depth) "
         "VALUES (?, ?, ?, ?, ?, ?, ?)";
 
+    // The body the validators' owner session stored, under this session
+    const char *copy_page_sql =
+        "INSERT OR REPLACE INTO pages (session_id, url, content, content_length, response_code, crawl_time, depth) "
+        "SELECT ?, p.url, p.content, p.content_length, 304, ?, ? FROM page_validators v "
+        "JOIN pages p ON p.session_id = v.session_id AND p.url = v.url WHERE v.url = ?";
+
     const char *insert_url_sql =
-        "INSERT OR IGNORE INTO url_queue (session_id, url, depth, added_time) VALUES (?, ?, ?, ?)";
+        "INSERT OR IGNORE INTO url_queue (session_id, url, seq, depth, added_time) VALUES (?, ?, ?, ?, ?)";
 
-    const char *check_visited_sql =
-        "SELECT 1 FROM pages WHERE session_id = ? AND url = ? LIMIT 1";
+    const char *claim_url_sql =
+        "UPDATE url_queue SET status = 1, crawled_time = ? "
+        "WHERE session_id = ? AND url = ? AND status = 0";
 
-    const char *get_queue_sql =
-        "SELECT url, depth FROM url_queue WHERE session_id = ? AND status = 'pending' ORDER BY depth, id LIMIT 1";
+    const char *update_status_sql =
+        "UPDATE url_queue SET status = ?, crawled_time = ?, error_count = error_count + ? "
+        "WHERE session_id = ? AND url = ?";
+
+    const char *insert_link_sql =
+        "INSERT OR IGNORE INTO extracted_links (session_id, source_url, target_url, discovered_time) VALUES (?, ?, ?, ?)";
 
-    const char *update_crawled_sql =
-        "UPDATE url_queue SET status = 'crawled', crawled_time = ? WHERE session_id = ? AND url = ?";
+    const char *delete_links_sql =
+        "DELETE FROM extracted_links WHERE session_id = ? AND source_url = ?";
 
     const char *get_stats_sql =
         "SELECT "
         "    (SELECT COUNT(*) FROM pages WHERE session_id = ?) as pages_crawled,"
-        "    (SELECT COUNT(*) FROM extracted_links WHERE session_id = ?) as links_found,"
-        "    (SELECT COUNT(*) FROM url_queue WHERE session_id = ? AND status = 'error') as errors,"
-        "    (SELECT COUNT(*) FROM url_queue WHERE session_id = ? AND status = 'skipped') as skipped";
+        "    (SELECT COUNT(*) FROM url_queue WHERE session_id = ?) as links_found,"
+        "    (SELECT COUNT(*) FROM url_queue WHERE session_id = ? AND status = 2) as errors,"
+        "    (SELECT COUNT(*) FROM url_queue WHERE session_id = ? AND status = 3) as skipped,"
+        "    (SELECT COUNT(*) FROM url_queue WHERE session_id = ? AND status = 0) as pending";
+
+    const char *save_validators_sql =
+        "INSERT OR REPLACE INTO page_validators (url, session_id, etag, last_modified, fetched_time) "
+        "VALUES (?, ?, ?, ?, ?)";
+
+    const char *delete_validators_sql =
+        "DELETE FROM page_validators WHERE url = ?";
+
+    const char *get_revisit_sql =
+        "SELECT content_hash, visits, changes, first_visit, last_change FROM url_revisits WHERE url = ?";
 
-    if (sqlite3_prepare_v2(crawler_db.db, insert_page_sql, -1, &crawler_db.insert_page, NULL) != SQLITE_OK ||
-        sqlite3_prepare_v2(crawler_db.db, insert_url_sql, -1, &crawler_db.insert_url, NULL) != SQLITE_OK ||
-        sqlite3_prepare_v2(crawler_db.db, check_visited_sql, -1, &crawler_db.check_visited, NULL) != SQLITE_OK ||
-        sqlite3_prepare_v2(crawler_db.db, get_queue_sql, -1, &crawler_db.get_queue, NULL) != SQLITE_OK ||
-        sqlite3_prepare_v2(crawler_db.db, update_crawled_sql, -1, &crawler_db.update_crawled, NULL) != SQLITE_OK ||
-        sqlite3_prepare_v2(crawler_db.db, get_stats_sql, -1, &crawler_db.get_stats, NULL) != SQLITE_OK)
+    const char *save_revisit_sql =
+        "INSERT OR REPLACE INTO url_revisits "
+        "(url, content_hash, visits, changes, first_visit, last_visit, last_change, next_visit) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?)";
+
+    if (sqlite3_prepare_v2(shard->db, insert_page_sql, -1, &shard->insert_page, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(shard->db, copy_page_sql, -1, &shard->copy_page, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(shard->db, insert_url_sql, -1, &shard->insert_url, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(shard->db, claim_url_sql, -1, &shard->claim_url, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(shard->db, update_status_sql, -1, &shard->update_status, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(shard->db, insert_link_sql, -1, &shard->insert_link, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(shard->db, delete_links_sql, -1, &shard->delete_links, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(shard->db, get_stats_sql, -1, &shard->get_stats, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(shard->db, save_validators_sql, -1, &shard->save_validators, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(shard->db, delete_validators_sql, -1, &shard->delete_validators, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(shard->db, get_revisit_sql, -1, &shard->get_revisit, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(shard->db, save_revisit_sql, -1, &shard->save_revisit, NULL) != SQLITE_OK)
     {
 
-        fprintf(stderr, "Failed to prepare statements: %s\n", sqlite3_errmsg(crawler_db.db));
+        fprintf(stderr, "Failed to prepare statements: %s\n", sqlite3_errmsg(shard->db));
         return 0;
     }
 
     return 1;
 }
 
-int create_crawl_session(const char *start_url)
+static int init_database(void)
+{
+    int rc = sqlite3_open(DB_NAME, &crawler_db.db);
+    if (rc != SQLITE_OK)
+    {
+        fprintf(stderr, "Can't open database: %s\n", sqlite3_errmsg(crawler_db.db));
+        return 0;
+    }
+
+    // Enable WAL mode for better performance
+    enable_wal_mode(crawler_db.db);
+
+    // Session metadata always lives in the coordinator database
+    const char *create_tables_sql =
+        "CREATE TABLE IF NOT EXISTS crawl_sessions ("
+        "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "    start_url TEXT NOT NULL,"
+        "    start_time INTEGER NOT NULL,"
+        "    end_time INTEGER,"
+        "    status TEXT DEFAULT 'running'"
+        ");";
+
+    char *err_msg = 0;
+    rc = sqlite3_exec(crawler_db.db, create_tables_sql, 0, 0, &err_msg);
+    if (rc != SQLITE_OK)
+    {
+        fprintf(stderr, "SQL error: %s\n", err_msg);
+        sqlite3_free(err_msg);
+        return 0;
+    }
+
+    for (int i = 0; i < DB_SHARD_COUNT; i++)
+    {
+        if (!init_shard(&crawler_db.shards[i], i))
+            return 0;
+    }
+
+    // Worker threads' readers are closed when the threads exit
+    pthread_key_create(&crawler_db.reader_key, close_readers);
+
+    return 1;
+}
+
+static int create_crawl_session(const char *start_url)
 {
     const char *sql = "INSERT INTO crawl_sessions (start_url, start_time) VALUES (?, ?)";
     sqlite3_stmt *stmt;
@@ -153,7 +461,7 @@ int create_crawl_session(const char *start_url)
     return (int)sqlite3_last_insert_rowid(crawler_db.db);
 }
 
-int resume_crawl_session()
+static int resume_crawl_session(void)
 {
     const char *sql = "SELECT id FROM crawl_sessions WHERE status = 'running' ORDER BY id DESC LIMIT 1";
     sqlite3_stmt *stmt;
@@ -173,161 +481,331 @@ int resume_crawl_session()
     return session_id;
 }
 
-void save_page_to_db(const char *url, const char *content, size_t content_length,
-                     long response_code, int depth)
+static void save_page_to_db(const char *url, const char *content, size_t content_length,
+                            long response_code, int depth)
 {
-    sqlite3_bind_int(crawler_db.insert_page, 1, stats.session_id);
-    sqlite3_bind_text(crawler_db.insert_page, 2, url, -1, SQLITE_STATIC);
-    sqlite3_bind_text(crawler_db.insert_page, 3, content, content_length, SQLITE_STATIC);
-    sqlite3_bind_int64(crawler_db.insert_page, 4, content_length);
-    sqlite3_bind_int64(crawler_db.insert_page, 5, response_code);
-    sqlite3_bind_int64(crawler_db.insert_page, 6, time(NULL));
-    sqlite3_bind_int(crawler_db.insert_page, 7, depth);
+    DBShard *shard = shard_for_url(url);
+    lock_acquire(&shard->lock, LOCK_DB_SHARD);
+
+    sqlite3_bind_int(shard->insert_page, 1, stats.session_id);
+    sqlite3_bind_text(shard->insert_page, 2, url, -1, SQLITE_STATIC);
+    sqlite3_bind_text(shard->insert_page, 3, content, content_length, SQLITE_STATIC);
+    sqlite3_bind_int64(shard->insert_page, 4, content_length);
+    sqlite3_bind_int64(shard->insert_page, 5, response_code);
+    sqlite3_bind_int64(shard->insert_page, 6, time(NULL));
+    sqlite3_bind_int(shard->insert_page, 7, depth);
 
-    if (sqlite3_step(crawler_db.insert_page) != SQLITE_DONE)
+    if (sqlite3_step(shard->insert_page) != SQLITE_DONE)
     {
-        fprintf(stderr, "Failed to save page: %s\n", sqlite3_errmsg(crawler_db.db));
+        fprintf(stderr, "Failed to save page: %s\n", sqlite3_errmsg(shard->db));
     }
 
-    sqlite3_reset(crawler_db.insert_page);
+    sqlite3_reset(shard->insert_page);
+    lock_release(&shard->lock, LOCK_DB_SHARD);
 }
 
-void add_url_to_queue(const char *url, int depth)
+// Caller must hold shard->lock. The hint statement, if any, applies a
+// sitemap lastmod to the URL's revisit schedule.
+static int shard_insert_url(DBShard *shard, sqlite3_stmt *hint, const char *url, time_t lastmod, int depth, time_t now)
 {
-    sqlite3_bind_int(crawler_db.insert_url, 1, stats.session_id);
-    sqlite3_bind_text(crawler_db.insert_url, 2, url, -1, SQLITE_STATIC);
-    sqlite3_bind_int(crawler_db.insert_url, 3, depth);
-    sqlite3_bind_int64(crawler_db.insert_url, 4, time(NULL));
+    sqlite3_bind_int(shard->insert_url, 1, stats.session_id);
+    sqlite3_bind_text(shard->insert_url, 2, url, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(shard->insert_url, 3, shard->next_seq);
+    sqlite3_bind_int(shard->insert_url, 4, depth);
+    sqlite3_bind_int64(shard->insert_url, 5, now);
 
-    if (sqlite3_step(crawler_db.insert_url) == SQLITE_DONE)
+    int added = sqlite3_step(shard->insert_url) == SQLITE_DONE && sqlite3_changes(shard->db) > 0;
+    if (added)
+        shard->next_seq++;
+    sqlite3_reset(shard->insert_url);
+
+    if (hint && lastmod > 0)
     {
-        stats.links_found++;
+        sqlite3_bind_int64(hint, 1, now);
+        sqlite3_bind_text(hint, 2, url, -1, SQLITE_STATIC);
+        sqlite3_bind_int64(hint, 3, lastmod);
+        sqlite3_step(hint);
+        sqlite3_reset(hint);
     }
+    return added;
+}
+
+static int add_url_to_queue(const char *url, int depth)
+{
+    DBShard *shard = shard_for_url(url);
+    lock_acquire(&shard->lock, LOCK_DB_SHARD);
+    int added = shard_insert_url(shard, NULL, url, 0, depth, time(NULL));
+    lock_release(&shard->lock, LOCK_DB_SHARD);
 
-    sqlite3_reset(crawler_db.insert_url);
+    if (added)
+    {
+        metrics_add(METRIC_LINKS_FOUND, 1);
+        metrics_gauge_add(GAUGE_QUEUE_DEPTH, 1);
+    }
+    return added;
 }
 
-int is_url_visited(const char *url)
+static int reader_is_url_visited(DBReader *reader, const char *url)
 {
-    sqlite3_bind_int(crawler_db.check_visited, 1, stats.session_id);
-    sqlite3_bind_text(crawler_db.check_visited, 2, url, -1, SQLITE_STATIC);
+    sqlite3_bind_int(reader->check_visited, 1, stats.session_id);
+    sqlite3_bind_text(reader->check_visited, 2, url, -1, SQLITE_STATIC);
 
     int visited = 0;
-    if (sqlite3_step(crawler_db.check_visited) == SQLITE_ROW)
+    if (sqlite3_step(reader->check_visited) == SQLITE_ROW)
     {
         visited = 1;
     }
 
-    sqlite3_reset(crawler_db.check_visited);
+    sqlite3_reset(reader->check_visited);
     return visited;
 }
 
-int get_next_url(char *url_buffer, int *depth)
+static int is_url_visited(const char *url)
+{
+    DBReader *reader = get_reader(shard_for_url(url));
+    return reader ? reader_is_url_visited(reader, url) : 0;
+}
+
+// Caller must hold shard->lock
+static int shard_set_status(DBShard *shard, const char *url, QueueStatus status, int error_increment)
+{
+    sqlite3_bind_int(shard->update_status, 1, status);
+    sqlite3_bind_int64(shard->update_status, 2, time(NULL));
+    sqlite3_bind_int(shard->update_status, 3, error_increment);
+    sqlite3_bind_int(shard->update_status, 4, stats.session_id);
+    sqlite3_bind_text(shard->update_status, 5, url, -1, SQLITE_STATIC);
+
+    int rc = sqlite3_step(shard->update_status);
+    sqlite3_reset(shard->update_status);
+    return rc == SQLITE_DONE;
+}
+
+// Caller must hold shard->lock. Returns 1 only if the URL was still pending.
+static int shard_claim_url(DBShard *shard, const char *url)
+{
+    sqlite3_bind_int64(shard->claim_url, 1, time(NULL));
+    sqlite3_bind_int(shard->claim_url, 2, stats.session_id);
+    sqlite3_bind_text(shard->claim_url, 3, url, -1, SQLITE_STATIC);
+
+    int rc = sqlite3_step(shard->claim_url);
+    sqlite3_reset(shard->claim_url);
+    return rc == SQLITE_DONE && sqlite3_changes(shard->db) == 1;
+}
+
+// Claim up to max pending URLs from one shard. Candidates and whether their
+// page is already stored are read on this thread's reader; only the claiming
+// UPDATEs take the shard lock, inside a single transaction. Already visited
+// URLs are marked but not returned.
+static int shard_dequeue_batch(DBShard *shard, QueuedURL *out, int max)
 {
-    sqlite3_bind_int(crawler_db.get_queue, 1, stats.session_id);
+    DBReader *reader = get_reader(shard);
+    if (!reader)
+        return 0;
+
+    QueuedURL *pending = malloc(sizeof(QueuedURL) * max);
+    int *visited = malloc(sizeof(int) * max);
+    if (!pending || !visited)
+    {
+        free(pending);
+        free(visited);
+        return 0;
+    }
+
+    sqlite3_bind_int(reader->get_queue, 1, stats.session_id);
+    sqlite3_bind_int(reader->get_queue, 2, max);
 
     int found = 0;
-    if (sqlite3_step(crawler_db.get_queue) == SQLITE_ROW)
+    while (found < max && sqlite3_step(reader->get_queue) == SQLITE_ROW)
     {
-        const char *url = (const char *)sqlite3_column_text(crawler_db.get_queue, 0);
-        *depth = sqlite3_column_int(crawler_db.get_queue, 1);
-        strncpy(url_buffer, url, MAX_URL_LENGTH - 1);
-        url_buffer[MAX_URL_LENGTH - 1] = '\0';
-        found = 1;
+        const char *url = (const char *)sqlite3_column_text(reader->get_queue, 0);
+        strncpy(pending[found].url, url, MAX_URL_LENGTH - 1);
+        pending[found].url[MAX_URL_LENGTH - 1] = '\0';
+        pending[found].depth = sqlite3_column_int(reader->get_queue, 1);
+        visited[found] = sqlite3_column_int(reader->get_queue, 2);
+        found++;
     }
+    sqlite3_reset(reader->get_queue);
 
-    sqlite3_reset(crawler_db.get_queue);
-    return found;
+    int claimed = 0;
+    if (found > 0)
+    {
+        lock_acquire(&shard->lock, LOCK_DB_SHARD);
+        sqlite3_exec(shard->db, "BEGIN", 0, 0, 0);
+        for (int i = 0; i < found; i++)
+        {
+            if (!shard_claim_url(shard, pending[i].url))
+                continue;
+
+            metrics_gauge_add(GAUGE_QUEUE_DEPTH, -1);
+            if (!visited[i])
+                out[claimed++] = pending[i];
+        }
+        sqlite3_exec(shard->db, "COMMIT", 0, 0, 0);
+        lock_release(&shard->lock, LOCK_DB_SHARD);
+    }
+
+    free(pending);
+    free(visited);
+    return claimed;
 }
 
-void mark_url_crawled(const char *url)
+// Claim up to max unvisited URLs, visiting shards round-robin so that no
+// single host partition starves the rest
+static int dequeue_batch(QueuedURL *out, int max)
 {
-    sqlite3_bind_int64(crawler_db.update_crawled, 1, time(NULL));
-    sqlite3_bind_int(crawler_db.update_crawled, 2, stats.session_id);
-    sqlite3_bind_text(crawler_db.update_crawled, 3, url, -1, SQLITE_STATIC);
+    int claimed = 0;
+
+    for (int i = 0; i < DB_SHARD_COUNT && claimed < max; i++)
+    {
+        DBShard *shard = &crawler_db.shards[(crawler_db.next_shard + i) % DB_SHARD_COUNT];
+        claimed += shard_dequeue_batch(shard, out + claimed, max - claimed);
+    }
 
-    sqlite3_step(crawler_db.update_crawled);
-    sqlite3_reset(crawler_db.update_crawled);
+    crawler_db.next_shard = (crawler_db.next_shard + 1) % DB_SHARD_COUNT;
+    return claimed;
 }
 
-void save_extracted_link(const char *source_url, const char *target_url)
+static int has_pending(void)
 {
-    const char *sql = "INSERT OR IGNORE INTO extracted_links (session_id, source_url, target_url, discovered_time) VALUES (?, ?, ?, ?)";
-    sqlite3_stmt *stmt;
-
-    if (sqlite3_prepare_v2(crawler_db.db, sql, -1, &stmt, NULL) == SQLITE_OK)
+    for (int i = 0; i < DB_SHARD_COUNT; i++)
     {
-        sqlite3_bind_int(stmt, 1, stats.session_id);
-        sqlite3_bind_text(stmt, 2, source_url, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 3, target_url, -1, SQLITE_STATIC);
-        sqlite3_bind_int64(stmt, 4, time(NULL));
+        DBReader *reader = get_reader(&crawler_db.shards[i]);
+        if (!reader)
+            continue;
 
-        sqlite3_step(stmt);
-        sqlite3_finalize(stmt);
+        sqlite3_bind_int(reader->get_queue, 1, stats.session_id);
+        sqlite3_bind_int(reader->get_queue, 2, 1);
+        int found = sqlite3_step(reader->get_queue) == SQLITE_ROW;
+        sqlite3_reset(reader->get_queue);
+
+        if (found)
+            return 1;
     }
+    return 0;
+}
+
+// dequeue_batch already marks URLs crawled; this records the final outcome
+static void mark_url(const char *url, URLStatus status)
+{
+    QueueStatus queue_status = status == URL_ERROR     ? QUEUE_ERROR
+                               : status == URL_SKIPPED ? QUEUE_SKIPPED
+                               : status == URL_PENDING ? QUEUE_PENDING
+                                                       : QUEUE_CRAWLED;
+
+    DBShard *shard = shard_for_url(url);
+    lock_acquire(&shard->lock, LOCK_DB_SHARD);
+    if (shard_set_status(shard, url, queue_status, status == URL_ERROR) && status == URL_PENDING)
+        metrics_gauge_add(GAUGE_QUEUE_DEPTH, 1);
+    lock_release(&shard->lock, LOCK_DB_SHARD);
 }
 
-// Get statistics from database
-void update_stats_from_db(void)
+// Links are stored with their source page's shard, one transaction per page.
+// They replace the links of an earlier visit of the page in this session.
+static void save_link_batch(const char *source_url, const char *const *target_urls, int count)
 {
-    sqlite3_bind_int(crawler_db.get_stats, 1, stats.session_id);
-    sqlite3_bind_int(crawler_db.get_stats, 2, stats.session_id);
-    sqlite3_bind_int(crawler_db.get_stats, 3, stats.session_id);
-    sqlite3_bind_int(crawler_db.get_stats, 4, stats.session_id);
+    DBShard *shard = shard_for_url(source_url);
+    lock_acquire(&shard->lock, LOCK_DB_SHARD);
+    sqlite3_exec(shard->db, "BEGIN", 0, 0, 0);
+
+    sqlite3_bind_int(shard->delete_links, 1, stats.session_id);
+    sqlite3_bind_text(shard->delete_links, 2, source_url, -1, SQLITE_STATIC);
+    sqlite3_step(shard->delete_links);
+    sqlite3_reset(shard->delete_links);
 
-    if (sqlite3_step(crawler_db.get_stats) == SQLITE_ROW)
+    for (int i = 0; i < count; i++)
     {
-        stats.pages_crawled = sqlite3_column_int(crawler_db.get_stats, 0);
-        stats.links_found = sqlite3_column_int(crawler_db.get_stats, 1);
-        stats.errors = sqlite3_column_int(crawler_db.get_stats, 2);
-        stats.skipped_urls = sqlite3_column_int(crawler_db.get_stats, 3);
+        sqlite3_bind_int(shard->insert_link, 1, stats.session_id);
+        sqlite3_bind_text(shard->insert_link, 2, source_url, -1, SQLITE_STATIC);
+        sqlite3_bind_text(shard->insert_link, 3, target_urls[i], -1, SQLITE_STATIC);
+        sqlite3_bind_int64(shard->insert_link, 4, time(NULL));
+
+        sqlite3_step(shard->insert_link);
+        sqlite3_reset(shard->insert_link);
     }
 
-    sqlite3_reset(crawler_db.get_stats);
+    sqlite3_exec(shard->db, "COMMIT", 0, 0, 0);
+    lock_release(&shard->lock, LOCK_DB_SHARD);
 }
 
-// Print crawler statistics
-void print_stats(void)
+// Get statistics from database, summed across shards
+static void get_stats(CrawlerStats *out)
 {
-    update_stats_from_db();
+    for (int i = 0; i < DB_SHARD_COUNT; i++)
+    {
+        DBShard *shard = &crawler_db.shards[i];
+        lock_acquire(&shard->lock, LOCK_DB_SHARD);
 
-    time_t end_time = time(NULL);
-    double elapsed = difftime(end_time, stats.start_time);
+        sqlite3_bind_int(shard->get_stats, 1, stats.session_id);
+        sqlite3_bind_int(shard->get_stats, 2, stats.session_id);
+        sqlite3_bind_int(shard->get_stats, 3, stats.session_id);
+        sqlite3_bind_int(shard->get_stats, 4, stats.session_id);
+        sqlite3_bind_int(shard->get_stats, 5, stats.session_id);
 
-    printf("\n=== Crawler Statistics ===\n");
-    printf("Session ID: %d\n", stats.session_id);
-    printf("Pages crawled: %d\n", stats.pages_crawled);
-    printf("Links found: %d\n", stats.links_found);
-    printf("URLs skipped: %d\n", stats.skipped_urls);
-    printf("Errors: %d\n", stats.errors);
-    printf("Time elapsed: %.2f seconds\n", elapsed);
-    if (elapsed > 0)
-    {
-        printf("Average pages/second: %.2f\n", stats.pages_crawled / elapsed);
+        if (sqlite3_step(shard->get_stats) == SQLITE_ROW)
+        {
+            out->pages_crawled += sqlite3_column_int(shard->get_stats, 0);
+            out->links_found += sqlite3_column_int(shard->get_stats, 1);
+            out->errors += sqlite3_column_int(shard->get_stats, 2);
+            out->skipped_urls += sqlite3_column_int(shard->get_stats, 3);
+            out->pending_urls += sqlite3_column_int(shard->get_stats, 4);
+        }
+
+        sqlite3_reset(shard->get_stats);
+        lock_release(&shard->lock, LOCK_DB_SHARD);
     }
 }
 
-void cleanup_database(void)
+static void cleanup_shard(DBShard *shard)
+{
+    if (shard->insert_page)
+        sqlite3_finalize(shard->insert_page);
+    if (shard->copy_page)
+        sqlite3_finalize(shard->copy_page);
+    if (shard->insert_url)
+        sqlite3_finalize(shard->insert_url);
+    if (shard->claim_url)
+        sqlite3_finalize(shard->claim_url);
+    if (shard->update_status)
+        sqlite3_finalize(shard->update_status);
+    if (shard->insert_link)
+        sqlite3_finalize(shard->insert_link);
+    if (shard->delete_links)
+        sqlite3_finalize(shard->delete_links);
+    if (shard->get_stats)
+        sqlite3_finalize(shard->get_stats);
+    if (shard->save_validators)
+        sqlite3_finalize(shard->save_validators);
+    if (shard->delete_validators)
+        sqlite3_finalize(shard->delete_validators);
+    if (shard->get_revisit)
+        sqlite3_finalize(shard->get_revisit);
+    if (shard->save_revisit)
+        sqlite3_finalize(shard->save_revisit);
+
+    // A single shard shares the coordinator connection
+    if (shard->db && shard->db != crawler_db.db)
+        sqlite3_close(shard->db);
+
+    pthread_mutex_destroy(&shard->lock);
+}
+
+static void cleanup_database(int completed)
 {
-    if (crawler_db.insert_page)
-        sqlite3_finalize(crawler_db.insert_page);
-    if (crawler_db.insert_url)
-        sqlite3_finalize(crawler_db.insert_url);
-    if (crawler_db.check_visited)
-        sqlite3_finalize(crawler_db.check_visited);
-    if (crawler_db.get_queue)
-        sqlite3_finalize(crawler_db.get_queue);
-    if (crawler_db.update_crawled)
-        sqlite3_finalize(crawler_db.update_crawled);
-    if (crawler_db.get_stats)
-        sqlite3_finalize(crawler_db.get_stats);
+    // Close the calling thread's readers before their databases go away
+    close_readers(pthread_getspecific(crawler_db.reader_key));
+    pthread_setspecific(crawler_db.reader_key, NULL);
+
+    for (int i = 0; i < DB_SHARD_COUNT; i++)
+    {
+        cleanup_shard(&crawler_db.shards[i]);
+    }
 
     if (crawler_db.db)
     {
-        // Mark session as completed
+        // Mark session as completed; an interrupted one stays resumable
         const char *sql = "UPDATE crawl_sessions SET status = 'completed', end_time = ? WHERE id = ?";
         sqlite3_stmt *stmt;
-        if (sqlite3_prepare_v2(crawler_db.db, sql, -1, &stmt, NULL) == SQLITE_OK)
+        if (completed && sqlite3_prepare_v2(crawler_db.db, sql, -1, &stmt, NULL) == SQLITE_OK)
         {
             sqlite3_bind_int64(stmt, 1, time(NULL));
             sqlite3_bind_int(stmt, 2, stats.session_id);
@@ -339,18 +817,64 @@ void cleanup_database(void)
     }
 }
 
-void print_resume_info(void)
+// Look up a running session's start URL and time
+static int get_session(int session_id, char *start_url, size_t url_size, time_t *start_time)
+{
+    const char *sql = "SELECT start_url, start_time FROM crawl_sessions WHERE id = ? AND status = 'running'";
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(crawler_db.db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        fprintf(stderr, "Database error: %s\n", sqlite3_errmsg(crawler_db.db));
+        return 0;
+    }
+
+    sqlite3_bind_int(stmt, 1, session_id);
+
+    int found = 0;
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        snprintf(start_url, url_size, "%s", (const char *)sqlite3_column_text(stmt, 0));
+        *start_time = sqlite3_column_int64(stmt, 1);
+        found = 1;
+    }
+
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+// Count a session's pages and queued URLs across all shards
+static void count_session_progress(int session_id, int *pages_crawled, int *total_urls)
+{
+    const char *sql =
+        "SELECT (SELECT COUNT(*) FROM pages WHERE session_id = ?1), "
+        "       (SELECT COUNT(*) FROM url_queue WHERE session_id = ?1)";
+
+    *pages_crawled = 0;
+    *total_urls = 0;
+
+    for (int i = 0; i < DB_SHARD_COUNT; i++)
+    {
+        sqlite3_stmt *stmt;
+        if (sqlite3_prepare_v2(crawler_db.shards[i].db, sql, -1, &stmt, NULL) != SQLITE_OK)
+            continue;
+
+        sqlite3_bind_int(stmt, 1, session_id);
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            *pages_crawled += sqlite3_column_int(stmt, 0);
+            *total_urls += sqlite3_column_int(stmt, 1);
+        }
+        sqlite3_finalize(stmt);
+    }
+}
+
+static void print_resume_info(void)
 {
     const char *sql =
-        "SELECT s.id, s.start_url, s.start_time, "
-        "       COUNT(DISTINCT p.url) as pages_crawled, "
-        "       COUNT(DISTINCT q.url) as total_urls "
-        "FROM crawl_sessions s "
-        "LEFT JOIN pages p ON s.id = p.session_id "
-        "LEFT JOIN url_queue q ON s.id = q.session_id "
-        "WHERE s.status = 'running' "
-        "GROUP BY s.id "
-        "ORDER BY s.start_time DESC";
+        "SELECT id, start_url, start_time "
+        "FROM crawl_sessions "
+        "WHERE status = 'running' "
+        "ORDER BY start_time DESC";
 
     sqlite3_stmt *stmt;
     if (sqlite3_prepare_v2(crawler_db.db, sql, -1, &stmt, NULL) != SQLITE_OK)
@@ -367,8 +891,9 @@ void print_resume_info(void)
         int session_id = sqlite3_column_int(stmt, 0);
         const char *start_url = (const char *)sqlite3_column_text(stmt, 1);
         time_t start_time = sqlite3_column_int64(stmt, 2);
-        int pages_crawled = sqlite3_column_int(stmt, 3);
-        int total_urls = sqlite3_column_int(stmt, 4);
+
+        int pages_crawled, total_urls;
+        count_session_progress(session_id, &pages_crawled, &total_urls);
 
         char time_str[100];
         strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", localtime(&start_time));
@@ -385,4 +910,441 @@ void print_resume_info(void)
     }
 
     sqlite3_finalize(stmt);
-}
\ No newline at end of file
+}
+
+// Start a replay: the link graph and the pending frontier are rebuilt from
+// the stored pages. Crawled, failed and skipped URLs keep their queue rows.
+static int replay_reset(void)
+{
+    // Any session may be replayed, running or completed
+    const char *exists_sql = "SELECT 1 FROM crawl_sessions WHERE id = ?";
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(crawler_db.db, exists_sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        fprintf(stderr, "Database error: %s\n", sqlite3_errmsg(crawler_db.db));
+        return 0;
+    }
+    sqlite3_bind_int(stmt, 1, stats.session_id);
+    int exists = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    if (!exists)
+        return -1;
+
+    char sql[256];
+    snprintf(sql, sizeof(sql),
+             "BEGIN;"
+             "DELETE FROM extracted_links WHERE session_id = %d;"
+             "DELETE FROM url_queue WHERE session_id = %d AND status = %d;"
+             "COMMIT;",
+             stats.session_id, stats.session_id, QUEUE_PENDING);
+
+    for (int i = 0; i < DB_SHARD_COUNT; i++)
+    {
+        DBShard *shard = &crawler_db.shards[i];
+        char *err = NULL;
+
+        lock_acquire(&shard->lock, LOCK_DB_SHARD);
+        int rc = sqlite3_exec(shard->db, sql, NULL, NULL, &err);
+        if (rc != SQLITE_OK)
+            sqlite3_exec(shard->db, "ROLLBACK", NULL, NULL, NULL);
+        lock_release(&shard->lock, LOCK_DB_SHARD);
+
+        if (rc != SQLITE_OK)
+        {
+            fprintf(stderr, "Failed to reset %s for replay: %s\n", shard->filename, err);
+            sqlite3_free(err);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Stream the session's pages shard by shard through this thread's readers,
+// so page bodies are never all in memory and writers are not blocked
+static int for_each_page(StoredPageFn fn, void *arg)
+{
+    const char *sql = "SELECT url, content, depth FROM pages WHERE session_id = ? ORDER BY id";
+    int count = 0;
+
+    for (int i = 0; i < DB_SHARD_COUNT; i++)
+    {
+        DBReader *reader = get_reader(&crawler_db.shards[i]);
+        sqlite3_stmt *stmt;
+        if (!reader || sqlite3_prepare_v2(reader->db, sql, -1, &stmt, NULL) != SQLITE_OK)
+        {
+            fprintf(stderr, "Failed to read pages from %s\n", crawler_db.shards[i].filename);
+            return -1;
+        }
+
+        sqlite3_bind_int(stmt, 1, stats.session_id);
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            const char *content = (const char *)sqlite3_column_text(stmt, 1);
+            if (!content)
+                continue;
+
+            fn((const char *)sqlite3_column_text(stmt, 0), content,
+               (size_t)sqlite3_column_bytes(stmt, 1), sqlite3_column_int(stmt, 2), arg);
+            count++;
+        }
+        sqlite3_finalize(stmt);
+    }
+    return count;
+}
+
+// Copy a text column into a fixed buffer, empty when NULL or too long
+static void copy_column(sqlite3_stmt *stmt, int column, char *out, size_t out_size)
+{
+    const char *text = (const char *)sqlite3_column_text(stmt, column);
+    if (text && strlen(text) < out_size)
+        strcpy(out, text);
+    else
+        out[0] = '\0';
+}
+
+static int get_validators(const char *url, PageValidators *out)
+{
+    DBReader *reader = get_reader(shard_for_url(url));
+    if (!reader)
+        return 0;
+
+    sqlite3_bind_text(reader->get_validators, 1, url, -1, SQLITE_STATIC);
+
+    int found = 0;
+    if (sqlite3_step(reader->get_validators) == SQLITE_ROW)
+    {
+        copy_column(reader->get_validators, 0, out->etag, sizeof(out->etag));
+        copy_column(reader->get_validators, 1, out->last_modified, sizeof(out->last_modified));
+        found = out->etag[0] || out->last_modified[0];
+    }
+
+    sqlite3_reset(reader->get_validators);
+    return found;
+}
+
+// Links live in the source page's shard, like its validators
+static int previous_links(const char *url, StoredLinkFn fn, void *arg)
+{
+    DBReader *reader = get_reader(shard_for_url(url));
+    if (!reader)
+        return 0;
+
+    sqlite3_bind_text(reader->previous_links, 1, url, -1, SQLITE_STATIC);
+
+    int count = 0;
+    while (sqlite3_step(reader->previous_links) == SQLITE_ROW)
+    {
+        fn((const char *)sqlite3_column_text(reader->previous_links, 0), arg);
+        count++;
+    }
+
+    sqlite3_reset(reader->previous_links);
+    return count;
+}
+
+static void save_validators(const char *url, const PageValidators *validators)
+{
+    DBShard *shard = shard_for_url(url);
+    lock_acquire(&shard->lock, LOCK_DB_SHARD);
+
+    sqlite3_stmt *stmt;
+    if (validators->etag[0] || validators->last_modified[0])
+    {
+        stmt = shard->save_validators;
+        sqlite3_bind_text(stmt, 1, url, -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 2, stats.session_id);
+        if (validators->etag[0])
+            sqlite3_bind_text(stmt, 3, validators->etag, -1, SQLITE_STATIC);
+        else
+            sqlite3_bind_null(stmt, 3);
+        if (validators->last_modified[0])
+            sqlite3_bind_text(stmt, 4, validators->last_modified, -1, SQLITE_STATIC);
+        else
+            sqlite3_bind_null(stmt, 4);
+        sqlite3_bind_int64(stmt, 5, time(NULL));
+    }
+    else
+    {
+        stmt = shard->delete_validators;
+        sqlite3_bind_text(stmt, 1, url, -1, SQLITE_STATIC);
+    }
+
+    if (sqlite3_step(stmt) != SQLITE_DONE)
+    {
+        fprintf(stderr, "Failed to save validators: %s\n", sqlite3_errmsg(shard->db));
+    }
+
+    sqlite3_reset(stmt);
+    lock_release(&shard->lock, LOCK_DB_SHARD);
+}
+
+// A 304 keeps a copy of the stored page, so the session counts it and
+// --replay parses it like any other. Runs before save_validators moves the
+// validators to this session. Without a stored body only a marker row is
+// written, which --replay skips.
+static void save_unchanged_page(const char *url, int depth)
+{
+    DBShard *shard = shard_for_url(url);
+    lock_acquire(&shard->lock, LOCK_DB_SHARD);
+
+    time_t now = time(NULL);
+    sqlite3_bind_int(shard->copy_page, 1, stats.session_id);
+    sqlite3_bind_int64(shard->copy_page, 2, now);
+    sqlite3_bind_int(shard->copy_page, 3, depth);
+    sqlite3_bind_text(shard->copy_page, 4, url, -1, SQLITE_STATIC);
+    int rc = sqlite3_step(shard->copy_page);
+    sqlite3_reset(shard->copy_page);
+
+    if (rc == SQLITE_DONE && sqlite3_changes(shard->db) == 0)
+    {
+        sqlite3_bind_int(shard->insert_page, 1, stats.session_id);
+        sqlite3_bind_text(shard->insert_page, 2, url, -1, SQLITE_STATIC);
+        sqlite3_bind_null(shard->insert_page, 3);
+        sqlite3_bind_int64(shard->insert_page, 4, 0);
+        sqlite3_bind_int64(shard->insert_page, 5, 304);
+        sqlite3_bind_int64(shard->insert_page, 6, now);
+        sqlite3_bind_int(shard->insert_page, 7, depth);
+        rc = sqlite3_step(shard->insert_page);
+        sqlite3_reset(shard->insert_page);
+    }
+
+    if (rc != SQLITE_DONE)
+    {
+        fprintf(stderr, "Failed to save unchanged page: %s\n", sqlite3_errmsg(shard->db));
+    }
+
+    lock_release(&shard->lock, LOCK_DB_SHARD);
+}
+
+// Add a fetch to the URL's history and schedule its next visit. Only a 200
+// whose body hashes differently from the last one counts as a change.
+static int record_visit(const char *url, int not_modified, uint64_t content_hash)
+{
+    DBShard *shard = shard_for_url(url);
+    time_t now = time(NULL);
+    RevisitHistory history = {0, 0, now};
+    sqlite3_int64 last_change = now;
+    sqlite3_int64 stored_hash = 0;
+    int has_hash = 0;
+
+    lock_acquire(&shard->lock, LOCK_DB_SHARD);
+
+    sqlite3_bind_text(shard->get_revisit, 1, url, -1, SQLITE_STATIC);
+    if (sqlite3_step(shard->get_revisit) == SQLITE_ROW)
+    {
+        has_hash = sqlite3_column_type(shard->get_revisit, 0) != SQLITE_NULL;
+        stored_hash = sqlite3_column_int64(shard->get_revisit, 0);
+        history.visits = sqlite3_column_int(shard->get_revisit, 1);
+        history.changes = sqlite3_column_int(shard->get_revisit, 2);
+        history.first_visit = sqlite3_column_int64(shard->get_revisit, 3);
+        last_change = sqlite3_column_int64(shard->get_revisit, 4);
+    }
+    sqlite3_reset(shard->get_revisit);
+
+    int changed = !not_modified && has_hash && (uint64_t)stored_hash != content_hash;
+    history.visits++;
+    if (changed)
+    {
+        history.changes++;
+        last_change = now;
+    }
+
+    sqlite3_stmt *stmt = shard->save_revisit;
+    sqlite3_bind_text(stmt, 1, url, -1, SQLITE_STATIC);
+    if (!not_modified)
+        sqlite3_bind_int64(stmt, 2, (sqlite3_int64)content_hash);
+    else if (has_hash)
+        sqlite3_bind_int64(stmt, 2, stored_hash);
+    else
+        sqlite3_bind_null(stmt, 2);
+    sqlite3_bind_int(stmt, 3, history.visits);
+    sqlite3_bind_int(stmt, 4, history.changes);
+    sqlite3_bind_int64(stmt, 5, history.first_visit);
+    sqlite3_bind_int64(stmt, 6, now);
+    sqlite3_bind_int64(stmt, 7, last_change);
+    sqlite3_bind_int64(stmt, 8, now + revisit_interval(&history, now));
+
+    if (sqlite3_step(stmt) != SQLITE_DONE)
+    {
+        fprintf(stderr, "Failed to record visit: %s\n", sqlite3_errmsg(shard->db));
+    }
+
+    sqlite3_reset(stmt);
+    lock_release(&shard->lock, LOCK_DB_SHARD);
+    return changed;
+}
+
+// Requeue crawled URLs whose next visit is due, earliest first. The new
+// added_time marks their stored pages stale for dequeue_batch.
+static int schedule_revisits(time_t now, int max)
+{
+    const char *sql =
+        "UPDATE url_queue SET status = 0, seq = ?1, added_time = ?2 "
+        "WHERE session_id = ?3 AND status = 1 AND url IN ("
+        "    SELECT r.url FROM url_revisits r "
+        "    JOIN url_queue q ON q.session_id = ?3 AND q.url = r.url AND q.status = 1 "
+        "    WHERE r.next_visit <= ?2 ORDER BY r.next_visit LIMIT ?4)";
+
+    int scheduled = 0;
+    for (int i = 0; i < DB_SHARD_COUNT && scheduled < max; i++)
+    {
+        DBShard *shard = &crawler_db.shards[i];
+        sqlite3_stmt *stmt;
+
+        lock_acquire(&shard->lock, LOCK_DB_SHARD);
+        if (sqlite3_prepare_v2(shard->db, sql, -1, &stmt, NULL) == SQLITE_OK)
+        {
+            sqlite3_bind_int64(stmt, 1, shard->next_seq);
+            sqlite3_bind_int64(stmt, 2, now);
+            sqlite3_bind_int(stmt, 3, stats.session_id);
+            sqlite3_bind_int(stmt, 4, max - scheduled);
+
+            if (sqlite3_step(stmt) == SQLITE_DONE)
+            {
+                int changes = sqlite3_changes(shard->db);
+                scheduled += changes;
+                if (changes > 0)
+                    shard->next_seq++;
+            }
+            else
+            {
+                fprintf(stderr, "Failed to schedule revisits: %s\n", sqlite3_errmsg(shard->db));
+            }
+            sqlite3_finalize(stmt);
+        }
+        lock_release(&shard->lock, LOCK_DB_SHARD);
+    }
+
+    metrics_gauge_add(GAUGE_QUEUE_DEPTH, scheduled);
+    return scheduled;
+}
+
+// Hosts map to shards like their URLs do
+static int load_robots(const char *host, long *status, char **body, size_t *length, time_t *fetched)
+{
+    DBShard *shard = shard_for_url(host);
+    DBReader *reader = get_reader(shard);
+    sqlite3_stmt *stmt;
+    if (!reader || sqlite3_prepare_v2(reader->db, "SELECT status, body, fetched_time FROM robots_cache WHERE host = ?",
+                                      -1, &stmt, NULL) != SQLITE_OK)
+        return 0;
+
+    sqlite3_bind_text(stmt, 1, host, -1, SQLITE_STATIC);
+
+    int found = 0;
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        size_t size = (size_t)sqlite3_column_bytes(stmt, 1);
+        *body = malloc(size + 1);
+        if (*body)
+        {
+            if (size > 0)
+                memcpy(*body, sqlite3_column_blob(stmt, 1), size);
+            (*body)[size] = '\0';
+            *length = size;
+            *status = sqlite3_column_int64(stmt, 0);
+            *fetched = sqlite3_column_int64(stmt, 2);
+            found = 1;
+        }
+    }
+
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+static void save_robots(const char *host, long status, const char *body, size_t length, time_t fetched)
+{
+    DBShard *shard = shard_for_url(host);
+    sqlite3_stmt *stmt;
+
+    lock_acquire(&shard->lock, LOCK_DB_SHARD);
+    if (sqlite3_prepare_v2(shard->db,
+                           "INSERT OR REPLACE INTO robots_cache (host, status, body, fetched_time) VALUES (?, ?, ?, ?)",
+                           -1, &stmt, NULL) == SQLITE_OK)
+    {
+        sqlite3_bind_text(stmt, 1, host, -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 2, status);
+        sqlite3_bind_blob(stmt, 3, body ? body : "", body ? (int)length : 0, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 4, fetched);
+
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+            fprintf(stderr, "Failed to cache robots.txt: %s\n", sqlite3_errmsg(shard->db));
+        sqlite3_finalize(stmt);
+    }
+    lock_release(&shard->lock, LOCK_DB_SHARD);
+}
+
+// Sitemap URLs arrive in large batches, usually for a single host: one
+// transaction per run of URLs on the same shard
+static int enqueue_batch(const char *const *urls, const time_t *lastmod, int count, int depth)
+{
+    const char *hint_sql =
+        "UPDATE url_revisits SET next_visit = ?1 WHERE url = ?2 AND last_visit < ?3 AND next_visit > ?1";
+
+    time_t now = time(NULL);
+    DBShard *shard = NULL;
+    sqlite3_stmt *hint = NULL;
+    int added = 0;
+
+    for (int i = 0; i <= count; i++)
+    {
+        DBShard *next = i < count ? shard_for_url(urls[i]) : NULL;
+        if (next != shard)
+        {
+            if (shard)
+            {
+                sqlite3_finalize(hint);
+                hint = NULL;
+                sqlite3_exec(shard->db, "COMMIT", 0, 0, 0);
+                lock_release(&shard->lock, LOCK_DB_SHARD);
+            }
+            shard = next;
+            if (shard)
+            {
+                lock_acquire(&shard->lock, LOCK_DB_SHARD);
+                sqlite3_exec(shard->db, "BEGIN", 0, 0, 0);
+                if (lastmod && sqlite3_prepare_v2(shard->db, hint_sql, -1, &hint, NULL) != SQLITE_OK)
+                    hint = NULL;
+            }
+        }
+
+        if (shard)
+            added += shard_insert_url(shard, hint, urls[i], lastmod ? lastmod[i] : 0, depth, now);
+    }
+
+    if (added > 0)
+    {
+        metrics_add(METRIC_LINKS_FOUND, added);
+        metrics_gauge_add(GAUGE_QUEUE_DEPTH, added);
+    }
+    return added;
+}
+
+const StorageBackend sqlite_backend = {
+    .name = "sqlite",
+    .init = init_database,
+    .cleanup = cleanup_database,
+    .create_session = create_crawl_session,
+    .resume_session = resume_crawl_session,
+    .get_session = get_session,
+    .print_resume_info = print_resume_info,
+    .save_page = save_page_to_db,
+    .enqueue = add_url_to_queue,
+    .is_visited = is_url_visited,
+    .dequeue_batch = dequeue_batch,
+    .has_pending = has_pending,
+    .mark = mark_url,
+    .link_batch = save_link_batch,
+    .stats = get_stats,
+    .replay_reset = replay_reset,
+    .for_each_page = for_each_page,
+    .get_validators = get_validators,
+    .previous_links = previous_links,
+    .save_validators = save_validators,
+    .save_unchanged_page = save_unchanged_page,
+    .record_visit = record_visit,
+    .schedule_revisits = schedule_revisits,
+    .load_robots = load_robots,
+    .save_robots = save_robots,
+    .enqueue_batch = enqueue_batch,
+};
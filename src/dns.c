@@ -0,0 +1,212 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "../include/config.h"
+#include "../include/crawler.h"
+#include "../include/dns.h"
+#include "../include/lockstat.h"
+#include "../include/log.h"
+#include "../include/metrics.h"
+#include "../include/threads.h"
+
+#define DNS_PROBE_LIMIT 32 // Slots probed per lookup before giving up
+
+typedef struct
+{
+    char *name;           // Set once when the slot is claimed
+    char *addresses;      // Comma-separated, IPv6 in brackets; NULL if unresolved or failed
+    long long expires_us; // When the answer, or the failure, stops being used
+    int pending;          // A lookup is queued or running
+} DnsEntry;
+
+static DnsEntry cache[DNS_CACHE_SIZE];
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static ThreadPool *resolvers = NULL;
+
+static unsigned int hash_name(const char *s)
+{
+    unsigned int hash = 2166136261u;
+    for (; *s; s++)
+    {
+        hash ^= (unsigned char)*s;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Slot of name, claimed if create is set; -1 if absent or the table is full.
+// Call with cache_mutex held.
+static int find_entry(const char *name, int create)
+{
+    unsigned int start = hash_name(name);
+
+    for (int i = 0; i < DNS_PROBE_LIMIT; i++)
+    {
+        int slot = (start + i) & (DNS_CACHE_SIZE - 1);
+        if (!cache[slot].name)
+        {
+            if (!create || !(cache[slot].name = my_strdup(name)))
+                return -1;
+            return slot;
+        }
+        if (strcmp(cache[slot].name, name) == 0)
+            return slot;
+    }
+    return -1;
+}
+
+// Host name and port of url. Returns 0 when there is no name to resolve,
+// as for IP literals.
+static int url_host_port(const char *url, char *host, size_t host_size, int *port)
+{
+    get_url_host(url, host, host_size);
+    struct in_addr literal;
+    if (!host[0] || host[0] == '[' || inet_pton(AF_INET, host, &literal) == 1)
+        return 0;
+
+    const char *authority = strstr(url, "://");
+    authority = authority ? authority + 3 : url;
+    const char *end = authority + strcspn(authority, "/?#");
+    const char *at = memchr(authority, '@', end - authority);
+    const char *colon = memchr(at ? at + 1 : authority, ':', end - (at ? at + 1 : authority));
+
+    *port = colon ? atoi(colon + 1) : 0;
+    if (*port <= 0)
+        *port = strncasecmp(url, "https://", 8) == 0 ? 443 : 80;
+    return 1;
+}
+
+// Resolver thread task; arg is the cache slot of the name
+static void resolve_task(void *arg)
+{
+    int slot = (int)(intptr_t)arg;
+    const char *name = cache[slot].name; // Never changes once set
+
+    struct addrinfo hints = {0};
+    struct addrinfo *result = NULL;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM; // One entry per address
+
+    char addresses[DNS_MAX_ADDRESSES * (INET6_ADDRSTRLEN + 3)] = "";
+    size_t length = 0;
+    int count = 0;
+    if (getaddrinfo(name, NULL, &hints, &result) == 0)
+    {
+        for (struct addrinfo *ai = result; ai && count < DNS_MAX_ADDRESSES; ai = ai->ai_next)
+        {
+            const void *addr = NULL;
+            if (ai->ai_family == AF_INET)
+                addr = &((struct sockaddr_in *)ai->ai_addr)->sin_addr;
+            else if (ai->ai_family == AF_INET6)
+                addr = &((struct sockaddr_in6 *)ai->ai_addr)->sin6_addr;
+
+            char text[INET6_ADDRSTRLEN];
+            if (!addr || !inet_ntop(ai->ai_family, addr, text, sizeof(text)))
+                continue;
+            length += snprintf(addresses + length, sizeof(addresses) - length,
+                               ai->ai_family == AF_INET6 ? "%s[%s]" : "%s%s", count > 0 ? "," : "", text);
+            count++;
+        }
+        freeaddrinfo(result);
+    }
+
+    char *copy = count > 0 ? my_strdup(addresses) : NULL;
+    long long ttl_us = (count > 0 ? DNS_CACHE_TTL : DNS_NEGATIVE_TTL) * 1000000LL;
+
+    lock_acquire(&cache_mutex, LOCK_DNS_CACHE);
+    free(cache[slot].addresses);
+    cache[slot].addresses = copy;
+    cache[slot].expires_us = metrics_now_us() + ttl_us;
+    cache[slot].pending = 0;
+    lock_release(&cache_mutex, LOCK_DNS_CACHE);
+
+    if (copy)
+    {
+        metrics_add(METRIC_DNS_PREFETCHED, 1);
+        log_debug("Resolved %s: %s\n", name, copy);
+    }
+    else
+        log_info("DNS prefetch found no address for %s\n", name);
+}
+
+void dns_init(void)
+{
+    if (DNS_PREFETCH && !resolvers)
+        resolvers = thread_pool_create(DNS_THREADS);
+}
+
+void dns_prefetch(const char *url)
+{
+    char host[256];
+    int port;
+    if (!resolvers || !url_host_port(url, host, sizeof(host), &port))
+        return;
+
+    lock_acquire(&cache_mutex, LOCK_DNS_CACHE);
+    int slot = find_entry(host, 1);
+    int queue = slot >= 0 && !cache[slot].pending && cache[slot].expires_us <= metrics_now_us();
+    if (queue)
+        cache[slot].pending = 1;
+    lock_release(&cache_mutex, LOCK_DNS_CACHE);
+
+    if (queue && !thread_pool_add_work(resolvers, resolve_task, (void *)(intptr_t)slot))
+    {
+        lock_acquire(&cache_mutex, LOCK_DNS_CACHE);
+        cache[slot].pending = 0;
+        lock_release(&cache_mutex, LOCK_DNS_CACHE);
+    }
+}
+
+struct curl_slist *dns_resolve_list(const char *url)
+{
+    char host[256];
+    int port;
+    if (!resolvers || !url_host_port(url, host, sizeof(host), &port))
+        return NULL;
+
+    // "+" makes libcurl age the entry out of its own DNS cache as usual
+    char entry[sizeof(host) + 16 + DNS_MAX_ADDRESSES * (INET6_ADDRSTRLEN + 3)];
+    entry[0] = '\0';
+    lock_acquire(&cache_mutex, LOCK_DNS_CACHE);
+    int slot = find_entry(host, 0);
+    if (slot >= 0 && cache[slot].addresses && cache[slot].expires_us > metrics_now_us())
+        snprintf(entry, sizeof(entry), "+%s:%d:%s", host, port, cache[slot].addresses);
+    lock_release(&cache_mutex, LOCK_DNS_CACHE);
+
+    // Unknown or expired: libcurl looks it up this time, the cache next time
+    if (!entry[0])
+    {
+        dns_prefetch(url);
+        return NULL;
+    }
+
+    metrics_add(METRIC_DNS_CACHE_HITS, 1);
+    return curl_slist_append(NULL, entry);
+}
+
+void dns_cleanup(void)
+{
+    if (resolvers)
+    {
+        thread_pool_destroy(resolvers);
+        resolvers = NULL;
+    }
+
+    for (int i = 0; i < DNS_CACHE_SIZE; i++)
+    {
+        free(cache[i].name);
+        free(cache[i].addresses);
+        cache[i].name = NULL;
+        cache[i].addresses = NULL;
+    }
+}
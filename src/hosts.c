@@ -0,0 +1,845 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "../include/config.h"
+#include "../include/crawler.h"
+#include "../include/hosts.h"
+#include "../include/log.h"
+#include "../include/metrics.h"
+#include "../include/snapshot.h"
+
+// Host names and their entries; a slot is in use once its name is set
+static char *host_names[HOST_TABLE_SIZE];
+static Host host_table[HOST_TABLE_SIZE];
+
+// Shared by hosts that found no slot
+static Host host_overflow;
+
+static unsigned int hash_string(const char *s)
+{
+    unsigned int hash = 2166136261u;
+    for (; *s; s++)
+    {
+        hash ^= (unsigned char)*s;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Find key in an open-addressing table of size slots (a power of two) and,
+// if create is set, insert it. Slots are claimed with a compare-and-swap and
+// never released, so lookups take no lock. Returns the slot; -1 if the key
+// is absent, or -2 if it is absent and no slot is left within
+// HOST_PROBE_LIMIT probes.
+static int intern_key(char **keys, int size, const char *key, int create)
+{
+    unsigned int start = hash_string(key);
+    char *copy = NULL;
+    int probes = size < HOST_PROBE_LIMIT ? size : HOST_PROBE_LIMIT;
+
+    for (int i = 0; i < probes; i++)
+    {
+        int slot = (start + i) & (size - 1);
+        char *current = __atomic_load_n(&keys[slot], __ATOMIC_ACQUIRE);
+
+        if (!current)
+        {
+            if (!create)
+                return -1;
+            if (!copy && !(copy = my_strdup(key)))
+                return -1;
+
+            char *expected = NULL;
+            if (__atomic_compare_exchange_n(&keys[slot], &expected, copy, 0,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+                return slot;
+            current = expected; // Another thread claimed the slot first
+        }
+
+        if (strcmp(current, key) == 0)
+        {
+            free(copy);
+            return slot;
+        }
+    }
+
+    free(copy);
+    return -2;
+}
+
+static Host *find_host(const char *url, int create)
+{
+    char host[256];
+    get_url_host(url, host, sizeof(host));
+    if (!host[0])
+        return NULL;
+
+    int slot = intern_key(host_names, HOST_TABLE_SIZE, host, create);
+    if (slot == -2)
+        return &host_overflow;
+    return slot < 0 ? NULL : &host_table[slot];
+}
+
+int host_is_shared(const Host *host)
+{
+    return host == &host_overflow;
+}
+
+static const char *host_name(const Host *host)
+{
+    return host == &host_overflow ? "(overflow)" : host_names[host - host_table];
+}
+
+Host *host_get(const char *url)
+{
+    return find_host(url, 1);
+}
+
+Host *host_find(const char *url)
+{
+    return find_host(url, 0);
+}
+
+// Generalize a URL's path to its directory and the extension of its last
+// segment: "/files/2020/report.pdf" becomes "/files/2020/*.pdf" and
+// "/img/123" becomes "/img/*"
+static void url_path_pattern(const char *url, char *out, size_t out_size)
+{
+    const char *path = strstr(url, "://");
+    path = path ? path + 3 : url;
+    path += strcspn(path, "/?#");
+    size_t path_len = strcspn(path, "?#");
+
+    const char *name = path;
+    for (size_t i = 0; i < path_len; i++)
+    {
+        if (path[i] == '/')
+            name = path + i + 1;
+    }
+
+    const char *end = path + path_len;
+    const char *ext = end;
+    for (const char *p = end; p > name; p--)
+    {
+        if (p[-1] == '.')
+        {
+            ext = p - 1;
+            break;
+        }
+    }
+
+    if (name == path) // Empty path
+        snprintf(out, out_size, "/*");
+    else
+        snprintf(out, out_size, "%.*s*%.*s", (int)(name - path), path, (int)(end - ext), ext);
+}
+
+static PathPatternStats *find_pattern(const char *url, int create)
+{
+    // Overflow hosts share no path layout
+    Host *host = find_host(url, create);
+    if (!host || host == &host_overflow)
+        return NULL;
+
+    char pattern[256];
+    url_path_pattern(url, pattern, sizeof(pattern));
+
+    int slot = intern_key(host->pattern_keys, HOST_PATTERN_SLOTS, pattern, create);
+    return slot < 0 ? NULL : &host->patterns[slot];
+}
+
+void host_record_fetch(const char *url)
+{
+    PathPatternStats *pattern = find_pattern(url, 1);
+    if (pattern)
+        __atomic_add_fetch(&pattern->fetched, 1, __ATOMIC_RELAXED);
+
+    Host *host = find_host(url, 0);
+    if (host)
+        __atomic_add_fetch(&host->pages, 1, __ATOMIC_RELAXED);
+}
+
+static const char *ADMISSION_NAMES[URL_ADMISSION_COUNT] = {
+    "admitted", "too long", "too deep", "repeating path", "too many parameters", "shape budget", "host budget"};
+
+const char *url_admission_name(UrlAdmission admission)
+{
+    return admission >= 0 && admission < URL_ADMISSION_COUNT ? ADMISSION_NAMES[admission] : "unknown";
+}
+
+// Mask a URL to its shape: path segments containing a digit become "*" and
+// the query keeps only its parameter names, "/cal/2024/05?view=day&x=1"
+// becoming "/cal/*/*?view&x"
+static void url_trap_pattern(const char *url, char *out, size_t out_size)
+{
+    const char *p = strstr(url, "://");
+    p = p ? p + 3 : url;
+    p += strcspn(p, "/?#");
+
+    size_t len = 0;
+    while (*p && *p != '?' && *p != '#' && len + 2 < out_size)
+    {
+        // One segment, with its leading slash
+        size_t seg = 1 + strcspn(p + 1, "/?#");
+        if (strcspn(p + 1, "0123456789") < seg - 1)
+        {
+            out[len++] = '/';
+            out[len++] = '*';
+        }
+        else
+        {
+            size_t n = seg < out_size - 1 - len ? seg : out_size - 1 - len;
+            memcpy(out + len, p, n);
+            len += n;
+        }
+        p += seg;
+    }
+
+    if (*p == '?')
+    {
+        char separator = '?';
+        for (p++; *p && *p != '#' && len + 2 < out_size; separator = '&')
+        {
+            size_t name = strcspn(p, "=&#");
+            out[len++] = separator;
+            size_t n = name < out_size - 1 - len ? name : out_size - 1 - len;
+            memcpy(out + len, p, n);
+            len += n;
+            p += strcspn(p, "&#");
+            if (*p == '&')
+                p++;
+        }
+    }
+    out[len] = '\0';
+}
+
+// Checks on the URL alone
+static UrlAdmission check_url_shape(const char *url)
+{
+    if (strlen(url) > TRAP_MAX_URL_LENGTH)
+        return URL_TRAP_LENGTH;
+
+    const char *path = strstr(url, "://");
+    path = path ? path + 3 : url;
+    path += strcspn(path, "/?#");
+    size_t path_len = strcspn(path, "?#");
+
+    const char *segments[TRAP_MAX_PATH_SEGMENTS];
+    size_t lengths[TRAP_MAX_PATH_SEGMENTS];
+    int count = 0;
+    for (size_t i = 0; i < path_len;)
+    {
+        i++; // The slash
+        size_t n = strcspn(path + i, "/?#");
+        if (n > 0)
+        {
+            if (count == TRAP_MAX_PATH_SEGMENTS)
+                return URL_TRAP_DEPTH;
+
+            int repeats = 0;
+            for (int j = 0; j < count; j++)
+            {
+                if (lengths[j] == n && memcmp(segments[j], path + i, n) == 0)
+                    repeats++;
+            }
+            if (repeats >= TRAP_MAX_SEGMENT_REPEATS)
+                return URL_TRAP_REPEATS;
+
+            segments[count] = path + i;
+            lengths[count] = n;
+            count++;
+        }
+        i += n;
+    }
+
+    const char *query = path[path_len] == '?' ? path + path_len + 1 : NULL;
+    int params = 0;
+    while (query && *query && *query != '#')
+    {
+        size_t n = strcspn(query, "&#");
+        if (n > 0 && ++params > TRAP_MAX_QUERY_PARAMS)
+            return URL_TRAP_PARAMS;
+        query += n;
+        if (*query == '&')
+            query++;
+    }
+    return URL_ADMITTED;
+}
+
+static int over_budget(unsigned long used, long budget)
+{
+    return budget > 0 && used >= (unsigned long)budget;
+}
+
+UrlAdmission host_admit_url(const char *url)
+{
+    Host *host = find_host(url, 1);
+    UrlAdmission admission = check_url_shape(url);
+
+    // Without an entry of its own a host has no budget to check against
+    if (admission == URL_ADMITTED && host == &host_overflow)
+        admission = URL_HOST_BUDGET;
+    else if (admission == URL_ADMITTED && host)
+    {
+        char pattern[256];
+        url_trap_pattern(url, pattern, sizeof(pattern));
+        int slot = intern_key(host->trap_keys, HOST_TRAP_SLOTS, pattern, 0);
+
+        if (over_budget(__atomic_load_n(&host->urls_queued, __ATOMIC_RELAXED), HOST_URL_BUDGET) ||
+            over_budget(__atomic_load_n(&host->pages, __ATOMIC_RELAXED), HOST_PAGE_BUDGET))
+            admission = URL_HOST_BUDGET;
+        else if (slot >= 0 &&
+                 over_budget(__atomic_load_n(&host->trap_counts[slot], __ATOMIC_RELAXED), TRAP_PATTERN_MAX_URLS))
+            admission = URL_TRAP_PATTERN;
+    }
+
+    // Log the first refusal of each kind per host
+    if (admission != URL_ADMITTED && host &&
+        __atomic_fetch_add(&host->refused[admission], 1, __ATOMIC_RELAXED) == 0)
+        log_info("Host %s: refusing URLs (%s), first %s\n", host_name(host),
+                 ADMISSION_NAMES[admission], url);
+    return admission;
+}
+
+void host_record_queued(const char *url)
+{
+    Host *host = find_host(url, 1);
+    if (!host)
+        return;
+    __atomic_add_fetch(&host->urls_queued, 1, __ATOMIC_RELAXED);
+
+    char pattern[256];
+    url_trap_pattern(url, pattern, sizeof(pattern));
+    int slot = intern_key(host->trap_keys, HOST_TRAP_SLOTS, pattern, 1);
+    if (slot >= 0)
+        __atomic_add_fetch(&host->trap_counts[slot], 1, __ATOMIC_RELAXED);
+}
+
+void hosts_print_trap_report(FILE *out)
+{
+    int header = 0;
+
+    for (int i = 0; i < HOST_TABLE_SIZE; i++)
+    {
+        const char *name = __atomic_load_n(&host_names[i], __ATOMIC_ACQUIRE);
+        if (!name)
+            continue;
+
+        const Host *host = &host_table[i];
+        unsigned long total = 0;
+        for (int r = URL_ADMITTED + 1; r < URL_ADMISSION_COUNT; r++)
+            total += host->refused[r];
+        if (total == 0)
+            continue;
+
+        if (!header)
+        {
+            fprintf(out, "\n=== Crawler Traps and Budgets ===\n");
+            header = 1;
+        }
+        fprintf(out, "%s: %lu URLs refused (", name, total);
+        const char *separator = "";
+        for (int r = URL_ADMITTED + 1; r < URL_ADMISSION_COUNT; r++)
+        {
+            if (host->refused[r] == 0)
+                continue;
+            fprintf(out, "%s%s %lu", separator, ADMISSION_NAMES[r], host->refused[r]);
+            separator = ", ";
+        }
+        fprintf(out, ")");
+
+        int top = -1;
+        for (int s = 0; s < HOST_TRAP_SLOTS; s++)
+        {
+            if (host->trap_keys[s] && (top < 0 || host->trap_counts[s] > host->trap_counts[top]))
+                top = s;
+        }
+        if (top >= 0)
+            fprintf(out, "; most queued shape %s (%lu)", host->trap_keys[top], host->trap_counts[top]);
+        fprintf(out, "\n");
+    }
+}
+
+
+void host_record_skip(const char *url, const char *content_type)
+{
+    PathPatternStats *pattern = find_pattern(url, 1);
+    if (pattern)
+        __atomic_add_fetch(&pattern->skipped, 1, __ATOMIC_RELAXED);
+
+    Host *host = find_host(url, 1);
+    int slot = host && host != &host_overflow ? intern_key(host->mime_keys, HOST_MIME_SLOTS, content_type, 1) : -1;
+    if (slot >= 0)
+        __atomic_add_fetch(&host->mime_skipped[slot], 1, __ATOMIC_RELAXED);
+}
+
+int host_should_defer(const char *url)
+{
+    PathPatternStats *pattern = find_pattern(url, 0);
+    if (!pattern)
+        return 0;
+
+    if (__atomic_load_n(&pattern->fetched, __ATOMIC_RELAXED) > 0 ||
+        __atomic_load_n(&pattern->skipped, __ATOMIC_RELAXED) < CONTENT_SKIP_THRESHOLD)
+        return 0;
+
+    return __atomic_fetch_add(&pattern->deferred, 1, __ATOMIC_RELAXED) % CONTENT_SKIP_PROBE != 0;
+}
+
+void host_pace(const char *url)
+{
+    Host *host = find_host(url, 0);
+    long delay_ms = host ? __atomic_load_n(&host->crawl_delay_ms, __ATOMIC_RELAXED) : 0;
+    if (delay_ms <= 0)
+        return;
+
+    // Claim the next free slot; each claim pushes the following one back
+    long long now = metrics_now_us();
+    long long slot = __atomic_load_n(&host->next_fetch_us, __ATOMIC_RELAXED);
+    long long start;
+    do
+    {
+        start = slot > now ? slot : now;
+    } while (!__atomic_compare_exchange_n(&host->next_fetch_us, &slot, start + delay_ms * 1000, 0,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    if (start > now)
+    {
+        long long wait = start - now;
+        struct timespec ts = {wait / 1000000, (wait % 1000000) * 1000};
+        nanosleep(&ts, NULL);
+    }
+}
+
+int host_id(const char *url)
+{
+    Host *host = find_host(url, 1);
+    return host && host != &host_overflow ? (int)(host - host_table) : -1;
+}
+
+int host_run_length(const char *url)
+{
+    Host *host = find_host(url, 0);
+    long delay_ms = host ? __atomic_load_n(&host->crawl_delay_ms, __ATOMIC_RELAXED) : 0;
+    if (delay_ms <= 0)
+        return HOST_RUN_LENGTH;
+
+    long length = HOST_RUN_MAX_WAIT_MS / delay_ms + 1; // The first fetch does not wait
+    return length < HOST_RUN_LENGTH ? (int)length : HOST_RUN_LENGTH;
+}
+
+void host_breaker_record(const char *url, int failed)
+{
+    Host *host = failed ? find_host(url, 1) : find_host(url, 0);
+    if (!host)
+        return;
+
+    if (!failed)
+    {
+        if (__atomic_load_n(&host->consecutive_failures, __ATOMIC_RELAXED) != 0)
+            __atomic_store_n(&host->consecutive_failures, 0, __ATOMIC_RELAXED);
+        if (__atomic_load_n(&host->breaker_until_us, __ATOMIC_ACQUIRE) != 0)
+        {
+            __atomic_store_n(&host->breaker_trips, 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&host->breaker_probing, 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&host->breaker_until_us, 0, __ATOMIC_RELEASE);
+            log_info("Host %s is responding again\n", host_name(host));
+        }
+        return;
+    }
+
+    // Trip when the count reaches the threshold, not on every failure past
+    // it, or when the probe of a half-open breaker failed
+    int failures = __atomic_add_fetch(&host->consecutive_failures, 1, __ATOMIC_RELAXED);
+    int probing = 1;
+    int probe_failed = __atomic_compare_exchange_n(&host->breaker_probing, &probing, 0, 0,
+                                                   __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+    if (failures != MAX_CONSECUTIVE_ERRORS && !probe_failed)
+        return;
+
+    int trips = __atomic_add_fetch(&host->breaker_trips, 1, __ATOMIC_RELAXED);
+    long long cooldown_ms = (long long)HOST_BREAKER_COOLDOWN_MS << (trips < 10 ? trips - 1 : 9);
+    __atomic_store_n(&host->breaker_until_us, metrics_now_us() + cooldown_ms * 1000, __ATOMIC_RELEASE);
+    metrics_add(METRIC_BREAKER_TRIPS, 1);
+
+    if (trips >= HOST_BREAKER_MAX_TRIPS)
+        log_warn("Host %s given up after %d failures\n", host_name(host), failures);
+    else
+        log_warn("Host %s unavailable after %d failures; next probe in %lld s\n",
+                 host_name(host), failures, cooldown_ms / 1000);
+}
+
+HostAvailability host_breaker_allow(const char *url, long long *retry_at_us)
+{
+    Host *host = find_host(url, 0);
+    if (!host)
+        return HOST_AVAILABLE;
+    if (__atomic_load_n(&host->breaker_trips, __ATOMIC_RELAXED) >= HOST_BREAKER_MAX_TRIPS)
+        return HOST_DOWN;
+
+    long long until = __atomic_load_n(&host->breaker_until_us, __ATOMIC_ACQUIRE);
+    if (until == 0)
+        return HOST_AVAILABLE;
+
+    long long now = metrics_now_us();
+    if (now < until)
+    {
+        *retry_at_us = until;
+        return HOST_WAIT;
+    }
+
+    // Half-open: a single probe, the rest wait for its outcome
+    int expected = 0;
+    if (__atomic_compare_exchange_n(&host->breaker_probing, &expected, 1, 0,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        return HOST_AVAILABLE;
+    *retry_at_us = now + HOST_BREAKER_COOLDOWN_MS * 1000LL;
+    return HOST_WAIT;
+}
+
+int host_is_down(const char *url)
+{
+    Host *host = find_host(url, 0);
+    return host && __atomic_load_n(&host->breaker_trips, __ATOMIC_RELAXED) >= HOST_BREAKER_MAX_TRIPS;
+}
+
+static int host_limit(const Host *host)
+{
+    int limit = __atomic_load_n(&host->limit_milli, __ATOMIC_RELAXED);
+    return limit ? limit : HOST_INITIAL_CONCURRENCY * 1000;
+}
+
+int host_acquire_slot(const char *url)
+{
+    Host *host = find_host(url, 1);
+    if (!host)
+        return 1;
+
+    int limit = host_limit(host) / 1000;
+    int in_flight = __atomic_load_n(&host->in_flight, __ATOMIC_RELAXED);
+    do
+    {
+        if (in_flight >= limit)
+            return 0;
+    } while (!__atomic_compare_exchange_n(&host->in_flight, &in_flight, in_flight + 1, 0,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return 1;
+}
+
+int host_slot_free(const char *url)
+{
+    Host *host = find_host(url, 0);
+    return !host || __atomic_load_n(&host->in_flight, __ATOMIC_RELAXED) < host_limit(host) / 1000;
+}
+
+void host_release_slot(const char *url)
+{
+    Host *host = find_host(url, 0);
+    if (host)
+        __atomic_sub_fetch(&host->in_flight, 1, __ATOMIC_RELAXED);
+}
+
+void host_record_latency(const char *url, long long latency_us, int overloaded)
+{
+    Host *host = find_host(url, 0);
+    if (!host || (latency_us < 0 && !overloaded))
+        return; // Connection failures say nothing about load
+    __atomic_add_fetch(&host->fetches, 1, __ATOMIC_RELAXED);
+
+    // Moving average over about eight fetches; concurrent updates may lose
+    // a sample, which only slows it down
+    long long average = __atomic_load_n(&host->latency_us, __ATOMIC_RELAXED);
+    int samples = __atomic_load_n(&host->latency_samples, __ATOMIC_RELAXED);
+    int spike = 0;
+    if (latency_us >= 0)
+    {
+        spike = samples >= 4 && latency_us > average * HOST_LATENCY_SPIKE_FACTOR;
+        __atomic_store_n(&host->latency_us, samples ? average + (latency_us - average) / 8 : latency_us,
+                         __ATOMIC_RELAXED);
+        __atomic_add_fetch(&host->latency_samples, 1, __ATOMIC_RELAXED);
+    }
+
+    int limit = host_limit(host);
+    if (overloaded || spike)
+    {
+        long long now = metrics_now_us();
+        long long last = __atomic_load_n(&host->last_decrease_us, __ATOMIC_RELAXED);
+        long long gap = average * 2 > 100000 ? average * 2 : 100000;
+        if (now - last < gap || !__atomic_compare_exchange_n(&host->last_decrease_us, &last, now, 0,
+                                                             __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            return;
+
+        int decreased = limit / 2 > HOST_MIN_CONCURRENCY * 1000 ? limit / 2 : HOST_MIN_CONCURRENCY * 1000;
+        __atomic_store_n(&host->limit_milli, decreased, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&host->decreases, 1, __ATOMIC_RELAXED);
+        log_info("Host %s: concurrency limit %.1f after %s\n", host_name(host),
+                 decreased / 1000.0, spike ? "a latency spike" : "an overload response");
+        return;
+    }
+
+    // Additive increase: one more slot per limit's worth of calm fetches
+    int current = __atomic_load_n(&host->limit_milli, __ATOMIC_RELAXED);
+    for (;;)
+    {
+        limit = current ? current : HOST_INITIAL_CONCURRENCY * 1000;
+        int increased = limit + 1000 * 1000 / limit;
+        if (increased > HOST_MAX_CONCURRENCY * 1000)
+            increased = HOST_MAX_CONCURRENCY * 1000;
+        if (increased == current ||
+            __atomic_compare_exchange_n(&host->limit_milli, &current, increased, 0,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            break;
+    }
+}
+
+static int compare_fetches(const void *a, const void *b)
+{
+    unsigned long fa = host_table[*(const int *)a].fetches;
+    unsigned long fb = host_table[*(const int *)b].fetches;
+    return fa < fb ? 1 : fa > fb ? -1 : 0;
+}
+
+void hosts_print_concurrency_report(FILE *out)
+{
+    static int order[HOST_TABLE_SIZE];
+    int count = 0;
+
+    for (int i = 0; i < HOST_TABLE_SIZE; i++)
+    {
+        if (__atomic_load_n(&host_names[i], __ATOMIC_ACQUIRE) && host_table[i].fetches > 0)
+            order[count++] = i;
+    }
+    if (count == 0)
+        return;
+
+    qsort(order, count, sizeof(int), compare_fetches);
+    fprintf(out, "\n=== Host Concurrency ===\n");
+    for (int i = 0; i < count && i < 10; i++)
+    {
+        const Host *host = &host_table[order[i]];
+        fprintf(out, "%s: limit %.1f, %lu fetches, %.1f ms to first byte, %lu backoffs\n",
+                host_names[order[i]], host_limit(host) / 1000.0, host->fetches,
+                host->latency_us / 1000.0, host->decreases);
+    }
+    if (count > 10)
+        fprintf(out, "(%d more hosts)\n", count - 10);
+}
+
+void host_record_transfer(const char *url, long long wire_bytes, long long decoded_bytes)
+{
+    Host *host = find_host(url, 0);
+    if (!host || (wire_bytes <= 0 && decoded_bytes <= 0))
+        return;
+    __atomic_add_fetch(&host->wire_bytes, (unsigned long long)wire_bytes, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&host->decoded_bytes, (unsigned long long)decoded_bytes, __ATOMIC_RELAXED);
+}
+
+static int compare_wire_bytes(const void *a, const void *b)
+{
+    unsigned long long wa = host_table[*(const int *)a].wire_bytes;
+    unsigned long long wb = host_table[*(const int *)b].wire_bytes;
+    return wa < wb ? 1 : wa > wb ? -1 : 0;
+}
+
+void hosts_print_transfer_report(FILE *out)
+{
+    static int order[HOST_TABLE_SIZE];
+    int count = 0;
+
+    for (int i = 0; i < HOST_TABLE_SIZE; i++)
+    {
+        if (__atomic_load_n(&host_names[i], __ATOMIC_ACQUIRE) && host_table[i].wire_bytes > 0)
+            order[count++] = i;
+    }
+    if (count == 0)
+        return;
+
+    qsort(order, count, sizeof(int), compare_wire_bytes);
+    fprintf(out, "\n=== Host Transfer ===\n");
+    for (int i = 0; i < count && i < 10; i++)
+    {
+        const Host *host = &host_table[order[i]];
+        fprintf(out, "%s: %.1f KB transferred, %.1f KB decoded (%.2fx)\n", host_names[order[i]],
+                host->wire_bytes / 1024.0, host->decoded_bytes / 1024.0,
+                (double)host->decoded_bytes / host->wire_bytes);
+    }
+    if (count > 10)
+        fprintf(out, "(%d more hosts)\n", count - 10);
+}
+
+void hosts_print_skip_report(FILE *out)
+{
+    int header = 0;
+
+    for (int i = 0; i < HOST_TABLE_SIZE; i++)
+    {
+        const char *name = __atomic_load_n(&host_names[i], __ATOMIC_ACQUIRE);
+        if (!name)
+            continue;
+
+        Host *host = &host_table[i];
+        int printed = 0;
+        for (int m = 0; m < HOST_MIME_SLOTS; m++)
+        {
+            const char *type = __atomic_load_n(&host->mime_keys[m], __ATOMIC_ACQUIRE);
+            if (!type)
+                continue;
+
+            if (!header)
+            {
+                fprintf(out, "\n=== Skipped Content Types ===\n");
+                header = 1;
+            }
+            if (!printed)
+                fprintf(out, "%s:", name);
+            fprintf(out, "%s %s %lu", printed ? "," : "", type,
+                    __atomic_load_n(&host->mime_skipped[m], __ATOMIC_RELAXED));
+            printed = 1;
+        }
+        if (printed)
+            fprintf(out, "\n");
+    }
+}
+
+static void put_count(FILE *out, unsigned long value)
+{
+    uint64_t v = value;
+    snapshot_put(out, &v, sizeof(v));
+}
+
+static unsigned long get_count(SnapshotReader *in)
+{
+    uint64_t v;
+    snapshot_get(in, &v, sizeof(v));
+    return (unsigned long)v;
+}
+
+// Keys in use in an interned table
+static uint32_t used_keys(char *const *keys, int size)
+{
+    uint32_t count = 0;
+    for (int i = 0; i < size; i++)
+        count += __atomic_load_n(&keys[i], __ATOMIC_ACQUIRE) != NULL;
+    return count;
+}
+
+// Each host: name, controller state, budget counters, then its path
+// patterns and trap shapes, each list prefixed by its length. Written once
+// the workers have stopped, so the counts hold.
+void hosts_snapshot_write(FILE *out)
+{
+    uint32_t count = used_keys(host_names, HOST_TABLE_SIZE);
+    snapshot_put(out, &count, sizeof(count));
+
+    for (int i = 0; i < HOST_TABLE_SIZE; i++)
+    {
+        const char *name = __atomic_load_n(&host_names[i], __ATOMIC_ACQUIRE);
+        if (!name)
+            continue;
+
+        const Host *host = &host_table[i];
+        int32_t limit_milli = __atomic_load_n(&host->limit_milli, __ATOMIC_RELAXED);
+        int32_t latency_samples = __atomic_load_n(&host->latency_samples, __ATOMIC_RELAXED);
+        int64_t latency_us = __atomic_load_n(&host->latency_us, __ATOMIC_RELAXED);
+        snapshot_put_string(out, name);
+        snapshot_put(out, &limit_milli, sizeof(limit_milli));
+        snapshot_put(out, &latency_samples, sizeof(latency_samples));
+        snapshot_put(out, &latency_us, sizeof(latency_us));
+        put_count(out, __atomic_load_n(&host->fetches, __ATOMIC_RELAXED));
+        put_count(out, __atomic_load_n(&host->decreases, __ATOMIC_RELAXED));
+        put_count(out, __atomic_load_n(&host->urls_queued, __ATOMIC_RELAXED));
+        put_count(out, __atomic_load_n(&host->pages, __ATOMIC_RELAXED));
+        for (int r = 0; r < URL_ADMISSION_COUNT; r++)
+            put_count(out, __atomic_load_n(&host->refused[r], __ATOMIC_RELAXED));
+
+        uint32_t patterns = used_keys(host->pattern_keys, HOST_PATTERN_SLOTS);
+        snapshot_put(out, &patterns, sizeof(patterns));
+        for (int p = 0; p < HOST_PATTERN_SLOTS; p++)
+        {
+            const char *key = __atomic_load_n(&host->pattern_keys[p], __ATOMIC_ACQUIRE);
+            if (!key)
+                continue;
+            snapshot_put_string(out, key);
+            put_count(out, __atomic_load_n(&host->patterns[p].fetched, __ATOMIC_RELAXED));
+            put_count(out, __atomic_load_n(&host->patterns[p].skipped, __ATOMIC_RELAXED));
+            put_count(out, __atomic_load_n(&host->patterns[p].deferred, __ATOMIC_RELAXED));
+        }
+
+        uint32_t shapes = used_keys(host->trap_keys, HOST_TRAP_SLOTS);
+        snapshot_put(out, &shapes, sizeof(shapes));
+        for (int t = 0; t < HOST_TRAP_SLOTS; t++)
+        {
+            const char *key = __atomic_load_n(&host->trap_keys[t], __ATOMIC_ACQUIRE);
+            if (!key)
+                continue;
+            snapshot_put_string(out, key);
+            put_count(out, __atomic_load_n(&host->trap_counts[t], __ATOMIC_RELAXED));
+        }
+    }
+}
+
+// Runs before the workers start, so plain stores are enough. Entries that no
+// longer fit a full table are read and dropped.
+int hosts_snapshot_read(SnapshotReader *in)
+{
+    static Host discard;
+    char name[256], key[256];
+    uint32_t count;
+    int restored = 0;
+
+    snapshot_get(in, &count, sizeof(count));
+    for (uint32_t i = 0; i < count && !in->failed; i++)
+    {
+        snapshot_get_string(in, name, sizeof(name));
+        int slot = in->failed ? -1 : intern_key(host_names, HOST_TABLE_SIZE, name, 1);
+        Host *host = slot >= 0 ? &host_table[slot] : &discard;
+        restored += slot >= 0;
+
+        int32_t limit_milli, latency_samples;
+        int64_t latency_us;
+        snapshot_get(in, &limit_milli, sizeof(limit_milli));
+        snapshot_get(in, &latency_samples, sizeof(latency_samples));
+        snapshot_get(in, &latency_us, sizeof(latency_us));
+        host->limit_milli = limit_milli;
+        host->latency_samples = latency_samples;
+        host->latency_us = latency_us;
+        host->fetches = get_count(in);
+        host->decreases = get_count(in);
+        host->urls_queued = get_count(in);
+        host->pages = get_count(in);
+        for (int r = 0; r < URL_ADMISSION_COUNT; r++)
+            host->refused[r] = get_count(in);
+
+        uint32_t patterns;
+        snapshot_get(in, &patterns, sizeof(patterns));
+        for (uint32_t p = 0; p < patterns && !in->failed; p++)
+        {
+            snapshot_get_string(in, key, sizeof(key));
+            int k = host == &discard || in->failed
+                        ? -1
+                        : intern_key(host->pattern_keys, HOST_PATTERN_SLOTS, key, 1);
+            PathPatternStats *stats = k >= 0 ? &host->patterns[k] : &discard.patterns[0];
+            stats->fetched = get_count(in);
+            stats->skipped = get_count(in);
+            stats->deferred = get_count(in);
+        }
+
+        uint32_t shapes;
+        snapshot_get(in, &shapes, sizeof(shapes));
+        for (uint32_t t = 0; t < shapes && !in->failed; t++)
+        {
+            snapshot_get_string(in, key, sizeof(key));
+            int k = host == &discard || in->failed
+                        ? -1
+                        : intern_key(host->trap_keys, HOST_TRAP_SLOTS, key, 1);
+            unsigned long value = get_count(in);
+            if (k >= 0)
+                host->trap_counts[k] = value;
+        }
+    }
+    return restored;
+}
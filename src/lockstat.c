@@ -0,0 +1,243 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "../include/config.h"
+#include "../include/lockstat.h"
+#include "../include/trace.h"
+
+// Histogram bucket upper bounds in nanoseconds; a final +Inf bucket follows
+static const long long LOCK_BOUNDS_NS[] = {
+    250, 1000, 4000, 16000, 64000, 256000, 1000000, 4000000, 16000000, 64000000, 256000000, 1000000000};
+
+#define LOCK_BUCKET_COUNT (sizeof(LOCK_BOUNDS_NS) / sizeof(LOCK_BOUNDS_NS[0]) + 1)
+
+typedef struct
+{
+    unsigned long buckets[LOCK_BUCKET_COUNT];
+    unsigned long long sum_ns;
+} LockHistogram;
+
+typedef struct
+{
+    unsigned long acquisitions;
+    unsigned long contended; // Acquisitions that had to block
+    LockHistogram wait;
+    LockHistogram hold;
+} LockCounters;
+
+// One thread's counters, padded like the metrics slots
+typedef struct
+{
+    LockCounters classes[LOCK_CLASS_COUNT];
+} __attribute__((aligned(64))) LockSlot;
+
+static const char *LOCK_NAMES[LOCK_CLASS_COUNT] = {"db_shard", "log_store", "work_queue", "dns_cache"};
+
+int lockstat_flags = 0;
+
+static LockSlot slots[METRICS_MAX_THREADS];
+static int next_slot = 0;
+static __thread LockSlot *thread_slot = NULL;
+
+// When each lock class was last acquired by this thread. Locks of one class
+// are never nested, so one timestamp per class is enough.
+static __thread long long acquired_at[LOCK_CLASS_COUNT];
+
+static LockSlot *get_slot(void)
+{
+    if (!thread_slot)
+    {
+        int index = __atomic_fetch_add(&next_slot, 1, __ATOMIC_RELAXED);
+        thread_slot = &slots[index < METRICS_MAX_THREADS ? index : METRICS_MAX_THREADS - 1];
+    }
+    return thread_slot;
+}
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void observe(LockHistogram *h, long long ns)
+{
+    size_t bucket = 0;
+    while (bucket < LOCK_BUCKET_COUNT - 1 && ns > LOCK_BOUNDS_NS[bucket])
+        bucket++;
+
+    __atomic_fetch_add(&h->buckets[bucket], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sum_ns, (unsigned long long)(ns > 0 ? ns : 0), __ATOMIC_RELAXED);
+}
+
+void lock_acquire_slow(pthread_mutex_t *mutex, LockClass lock_class)
+{
+    long long wait_ns = 0;
+
+    // Uncontended acquisitions skip the clock until the hold starts
+    if (pthread_mutex_trylock(mutex) != 0)
+    {
+        long long start = now_ns();
+        pthread_mutex_lock(mutex);
+        wait_ns = now_ns() - start;
+
+        // Traces attribute only storage lock waits to the URL
+        if ((lockstat_flags & LOCKSTAT_TRACE_WAITS) &&
+            (lock_class == LOCK_DB_SHARD || lock_class == LOCK_LOG_STORE))
+            trace_add_lock_wait(wait_ns / 1000);
+    }
+
+    if (lockstat_flags & LOCKSTAT_COLLECT)
+    {
+        LockCounters *c = &get_slot()->classes[lock_class];
+        __atomic_fetch_add(&c->acquisitions, 1, __ATOMIC_RELAXED);
+        if (wait_ns > 0)
+            __atomic_fetch_add(&c->contended, 1, __ATOMIC_RELAXED);
+        observe(&c->wait, wait_ns);
+        acquired_at[lock_class] = now_ns();
+    }
+}
+
+static void end_hold(LockClass lock_class)
+{
+    if ((lockstat_flags & LOCKSTAT_COLLECT) && acquired_at[lock_class])
+    {
+        observe(&get_slot()->classes[lock_class].hold, now_ns() - acquired_at[lock_class]);
+        acquired_at[lock_class] = 0;
+    }
+}
+
+void lock_release_slow(pthread_mutex_t *mutex, LockClass lock_class)
+{
+    end_hold(lock_class);
+    pthread_mutex_unlock(mutex);
+}
+
+// Time asleep on the condition is neither hold nor contention: end the
+// hold before waiting and start a new one once the mutex is reacquired.
+void lock_cond_wait_slow(pthread_cond_t *cond, pthread_mutex_t *mutex, LockClass lock_class)
+{
+    end_hold(lock_class);
+    pthread_cond_wait(cond, mutex);
+    if (lockstat_flags & LOCKSTAT_COLLECT)
+        acquired_at[lock_class] = now_ns();
+}
+
+void lockstat_enable(int flags)
+{
+    lockstat_flags |= flags;
+}
+
+int lockstat_is_collecting(void)
+{
+    return (lockstat_flags & LOCKSTAT_COLLECT) != 0;
+}
+
+static void merge_class(LockClass lock_class, LockCounters *out)
+{
+    memset(out, 0, sizeof(*out));
+    for (int i = 0; i < METRICS_MAX_THREADS; i++)
+    {
+        const LockCounters *c = &slots[i].classes[lock_class];
+        out->acquisitions += __atomic_load_n(&c->acquisitions, __ATOMIC_RELAXED);
+        out->contended += __atomic_load_n(&c->contended, __ATOMIC_RELAXED);
+        for (size_t b = 0; b < LOCK_BUCKET_COUNT; b++)
+        {
+            out->wait.buckets[b] += __atomic_load_n(&c->wait.buckets[b], __ATOMIC_RELAXED);
+            out->hold.buckets[b] += __atomic_load_n(&c->hold.buckets[b], __ATOMIC_RELAXED);
+        }
+        out->wait.sum_ns += __atomic_load_n(&c->wait.sum_ns, __ATOMIC_RELAXED);
+        out->hold.sum_ns += __atomic_load_n(&c->hold.sum_ns, __ATOMIC_RELAXED);
+    }
+}
+
+static unsigned long histogram_count(const LockHistogram *h)
+{
+    unsigned long count = 0;
+    for (size_t b = 0; b < LOCK_BUCKET_COUNT; b++)
+        count += h->buckets[b];
+    return count;
+}
+
+// Upper bound of the bucket holding the pct-th percentile, in microseconds
+static double bucket_percentile_us(const LockHistogram *h, int pct)
+{
+    unsigned long count = histogram_count(h);
+    unsigned long rank = (count * pct + 99) / 100, seen = 0;
+    for (size_t b = 0; b < LOCK_BUCKET_COUNT - 1; b++)
+    {
+        seen += h->buckets[b];
+        if (seen >= rank)
+            return LOCK_BOUNDS_NS[b] / 1000.0;
+    }
+    return LOCK_BOUNDS_NS[LOCK_BUCKET_COUNT - 2] / 1000.0;
+}
+
+void lockstat_print_report(FILE *out)
+{
+    if (!lockstat_is_collecting())
+        return;
+
+    fprintf(out, "\n=== Lock Contention ===\n");
+    fprintf(out, "%-11s %10s %10s %12s %10s %12s %10s\n",
+            "lock", "acquired", "contended", "wait ms", "wait p99", "hold ms", "hold p99");
+
+    for (int l = 0; l < LOCK_CLASS_COUNT; l++)
+    {
+        LockCounters c;
+        merge_class(l, &c);
+        if (c.acquisitions == 0)
+            continue;
+
+        fprintf(out, "%-11s %10lu %10lu %12.2f %8.2fus %12.2f %8.2fus\n", LOCK_NAMES[l],
+                c.acquisitions, c.contended,
+                c.wait.sum_ns / 1e6, bucket_percentile_us(&c.wait, 99),
+                c.hold.sum_ns / 1e6, bucket_percentile_us(&c.hold, 99));
+    }
+}
+
+static void write_histogram(FILE *out, const char *name, const char *lock, const LockHistogram *h)
+{
+    unsigned long count = histogram_count(h);
+    unsigned long cumulative = 0;
+    for (size_t b = 0; b < LOCK_BUCKET_COUNT - 1; b++)
+    {
+        cumulative += h->buckets[b];
+        fprintf(out, "%s_bucket{lock=\"%s\",le=\"%g\"} %lu\n", name, lock, LOCK_BOUNDS_NS[b] / 1e9, cumulative);
+    }
+    fprintf(out, "%s_bucket{lock=\"%s\",le=\"+Inf\"} %lu\n", name, lock, count);
+    fprintf(out, "%s_sum{lock=\"%s\"} %.9f\n%s_count{lock=\"%s\"} %lu\n",
+            name, lock, h->sum_ns / 1e9, name, lock, count);
+}
+
+void lockstat_write_prometheus(FILE *out)
+{
+    if (!lockstat_is_collecting())
+        return;
+
+    LockCounters merged[LOCK_CLASS_COUNT];
+    for (int l = 0; l < LOCK_CLASS_COUNT; l++)
+        merge_class(l, &merged[l]);
+
+    fprintf(out, "# HELP crawler_lock_acquisitions_total Lock acquisitions\n"
+                 "# TYPE crawler_lock_acquisitions_total counter\n");
+    for (int l = 0; l < LOCK_CLASS_COUNT; l++)
+        fprintf(out, "crawler_lock_acquisitions_total{lock=\"%s\"} %lu\n", LOCK_NAMES[l], merged[l].acquisitions);
+
+    fprintf(out, "# HELP crawler_lock_contended_total Acquisitions that had to wait\n"
+                 "# TYPE crawler_lock_contended_total counter\n");
+    for (int l = 0; l < LOCK_CLASS_COUNT; l++)
+        fprintf(out, "crawler_lock_contended_total{lock=\"%s\"} %lu\n", LOCK_NAMES[l], merged[l].contended);
+
+    fprintf(out, "# HELP crawler_lock_wait_seconds Time blocked acquiring the lock\n"
+                 "# TYPE crawler_lock_wait_seconds histogram\n");
+    for (int l = 0; l < LOCK_CLASS_COUNT; l++)
+        write_histogram(out, "crawler_lock_wait_seconds", LOCK_NAMES[l], &merged[l].wait);
+
+    fprintf(out, "# HELP crawler_lock_hold_seconds Time the lock was held\n"
+                 "# TYPE crawler_lock_hold_seconds histogram\n");
+    for (int l = 0; l < LOCK_CLASS_COUNT; l++)
+        write_histogram(out, "crawler_lock_hold_seconds", LOCK_NAMES[l], &merged[l].hold);
+}
@@ -0,0 +1,202 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "../include/config.h"
+#include "../include/log.h"
+
+// Bounded multi-producer, single-consumer ring. Each slot's sequence number
+// says whose turn it is: producers claim a slot by advancing enqueue_pos
+// with a CAS, fill it and publish it by bumping the sequence; the writer
+// thread consumes in order and hands the slot back one lap later.
+typedef struct
+{
+    unsigned long seq;
+    unsigned int len;
+    char text[LOG_LINE_LENGTH];
+} LogSlot;
+
+#define RING_MASK (LOG_RING_SIZE - 1)
+
+#if (LOG_RING_SIZE & RING_MASK) != 0
+#error "LOG_RING_SIZE must be a power of two"
+#endif
+
+static LogSlot ring[LOG_RING_SIZE];
+static unsigned long enqueue_pos = 0;
+static unsigned long dequeue_pos = 0; // Writer thread only
+static unsigned long dropped = 0;
+static int max_level = LOG_LEVEL;
+static int running = 0;
+static int stopping = 0;
+static pthread_t writer_thread;
+
+// Messages are formatted here, off the ring, so a slot is held only for the copy
+static __thread char line[LOG_LINE_LENGTH];
+
+static void sleep_ms(long ms)
+{
+    struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+static int ring_push(const char *text, unsigned int len)
+{
+    unsigned long pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+    LogSlot *slot;
+
+    for (;;)
+    {
+        slot = &ring[pos & RING_MASK];
+        long diff = (long)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n(&enqueue_pos, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if (diff < 0)
+        {
+            return 0; // Full: the writer has not freed this slot yet
+        }
+        else
+        {
+            pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    memcpy(slot->text, text, len);
+    slot->len = len;
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// Move every published message into one buffer and write it with a single
+// fwrite. Returns the number of messages written.
+static int drain(void)
+{
+    static char batch[LOG_BATCH_SIZE];
+    size_t used = 0;
+    int count = 0;
+
+    for (;;)
+    {
+        LogSlot *slot = &ring[dequeue_pos & RING_MASK];
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != dequeue_pos + 1)
+            break;
+
+        if (used + slot->len > sizeof(batch))
+        {
+            fwrite(batch, 1, used, stdout);
+            used = 0;
+        }
+        memcpy(batch + used, slot->text, slot->len);
+        used += slot->len;
+
+        __atomic_store_n(&slot->seq, dequeue_pos + LOG_RING_SIZE, __ATOMIC_RELEASE);
+        dequeue_pos++;
+        count++;
+    }
+
+    if (used > 0)
+    {
+        fwrite(batch, 1, used, stdout);
+        fflush(stdout);
+    }
+    return count;
+}
+
+static void *writer(void *arg)
+{
+    (void)arg;
+    unsigned long reported_drops = 0;
+
+    for (;;)
+    {
+        int written = drain();
+
+        unsigned long drops = __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+        if (drops != reported_drops)
+        {
+            fprintf(stdout, "[log] %lu messages dropped (ring full)\n", drops - reported_drops);
+            fflush(stdout);
+            reported_drops = drops;
+        }
+
+        if (written == 0)
+        {
+            if (__atomic_load_n(&stopping, __ATOMIC_ACQUIRE))
+                break;
+            sleep_ms(LOG_FLUSH_INTERVAL_MS);
+        }
+    }
+    return NULL;
+}
+
+int log_init(LogLevel level)
+{
+    max_level = level;
+
+    for (unsigned long i = 0; i < LOG_RING_SIZE; i++)
+        ring[i].seq = i;
+    enqueue_pos = dequeue_pos = 0;
+    stopping = 0;
+
+    if (pthread_create(&writer_thread, NULL, writer, NULL) != 0)
+    {
+        fprintf(stderr, "Failed to start log writer; logging synchronously\n");
+        return 0;
+    }
+    __atomic_store_n(&running, 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+void log_shutdown(void)
+{
+    if (!__atomic_load_n(&running, __ATOMIC_ACQUIRE))
+        return;
+
+    // New messages go straight to stdout; the writer drains the rest
+    __atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&stopping, 1, __ATOMIC_RELEASE);
+    pthread_join(writer_thread, NULL);
+}
+
+void log_message(LogLevel level, const char *format, ...)
+{
+    if ((int)level > max_level)
+        return;
+
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    if (len < 0)
+        return;
+    if ((size_t)len >= sizeof(line))
+    {
+        // Truncated: keep the line break so the next message starts cleanly
+        len = sizeof(line) - 1;
+        line[len - 1] = '\n';
+    }
+
+    if (!__atomic_load_n(&running, __ATOMIC_ACQUIRE))
+    {
+        fwrite(line, 1, len, stdout);
+        fflush(stdout);
+        return;
+    }
+
+    if (!ring_push(line, (unsigned int)len))
+        __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+}
+
+unsigned long log_dropped(void)
+{
+    return __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,1004 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "../include/storage.h"
+#include "../include/metrics.h"
+#include "../include/lockstat.h"
+
+/* Log-structured storage backend
+ *
+ * Every mutation is appended to one of four logs in LOG_STORE_DIR. The index
+ * of (session, url) entries and per-session counters live in memory and are
+ * rebuilt by replaying the logs on start. A torn record at the end of a log
+ * (from a crash mid-write) is truncated away during replay.
+ *
+ * On shutdown the index is also written to an index snapshot together with
+ * the log lengths it covers. The next start maps the snapshot and replays
+ * only the records appended after it; a missing or unusable snapshot means
+ * a full replay.
+ */
+
+enum
+{
+    REC_SESSION_START = 1,
+    REC_SESSION_END,
+    REC_PAGE,
+    REC_ENQUEUE,
+    REC_STATUS,
+    REC_LINK
+};
+
+enum
+{
+    LOG_SESSIONS,
+    LOG_PAGES,
+    LOG_QUEUE,
+    LOG_LINKS,
+    LOG_COUNT
+};
+
+static const char *LOG_FILE_NAMES[LOG_COUNT] = {"sessions.log", "pages.log", "queue.log", "links.log"};
+
+#define INDEX_SNAPSHOT_FILE "index.snapshot"
+#define INDEX_SNAPSHOT_MAGIC "LOGIDX01"
+
+// On-disk record header, followed by key_len bytes of key and data_len bytes of data
+typedef struct
+{
+    uint32_t type;
+    int32_t session_id;
+    int32_t value; // depth, or queue status for REC_STATUS
+    int32_t code;  // HTTP response code for REC_PAGE
+    int64_t time;
+    uint32_t key_len;
+    uint32_t data_len;
+} LogRecord;
+
+// Queue state of an index entry
+enum
+{
+    ENTRY_UNQUEUED = -1,
+    ENTRY_PENDING = -2
+    // Non-negative values are URLStatus
+};
+
+// Index snapshot layout: a SnapshotHeader, session_count sessions (each a
+// SnapshotSession and its start URL), then entry_count entries (each a
+// SnapshotEntry and its URL). Records are unaligned in the file.
+typedef struct
+{
+    char magic[8];
+    int64_t log_sizes[LOG_COUNT]; // Log lengths the snapshot accounts for
+    uint64_t next_seq;
+    uint64_t entry_count;
+    uint32_t session_count;
+} SnapshotHeader;
+
+typedef struct
+{
+    int32_t id;
+    int32_t running;
+    int64_t start_time;
+    int32_t pages;
+    int32_t links;
+    int32_t errors;
+    int32_t skipped;
+    uint32_t url_len;
+} SnapshotSession;
+
+typedef struct
+{
+    int32_t session_id;
+    int32_t depth;
+    int32_t status;
+    int32_t visited;
+    uint64_t seq;
+    int64_t page_offset;
+    uint32_t url_len;
+} SnapshotEntry;
+
+typedef struct LogEntry
+{
+    struct LogEntry *next;
+    int session_id;
+    int depth;
+    int status;
+    int visited;
+    uint64_t seq;
+    long page_offset;
+    char url[];
+} LogEntry;
+
+typedef struct
+{
+    int id;
+    char *start_url;
+    time_t start_time;
+    int running;
+    int pages;
+    int links; // URLs queued
+    int errors;
+    int skipped;
+} LogSession;
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    FILE *logs[LOG_COUNT];
+
+    LogEntry **buckets;
+    size_t bucket_count;
+    size_t entry_count;
+    uint64_t next_seq;
+
+    LogSession *sessions;
+    int session_count;
+
+    // Min-heap of the current session's pending entries, ordered by (depth, seq)
+    LogEntry **heap;
+    size_t heap_size;
+    size_t heap_capacity;
+    int heap_session;
+} LogStore;
+
+static LogStore store = {.lock = PTHREAD_MUTEX_INITIALIZER, .heap_session = -1};
+
+static uint32_t entry_hash(int session_id, const char *url)
+{
+    uint32_t hash = 2166136261u ^ (uint32_t)session_id;
+    for (const char *p = url; *p; p++)
+    {
+        hash ^= (unsigned char)*p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void index_grow(void)
+{
+    size_t new_count = store.bucket_count ? store.bucket_count * 2 : HASH_SIZE;
+    LogEntry **new_buckets = calloc(new_count, sizeof(LogEntry *));
+    if (!new_buckets)
+        return;
+
+    for (size_t i = 0; i < store.bucket_count; i++)
+    {
+        LogEntry *entry = store.buckets[i];
+        while (entry)
+        {
+            LogEntry *next = entry->next;
+            size_t slot = entry_hash(entry->session_id, entry->url) % new_count;
+            entry->next = new_buckets[slot];
+            new_buckets[slot] = entry;
+            entry = next;
+        }
+    }
+
+    free(store.buckets);
+    store.buckets = new_buckets;
+    store.bucket_count = new_count;
+}
+
+// Find the entry for (session_id, url), creating it if create is set
+static LogEntry *index_lookup(int session_id, const char *url, int create)
+{
+    if (store.bucket_count == 0 || (create && store.entry_count >= store.bucket_count))
+        index_grow();
+    if (store.bucket_count == 0)
+        return NULL;
+
+    size_t slot = entry_hash(session_id, url) % store.bucket_count;
+    for (LogEntry *entry = store.buckets[slot]; entry; entry = entry->next)
+    {
+        if (entry->session_id == session_id && strcmp(entry->url, url) == 0)
+            return entry;
+    }
+
+    if (!create)
+        return NULL;
+
+    size_t len = strlen(url);
+    LogEntry *entry = calloc(1, sizeof(LogEntry) + len + 1);
+    if (!entry)
+        return NULL;
+
+    memcpy(entry->url, url, len + 1);
+    entry->session_id = session_id;
+    entry->status = ENTRY_UNQUEUED;
+    entry->page_offset = -1;
+    entry->next = store.buckets[slot];
+    store.buckets[slot] = entry;
+    store.entry_count++;
+    return entry;
+}
+
+static LogSession *find_session(int session_id)
+{
+    for (int i = 0; i < store.session_count; i++)
+    {
+        if (store.sessions[i].id == session_id)
+            return &store.sessions[i];
+    }
+    return NULL;
+}
+
+// Move an entry to a new queue status, keeping the session counters in step
+static void entry_set_status(LogEntry *entry, int status)
+{
+    LogSession *session = find_session(entry->session_id);
+    if (session)
+    {
+        session->errors -= entry->status == URL_ERROR;
+        session->skipped -= entry->status == URL_SKIPPED;
+        session->errors += status == URL_ERROR;
+        session->skipped += status == URL_SKIPPED;
+    }
+    entry->status = status;
+}
+
+static int entry_before(const LogEntry *a, const LogEntry *b)
+{
+    return a->depth != b->depth ? a->depth < b->depth : a->seq < b->seq;
+}
+
+// Returns 0 if the heap cannot grow; the caller then leaves the entry
+// unqueued, so a later enqueue of the URL can retry
+static int heap_push(LogEntry *entry)
+{
+    if (store.heap_size == store.heap_capacity)
+    {
+        size_t new_capacity = store.heap_capacity ? store.heap_capacity * 2 : 1024;
+        LogEntry **ptr = realloc(store.heap, new_capacity * sizeof(LogEntry *));
+        if (!ptr)
+        {
+            fprintf(stderr, "Out of memory growing the frontier; not queueing %s\n", entry->url);
+            return 0;
+        }
+        store.heap = ptr;
+        store.heap_capacity = new_capacity;
+    }
+
+    size_t i = store.heap_size++;
+    while (i > 0 && entry_before(entry, store.heap[(i - 1) / 2]))
+    {
+        store.heap[i] = store.heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    store.heap[i] = entry;
+    return 1;
+}
+
+static LogEntry *heap_pop(void)
+{
+    if (store.heap_size == 0)
+        return NULL;
+
+    LogEntry *top = store.heap[0];
+    LogEntry *last = store.heap[--store.heap_size];
+
+    size_t i = 0;
+    for (;;)
+    {
+        size_t child = 2 * i + 1;
+        if (child >= store.heap_size)
+            break;
+        if (child + 1 < store.heap_size && entry_before(store.heap[child + 1], store.heap[child]))
+            child++;
+        if (!entry_before(store.heap[child], last))
+            break;
+        store.heap[i] = store.heap[child];
+        i = child;
+    }
+    if (store.heap_size > 0)
+        store.heap[i] = last;
+
+    return top;
+}
+
+// (Re)build the pending heap when the current session changes
+static void ensure_session_heap(void)
+{
+    if (store.heap_session == stats.session_id)
+        return;
+
+    store.heap_size = 0;
+    store.heap_session = stats.session_id;
+
+    for (size_t i = 0; i < store.bucket_count; i++)
+    {
+        for (LogEntry *entry = store.buckets[i]; entry; entry = entry->next)
+        {
+            if (entry->session_id == stats.session_id && entry->status == ENTRY_PENDING &&
+                !heap_push(entry))
+                entry_set_status(entry, ENTRY_UNQUEUED);
+        }
+    }
+}
+
+// Append one record; returns its offset in the log or -1 on failure
+static long append_record(int log, uint32_t type, int session_id, int value, int code,
+                          const char *key, size_t key_len, const char *data, size_t data_len)
+{
+    FILE *f = store.logs[log];
+    LogRecord rec = {type, session_id, value, code, (int64_t)time(NULL), (uint32_t)key_len, (uint32_t)data_len};
+
+    fseek(f, 0, SEEK_END);
+    long offset = ftell(f);
+
+    if (fwrite(&rec, sizeof(rec), 1, f) != 1 ||
+        (key_len && fwrite(key, 1, key_len, f) != key_len) ||
+        (data_len && fwrite(data, 1, data_len, f) != data_len))
+    {
+        fprintf(stderr, "Failed to append to %s\n", LOG_FILE_NAMES[log]);
+        return -1;
+    }
+
+    return offset;
+}
+
+static void apply_record(const LogRecord *rec, const char *key, long offset)
+{
+    LogSession *session;
+    LogEntry *entry;
+
+    switch (rec->type)
+    {
+    case REC_SESSION_START:
+    {
+        LogSession *ptr = realloc(store.sessions, (store.session_count + 1) * sizeof(LogSession));
+        if (!ptr)
+            return;
+        store.sessions = ptr;
+        session = &store.sessions[store.session_count++];
+        memset(session, 0, sizeof(*session));
+        session->id = rec->session_id;
+        session->start_url = strdup(key);
+        session->start_time = (time_t)rec->time;
+        session->running = 1;
+        break;
+    }
+    case REC_SESSION_END:
+        session = find_session(rec->session_id);
+        if (session)
+            session->running = 0;
+        break;
+    case REC_PAGE:
+        entry = index_lookup(rec->session_id, key, 1);
+        session = find_session(rec->session_id);
+        if (entry && !entry->visited && session)
+            session->pages++;
+        if (entry)
+        {
+            entry->visited = 1;
+            entry->page_offset = offset;
+        }
+        break;
+    case REC_ENQUEUE:
+        entry = index_lookup(rec->session_id, key, 1);
+        if (entry && entry->status == ENTRY_UNQUEUED)
+        {
+            entry->depth = rec->value;
+            entry->seq = store.next_seq++;
+            if (rec->session_id == store.heap_session && !heap_push(entry))
+                break;
+            entry->status = ENTRY_PENDING;
+
+            session = find_session(rec->session_id);
+            if (session)
+                session->links++;
+        }
+        break;
+    case REC_STATUS:
+        entry = index_lookup(rec->session_id, key, 0);
+        if (entry && rec->value == URL_PENDING)
+        {
+            // Returned unfetched; back into the frontier at its old place
+            int queued = rec->session_id != store.heap_session || heap_push(entry);
+            entry_set_status(entry, queued ? ENTRY_PENDING : ENTRY_UNQUEUED);
+        }
+        else if (entry)
+            entry_set_status(entry, rec->value);
+        break;
+    case REC_LINK:
+        break;
+    }
+}
+
+// Replay one log into the in-memory index from offset start, truncating a
+// torn tail record
+static int replay_log(int log, const char *path, long start)
+{
+    FILE *f = store.logs[log];
+    char *key = NULL;
+    size_t key_capacity = 0;
+    long good_end = start;
+    LogRecord rec;
+
+    fseek(f, start, SEEK_SET);
+    while (fread(&rec, sizeof(rec), 1, f) == 1)
+    {
+        if (rec.key_len >= MAX_PAGE_SIZE || rec.data_len > MAX_PAGE_SIZE)
+            break;
+
+        if (rec.key_len + 1 > key_capacity)
+        {
+            char *ptr = realloc(key, rec.key_len + 1);
+            if (!ptr)
+                break;
+            key = ptr;
+            key_capacity = rec.key_len + 1;
+        }
+
+        if (fread(key, 1, rec.key_len, f) != rec.key_len ||
+            fseek(f, rec.data_len, SEEK_CUR) != 0)
+            break;
+        key[rec.key_len] = '\0';
+
+        // fseek can move past EOF; make sure the data really is there
+        long end = ftell(f);
+        fseek(f, 0, SEEK_END);
+        if (ftell(f) < end)
+            break;
+        fseek(f, end, SEEK_SET);
+
+        apply_record(&rec, key, good_end);
+        good_end = end;
+    }
+    free(key);
+
+    fseek(f, 0, SEEK_END);
+    if (ftell(f) != good_end)
+    {
+        fprintf(stderr, "Truncating torn record at offset %ld in %s\n", good_end, path);
+        fflush(f);
+        if (truncate(path, good_end) != 0)
+            return 0;
+    }
+    return 1;
+}
+
+// Drop the in-memory index and sessions
+static void free_index(void)
+{
+    for (size_t i = 0; i < store.bucket_count; i++)
+    {
+        LogEntry *entry = store.buckets[i];
+        while (entry)
+        {
+            LogEntry *next = entry->next;
+            free(entry);
+            entry = next;
+        }
+    }
+    free(store.buckets);
+    store.buckets = NULL;
+    store.bucket_count = 0;
+    store.entry_count = 0;
+
+    for (int i = 0; i < store.session_count; i++)
+        free(store.sessions[i].start_url);
+    free(store.sessions);
+    store.sessions = NULL;
+    store.session_count = 0;
+
+    free(store.heap);
+    store.heap = NULL;
+    store.heap_size = store.heap_capacity = 0;
+    store.heap_session = -1;
+    store.next_seq = 0;
+}
+
+static void snapshot_path(char *path, size_t size)
+{
+    snprintf(path, size, "%s/%s", LOG_STORE_DIR, INDEX_SNAPSHOT_FILE);
+}
+
+// Load the index snapshot if it matches the open logs, filling offsets with
+// the log lengths it covers. Returns 0, with the index left empty, otherwise.
+static int load_index_snapshot(long offsets[LOG_COUNT])
+{
+    char path[512];
+    snapshot_path(path, sizeof(path));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(SnapshotHeader))
+    {
+        close(fd);
+        return 0;
+    }
+    const char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return 0;
+
+    const char *pos = map;
+    const char *end = map + st.st_size;
+    SnapshotHeader header;
+    memcpy(&header, pos, sizeof(header));
+    pos += sizeof(header);
+
+    // A log shorter than the snapshot says was truncated or replaced
+    int ok = memcmp(header.magic, INDEX_SNAPSHOT_MAGIC, sizeof(header.magic)) == 0;
+    for (int i = 0; i < LOG_COUNT && ok; i++)
+    {
+        fseek(store.logs[i], 0, SEEK_END);
+        ok = header.log_sizes[i] >= 0 && ftell(store.logs[i]) >= header.log_sizes[i];
+    }
+
+    store.sessions = ok ? calloc(header.session_count ? header.session_count : 1, sizeof(LogSession)) : NULL;
+    ok = ok && store.sessions;
+    for (uint32_t i = 0; i < header.session_count && ok; i++)
+    {
+        SnapshotSession s;
+        ok = (size_t)(end - pos) >= sizeof(s);
+        if (ok)
+        {
+            memcpy(&s, pos, sizeof(s));
+            pos += sizeof(s);
+            ok = (size_t)(end - pos) >= s.url_len;
+        }
+        char *start_url = ok ? malloc(s.url_len + 1) : NULL;
+        if (!start_url)
+        {
+            ok = 0;
+            break;
+        }
+        memcpy(start_url, pos, s.url_len);
+        start_url[s.url_len] = '\0';
+        pos += s.url_len;
+
+        LogSession *session = &store.sessions[store.session_count++];
+        session->id = s.id;
+        session->start_url = start_url;
+        session->start_time = (time_t)s.start_time;
+        session->running = s.running;
+        session->pages = s.pages;
+        session->links = s.links;
+        session->errors = s.errors;
+        session->skipped = s.skipped;
+    }
+
+    // Size the buckets once instead of doubling through every load factor
+    while (ok && store.bucket_count < header.entry_count)
+    {
+        size_t before = store.bucket_count;
+        index_grow();
+        ok = store.bucket_count > before;
+    }
+
+    char url[MAX_URL_LENGTH];
+    for (uint64_t i = 0; i < header.entry_count && ok; i++)
+    {
+        SnapshotEntry e;
+        ok = (size_t)(end - pos) >= sizeof(e);
+        if (ok)
+        {
+            memcpy(&e, pos, sizeof(e));
+            pos += sizeof(e);
+            ok = e.url_len < sizeof(url) && (size_t)(end - pos) >= e.url_len;
+        }
+        if (!ok)
+            break;
+        memcpy(url, pos, e.url_len);
+        url[e.url_len] = '\0';
+        pos += e.url_len;
+
+        LogEntry *entry = index_lookup(e.session_id, url, 1);
+        if (!entry)
+        {
+            ok = 0;
+            break;
+        }
+        entry->depth = e.depth;
+        entry->status = e.status;
+        entry->visited = e.visited;
+        entry->seq = e.seq;
+        entry->page_offset = (long)e.page_offset;
+    }
+    munmap((void *)map, st.st_size);
+
+    if (!ok)
+    {
+        fprintf(stderr, "Ignoring unusable %s; replaying the logs in full\n", path);
+        free_index();
+        return 0;
+    }
+
+    store.next_seq = header.next_seq;
+    for (int i = 0; i < LOG_COUNT; i++)
+        offsets[i] = (long)header.log_sizes[i];
+    printf("Loaded log index snapshot: %llu URLs in %u sessions\n",
+           (unsigned long long)header.entry_count, header.session_count);
+    return 1;
+}
+
+// Write the index and the log lengths it covers. Goes through a temporary
+// file and a rename, so a crash leaves the previous snapshot intact.
+static void write_index_snapshot(void)
+{
+    char path[512], tmp[520];
+    snapshot_path(path, sizeof(path));
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    SnapshotHeader header = {0};
+    memcpy(header.magic, INDEX_SNAPSHOT_MAGIC, sizeof(header.magic));
+    for (int i = 0; i < LOG_COUNT; i++)
+    {
+        if (fflush(store.logs[i]) != 0)
+            return;
+        fseek(store.logs[i], 0, SEEK_END);
+        header.log_sizes[i] = ftell(store.logs[i]);
+    }
+    header.next_seq = store.next_seq;
+    header.entry_count = store.entry_count;
+    header.session_count = (uint32_t)store.session_count;
+
+    FILE *f = fopen(tmp, "wb");
+    if (!f)
+    {
+        perror("Failed to write log index snapshot");
+        return;
+    }
+    fwrite(&header, sizeof(header), 1, f);
+
+    for (int i = 0; i < store.session_count; i++)
+    {
+        const LogSession *session = &store.sessions[i];
+        SnapshotSession s = {session->id, session->running, (int64_t)session->start_time,
+                             session->pages, session->links, session->errors, session->skipped,
+                             (uint32_t)strlen(session->start_url)};
+        fwrite(&s, sizeof(s), 1, f);
+        fwrite(session->start_url, 1, s.url_len, f);
+    }
+
+    for (size_t i = 0; i < store.bucket_count; i++)
+    {
+        for (const LogEntry *entry = store.buckets[i]; entry; entry = entry->next)
+        {
+            SnapshotEntry e = {entry->session_id, entry->depth, entry->status, entry->visited,
+                               entry->seq, (int64_t)entry->page_offset, (uint32_t)strlen(entry->url)};
+            fwrite(&e, sizeof(e), 1, f);
+            fwrite(entry->url, 1, e.url_len, f);
+        }
+    }
+
+    int ok = !ferror(f);
+    if (fclose(f) != 0 || !ok || rename(tmp, path) != 0)
+    {
+        fprintf(stderr, "Failed to write %s\n", path);
+        remove(tmp);
+    }
+}
+
+static int log_init(void)
+{
+    struct stat st = {0};
+    if (stat(LOG_STORE_DIR, &st) == -1 && mkdir(LOG_STORE_DIR, 0755) == -1)
+    {
+        perror("Failed to create log store directory");
+        return 0;
+    }
+
+    char paths[LOG_COUNT][512];
+    for (int i = 0; i < LOG_COUNT; i++)
+    {
+        snprintf(paths[i], sizeof(paths[i]), "%s/%s", LOG_STORE_DIR, LOG_FILE_NAMES[i]);
+
+        store.logs[i] = fopen(paths[i], "a+b");
+        if (!store.logs[i])
+        {
+            perror("Failed to open log");
+            return 0;
+        }
+    }
+
+    long offsets[LOG_COUNT] = {0};
+    load_index_snapshot(offsets);
+
+    // Sessions first, so later logs can find their counters
+    for (int i = 0; i < LOG_COUNT; i++)
+    {
+        if (!replay_log(i, paths[i], offsets[i]))
+        {
+            fprintf(stderr, "Failed to replay %s\n", paths[i]);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static void log_cleanup(int completed)
+{
+    lock_acquire(&store.lock, LOCK_LOG_STORE);
+
+    LogSession *session = find_session(stats.session_id);
+    if (completed && session && store.logs[LOG_SESSIONS])
+    {
+        append_record(LOG_SESSIONS, REC_SESSION_END, stats.session_id, 0, 0, NULL, 0, NULL, 0);
+        session->running = 0;
+    }
+
+    if (store.logs[0])
+        write_index_snapshot();
+
+    for (int i = 0; i < LOG_COUNT; i++)
+    {
+        if (store.logs[i])
+            fclose(store.logs[i]);
+        store.logs[i] = NULL;
+    }
+
+    free_index();
+
+    lock_release(&store.lock, LOCK_LOG_STORE);
+}
+
+static int log_create_session(const char *start_url)
+{
+    lock_acquire(&store.lock, LOCK_LOG_STORE);
+
+    int session_id = 1;
+    for (int i = 0; i < store.session_count; i++)
+    {
+        if (store.sessions[i].id >= session_id)
+            session_id = store.sessions[i].id + 1;
+    }
+
+    LogRecord rec = {REC_SESSION_START, session_id, 0, 0, (int64_t)time(NULL), 0, 0};
+    if (append_record(LOG_SESSIONS, REC_SESSION_START, session_id, 0, 0,
+                      start_url, strlen(start_url), NULL, 0) < 0)
+    {
+        lock_release(&store.lock, LOCK_LOG_STORE);
+        return -1;
+    }
+    fflush(store.logs[LOG_SESSIONS]);
+    apply_record(&rec, start_url, 0);
+
+    lock_release(&store.lock, LOCK_LOG_STORE);
+    return session_id;
+}
+
+static int log_resume_session(void)
+{
+    lock_acquire(&store.lock, LOCK_LOG_STORE);
+
+    int session_id = -1;
+    for (int i = 0; i < store.session_count; i++)
+    {
+        if (store.sessions[i].running && store.sessions[i].id > session_id)
+            session_id = store.sessions[i].id;
+    }
+
+    lock_release(&store.lock, LOCK_LOG_STORE);
+    return session_id;
+}
+
+static int log_get_session(int session_id, char *start_url, size_t url_size, time_t *start_time)
+{
+    lock_acquire(&store.lock, LOCK_LOG_STORE);
+
+    LogSession *session = find_session(session_id);
+    int found = session && session->running;
+    if (found)
+    {
+        snprintf(start_url, url_size, "%s", session->start_url);
+        *start_time = session->start_time;
+    }
+
+    lock_release(&store.lock, LOCK_LOG_STORE);
+    return found;
+}
+
+static void log_print_resume_info(void)
+{
+    lock_acquire(&store.lock, LOCK_LOG_STORE);
+
+    printf("\n=== Available Sessions to Resume ===\n");
+    int found_sessions = 0;
+
+    for (int i = store.session_count - 1; i >= 0; i--)
+    {
+        LogSession *session = &store.sessions[i];
+        if (!session->running)
+            continue;
+
+        found_sessions = 1;
+
+        size_t total_urls = 0;
+        for (size_t b = 0; b < store.bucket_count; b++)
+        {
+            for (LogEntry *entry = store.buckets[b]; entry; entry = entry->next)
+                total_urls += entry->session_id == session->id && entry->status != ENTRY_UNQUEUED;
+        }
+
+        char time_str[100];
+        strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", localtime(&session->start_time));
+
+        printf("Session %d: %s\n", session->id, session->start_url);
+        printf("  Started: %s\n", time_str);
+        printf("  Progress: %d pages crawled, %zu URLs in queue\n", session->pages, total_urls);
+        printf("\n");
+    }
+
+    if (!found_sessions)
+    {
+        printf("No active sessions found to resume.\n");
+    }
+
+    lock_release(&store.lock, LOCK_LOG_STORE);
+}
+
+static void log_save_page(const char *url, const char *content, size_t content_length,
+                          long response_code, int depth)
+{
+    lock_acquire(&store.lock, LOCK_LOG_STORE);
+
+    LogRecord rec = {REC_PAGE, stats.session_id, depth, (int32_t)response_code, (int64_t)time(NULL), 0, 0};
+    long offset = append_record(LOG_PAGES, REC_PAGE, stats.session_id, depth, (int)response_code,
+                                url, strlen(url), content, content_length);
+    if (offset >= 0)
+        apply_record(&rec, url, offset);
+
+    lock_release(&store.lock, LOCK_LOG_STORE);
+}
+
+static int log_enqueue(const char *url, int depth)
+{
+    lock_acquire(&store.lock, LOCK_LOG_STORE);
+    ensure_session_heap();
+
+    int added = 0;
+    LogEntry *entry = index_lookup(stats.session_id, url, 1);
+    if (entry && entry->status == ENTRY_UNQUEUED &&
+        append_record(LOG_QUEUE, REC_ENQUEUE, stats.session_id, depth, 0, url, strlen(url), NULL, 0) >= 0)
+    {
+        LogRecord rec = {REC_ENQUEUE, stats.session_id, depth, 0, 0, 0, 0};
+        apply_record(&rec, url, 0);
+        added = entry->status == ENTRY_PENDING;
+    }
+    if (added)
+    {
+        metrics_add(METRIC_LINKS_FOUND, 1);
+        metrics_gauge_add(GAUGE_QUEUE_DEPTH, 1);
+    }
+
+    lock_release(&store.lock, LOCK_LOG_STORE);
+    return added;
+}
+
+static int log_is_visited(const char *url)
+{
+    lock_acquire(&store.lock, LOCK_LOG_STORE);
+    LogEntry *entry = index_lookup(stats.session_id, url, 0);
+    int visited = entry && entry->visited;
+    lock_release(&store.lock, LOCK_LOG_STORE);
+    return visited;
+}
+
+static int log_dequeue_batch(QueuedURL *out, int max)
+{
+    lock_acquire(&store.lock, LOCK_LOG_STORE);
+    ensure_session_heap();
+
+    int claimed = 0;
+    LogEntry *entry;
+    while (claimed < max && (entry = heap_pop()) != NULL)
+    {
+        if (entry->status != ENTRY_PENDING)
+            continue;
+
+        append_record(LOG_QUEUE, REC_STATUS, entry->session_id, URL_CRAWLED, 0,
+                      entry->url, strlen(entry->url), NULL, 0);
+        entry_set_status(entry, URL_CRAWLED);
+        metrics_gauge_add(GAUGE_QUEUE_DEPTH, -1);
+
+        if (!entry->visited)
+        {
+            snprintf(out[claimed].url, MAX_URL_LENGTH, "%s", entry->url);
+            out[claimed].depth = entry->depth;
+            claimed++;
+        }
+    }
+
+    // The dispatcher calls this regularly, which bounds how much a crash can lose
+    for (int i = 0; i < LOG_COUNT; i++)
+        fflush(store.logs[i]);
+
+    lock_release(&store.lock, LOCK_LOG_STORE);
+    return claimed;
+}
+
+static int log_has_pending(void)
+{
+    lock_acquire(&store.lock, LOCK_LOG_STORE);
+    ensure_session_heap();
+
+    int pending = 0;
+    for (size_t i = 0; i < store.heap_size && !pending; i++)
+        pending = store.heap[i]->status == ENTRY_PENDING;
+
+    lock_release(&store.lock, LOCK_LOG_STORE);
+    return pending;
+}
+
+static void log_mark(const char *url, URLStatus status)
+{
+    lock_acquire(&store.lock, LOCK_LOG_STORE);
+
+    LogEntry *entry = index_lookup(stats.session_id, url, 0);
+    if (entry && append_record(LOG_QUEUE, REC_STATUS, stats.session_id, status, 0,
+                               url, strlen(url), NULL, 0) >= 0)
+    {
+        LogRecord rec = {REC_STATUS, stats.session_id, status, 0, 0, 0, 0};
+        apply_record(&rec, url, 0);
+        if (status == URL_PENDING && entry->status == ENTRY_PENDING)
+            metrics_gauge_add(GAUGE_QUEUE_DEPTH, 1);
+    }
+
+    lock_release(&store.lock, LOCK_LOG_STORE);
+}
+
+static void log_link_batch(const char *source_url, const char *const *target_urls, int count)
+{
+    lock_acquire(&store.lock, LOCK_LOG_STORE);
+
+    size_t source_len = strlen(source_url);
+    for (int i = 0; i < count; i++)
+    {
+        append_record(LOG_LINKS, REC_LINK, stats.session_id, 0, 0, source_url, source_len,
+                      target_urls[i], strlen(target_urls[i]));
+    }
+
+    lock_release(&store.lock, LOCK_LOG_STORE);
+}
+
+static void log_stats(CrawlerStats *out)
+{
+    lock_acquire(&store.lock, LOCK_LOG_STORE);
+    ensure_session_heap();
+
+    LogSession *session = find_session(stats.session_id);
+    if (session)
+    {
+        out->pages_crawled = session->pages;
+        out->links_found = session->links;
+        out->errors = session->errors;
+        out->skipped_urls = session->skipped;
+        for (size_t i = 0; i < store.heap_size; i++)
+            out->pending_urls += store.heap[i]->status == ENTRY_PENDING;
+    }
+
+    lock_release(&store.lock, LOCK_LOG_STORE);
+}
+
+const StorageBackend log_backend = {
+    .name = "log",
+    .init = log_init,
+    .cleanup = log_cleanup,
+    .create_session = log_create_session,
+    .resume_session = log_resume_session,
+    .get_session = log_get_session,
+    .print_resume_info = log_print_resume_info,
+    .save_page = log_save_page,
+    .enqueue = log_enqueue,
+    .is_visited = log_is_visited,
+    .dequeue_batch = log_dequeue_batch,
+    .has_pending = log_has_pending,
+    .mark = log_mark,
+    .link_batch = log_link_batch,
+    .stats = log_stats,
+};
@@ -0,0 +1,767 @@
+#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <curl/curl.h>
+#include <libxml/parser.h>
+#include "../include/config.h"
+#include "../include/crawler.h"
+#include "../include/dns.h"
+#include "../include/storage.h"
+#include "../include/metrics.h"
+#include "../include/lockstat.h"
+#include "../include/log.h"
+#include "../include/hosts.h"
+#include "../include/retry.h"
+#include "../include/sitemap.h"
+#include "../include/snapshot.h"
+#include "../include/threads.h"
+#include "../include/trace.h"
+
+ThreadPool *thread_pool = NULL;
+
+// Set by SIGINT or SIGTERM: stop dispatching, let fetches in flight finish,
+// return the URLs not yet fetched to the frontier and save a snapshot
+static volatile sig_atomic_t interrupted = 0;
+
+static void handle_interrupt(int sig)
+{
+    static const char message[] = "\nInterrupted; finishing fetches in flight (again to quit at once)\n";
+    (void)sig;
+    interrupted = 1;
+    ssize_t written = write(STDERR_FILENO, message, sizeof(message) - 1);
+    (void)written;
+}
+
+// The handler fires once; a second signal takes the default action
+static void install_interrupt_handler(void)
+{
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_interrupt;
+    action.sa_flags = SA_RESETHAND;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+}
+
+// A URL claimed for fetching
+typedef struct
+{
+    char *url;
+    int depth;
+    int attempt;
+    int host; // host_id of url; runs only join URLs of the same host
+} CrawlTask;
+
+// URLs of one host that one worker fetches back to back, so all but the
+// first reuse its connection. The run holds one of the host's concurrency
+// slots until it ends.
+typedef struct
+{
+    int count;
+    CrawlTask tasks[HOST_RUN_LENGTH];
+} CrawlRun;
+
+// Whether the URL's host circuit breaker lets it be fetched now. If not, the
+// URL waits in the retry queue, or fails once the host is given up.
+static int breaker_admits(const char *url, int depth, int attempt)
+{
+    long long retry_at = 0;
+
+    switch (host_breaker_allow(url, &retry_at))
+    {
+    case HOST_WAIT:
+        if (retry_defer(url, depth, attempt, retry_at))
+            return 0;
+        break; // Queue full; try it anyway
+    case HOST_DOWN:
+        log_info("Host down, not fetching %s\n", url);
+        metrics_add(METRIC_ERRORS, 1);
+        storage->mark(url, URL_ERROR);
+        return 0;
+    case HOST_AVAILABLE:
+        break;
+    }
+    return 1;
+}
+
+// Worker function for thread pool
+static void crawl_run_worker(void *arg)
+{
+    CrawlRun *run = (CrawlRun *)arg;
+    if (run)
+    {
+        for (int i = 0; i < run->count; i++)
+        {
+            CrawlTask *task = &run->tasks[i];
+
+            // Unfetched URLs go back to the frontier for --resume
+            if (interrupted)
+            {
+                storage->mark(task->url, URL_PENDING);
+                continue;
+            }
+
+            // The breaker may open while the run goes on
+            if (i > 0 && !breaker_admits(task->url, task->depth, task->attempt))
+                continue;
+
+            metrics_gauge_add(GAUGE_IN_FLIGHT, 1);
+            crawl_url(task->url, task->depth, task->attempt);
+            metrics_gauge_add(GAUGE_IN_FLIGHT, -1);
+        }
+
+        host_release_slot(run->tasks[0].url);
+        for (int i = 0; i < run->count; i++)
+            free(run->tasks[i].url);
+        free(run);
+    }
+}
+
+// A stored page handed to a worker during --replay
+typedef struct
+{
+    char *url;
+    char *content;
+    int depth;
+} ReplayTask;
+
+static int replay_in_flight = 0;
+static long replay_pages = 0;
+static long long replay_bytes = 0;
+
+static void replay_task_worker(void *arg)
+{
+    ReplayTask *task = (ReplayTask *)arg;
+    if (task)
+    {
+        extract_links(task->content, task->url, task->depth);
+        __atomic_sub_fetch(&replay_in_flight, 1, __ATOMIC_RELAXED);
+        free(task->url);
+        free(task->content);
+        free(task);
+    }
+}
+
+// Called by storage for each stored page; copies it into a worker task
+static void replay_page(const char *url, const char *content, size_t content_length, int depth, void *arg)
+{
+    (void)arg;
+
+    // Bound the copies held in memory while workers catch up
+    while (__atomic_load_n(&replay_in_flight, __ATOMIC_RELAXED) >= MAX_THREADS * 4)
+        usleep(1000);
+
+    ReplayTask *task = malloc(sizeof(ReplayTask));
+    if (!task)
+        return;
+    task->url = my_strdup(url);
+    task->content = malloc(content_length + 1);
+    task->depth = depth;
+    if (!task->url || !task->content)
+    {
+        free(task->url);
+        free(task->content);
+        free(task);
+        return;
+    }
+    memcpy(task->content, content, content_length);
+    task->content[content_length] = '\0';
+
+    replay_pages++;
+    replay_bytes += content_length;
+    __atomic_add_fetch(&replay_in_flight, 1, __ATOMIC_RELAXED);
+    thread_pool_add_work(thread_pool, replay_task_worker, task);
+}
+
+// Rebuild a session's link graph and frontier from its stored pages, offline
+static int run_replay(int session_id)
+{
+    if (!storage->replay_reset || !storage->for_each_page)
+    {
+        fprintf(stderr, "Error: the %s backend does not support --replay\n", storage->name);
+        return 0;
+    }
+
+    stats.session_id = session_id;
+    int reset = storage->replay_reset();
+    if (reset < 0)
+    {
+        fprintf(stderr, "Session %d not found\n", session_id);
+        return 0;
+    }
+    if (!reset)
+    {
+        fprintf(stderr, "Failed to reset links for session %d\n", session_id);
+        return 0;
+    }
+    load_session_stats();
+    long frontier_before = metrics_gauge_get(GAUGE_QUEUE_DEPTH);
+
+    xmlInitParser();
+    LIBXML_TEST_VERSION;
+
+    printf("Replaying stored pages of session %d with %d threads\n", session_id, MAX_THREADS);
+    log_init(LOG_LEVEL);
+
+    long long start = metrics_now_us();
+    int pages = storage->for_each_page(replay_page, NULL);
+    thread_pool_wait(thread_pool);
+    double elapsed = (metrics_now_us() - start) / 1e6;
+
+    log_shutdown();
+    xmlCleanupParser();
+
+    if (pages < 0)
+    {
+        fprintf(stderr, "Failed to read stored pages of session %d\n", session_id);
+        return 0;
+    }
+
+    double mb = replay_bytes / (1024.0 * 1024.0);
+    printf("\n=== Replay Statistics ===\n");
+    printf("Session ID: %d\n", session_id);
+    printf("Pages replayed: %ld\n", replay_pages);
+    printf("Content parsed: %.1f MB\n", mb);
+    printf("Links in frontier: %ld (%ld already pending)\n",
+           metrics_gauge_get(GAUGE_QUEUE_DEPTH), frontier_before);
+    printf("URLs skipped: %ld\n", metrics_get(METRIC_SKIPPED_URLS));
+    printf("Parse errors: %ld\n", metrics_get(METRIC_ERRORS));
+    printf("Time elapsed: %.2f seconds\n", elapsed);
+    if (elapsed > 0)
+        printf("Throughput: %.2f pages/second, %.2f MB/second\n", replay_pages / elapsed, mb / elapsed);
+    return 1;
+}
+
+// Performance monitoring function
+void print_performance_stats()
+{
+    static time_t last_check = 0;
+    static long last_pages_crawled = 0;
+    static time_t last_metrics_write = 0;
+
+    time_t current_time = time(NULL);
+
+    // Refresh the Prometheus textfile; reads only in-memory counters
+    if (METRICS_TEXTFILE && current_time - last_metrics_write >= METRICS_INTERVAL)
+    {
+        metrics_write_textfile(METRICS_TEXTFILE);
+        last_metrics_write = current_time;
+    }
+
+    if (current_time - last_check >= 60)
+    { // Print every 60 seconds
+        long current_pages = metrics_get(METRIC_PAGES_CRAWLED);
+
+        if (last_check > 0)
+        {
+            double rate = (double)(current_pages - last_pages_crawled) / (current_time - last_check);
+            log_info("Performance: %.2f pages/second (Total: %ld pages, %ld queued, %ld in flight)\n",
+                     rate, current_pages, metrics_gauge_get(GAUGE_QUEUE_DEPTH),
+                     metrics_gauge_get(GAUGE_IN_FLIGHT));
+        }
+
+        last_check = current_time;
+        last_pages_crawled = current_pages;
+    }
+}
+
+// Claimed URLs not yet handed to a worker, oldest first. They wait for a
+// free worker, or for their host to free a concurrency slot.
+static CrawlTask held[DISPATCH_HELD_MAX];
+static int held_count = 0;
+
+// Add a claimed URL to the held list. The main loop only claims URLs while
+// the list has room for them.
+static void hold_url(const char *url, int depth, int attempt)
+{
+    char *copy = my_strdup(url);
+    if (!copy)
+        return;
+    held[held_count].url = copy;
+    held[held_count].depth = depth;
+    held[held_count].attempt = attempt;
+    held[held_count].host = host_id(url);
+    held_count++;
+}
+
+// Hand held URLs to the thread pool as runs of one host's URLs, one run per
+// free slot. Runs are no longer than it takes to spread the held URLs over
+// the free slots, so a small frontier still keeps every worker busy. Returns
+// the number of URLs dispatched.
+static int dispatch_held(int free_slots)
+{
+    static int urls_processed = 0;
+    static char taken[DISPATCH_HELD_MAX]; // 1 = in a run, 2 = refused by the breaker
+    if (free_slots <= 0 || held_count == 0)
+        return 0;
+
+    int run_length = (held_count + free_slots - 1) / free_slots;
+    if (run_length > HOST_RUN_LENGTH)
+        run_length = HOST_RUN_LENGTH;
+    memset(taken, 0, held_count);
+
+    int dispatched = 0;
+    int runs = 0;
+    for (int i = 0; i < held_count && runs < free_slots; i++)
+    {
+        if (taken[i] || !host_acquire_slot(held[i].url))
+            continue;
+
+        CrawlRun *run = malloc(sizeof(CrawlRun));
+        if (!run)
+        {
+            host_release_slot(held[i].url);
+            break;
+        }
+        run->count = 0;
+
+        // The oldest URLs of the host, as many as its Crawl-delay allows
+        int length = host_run_length(held[i].url);
+        if (length > run_length)
+            length = run_length;
+        for (int j = i; j < held_count && run->count < length; j++)
+        {
+            if (taken[j] || held[j].host != held[i].host || (held[j].host < 0 && j != i))
+                continue;
+            if (!breaker_admits(held[j].url, held[j].depth, held[j].attempt))
+            {
+                taken[j] = 2;
+                continue;
+            }
+            taken[j] = 1;
+            run->tasks[run->count++] = held[j];
+            urls_processed++;
+            log_info("Added URL %d to queue: %s (depth %d%s)\n",
+                     urls_processed, held[j].url, held[j].depth, held[j].attempt > 0 ? ", retry" : "");
+        }
+
+        if (run->count == 0)
+        {
+            host_release_slot(held[i].url);
+            free(run);
+            continue;
+        }
+        dispatched += run->count;
+        runs++;
+        thread_pool_add_work(thread_pool, crawl_run_worker, run);
+    }
+
+    // URLs in a run now belong to it
+    int kept = 0;
+    for (int i = 0; i < held_count; i++)
+    {
+        if (taken[i] == 0)
+            held[kept++] = held[i];
+        else if (taken[i] == 2)
+            free(held[i].url);
+    }
+    held_count = kept;
+    return dispatched;
+}
+
+static void print_usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [options] <starting_url>\n", prog);
+    fprintf(stderr, "       %s [options] --resume [session_id]\n", prog);
+    fprintf(stderr, "       %s [options] --replay <session_id>\n", prog);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  --backend sqlite|log  Storage backend (default %s)\n", STORAGE_BACKEND);
+    fprintf(stderr, "  --continuous          Keep running and revisit pages as they come due\n");
+    fprintf(stderr, "  --sitemap <url>       Also queue the URLs of a sitemap or sitemap index (repeatable)\n");
+    fprintf(stderr, "  --truncate <KB>       Keep only the first KB of each page; enough for links\n");
+    fprintf(stderr, "  --max-depth <n>       Do not queue links more than n hops from the start (default %d)\n", MAX_DEPTH);
+    fprintf(stderr, "  --trace <file>        Write per-URL stage timings as Chrome trace JSON\n");
+    fprintf(stderr, "  --trace-summary       Print per-host latency percentiles at exit\n");
+    fprintf(stderr, "  --lock-stats          Record lock wait and hold times and report them\n");
+    fprintf(stderr, "Examples:\n");
+    fprintf(stderr, "  %s https://example.com\n", prog);
+    fprintf(stderr, "  %s --backend log https://example.com\n", prog);
+    fprintf(stderr, "  %s --resume\n", prog);
+    fprintf(stderr, "  %s --resume 5\n", prog);
+    fprintf(stderr, "  %s --continuous --resume\n", prog);
+    fprintf(stderr, "  %s --sitemap https://example.com/sitemap.xml.gz https://example.com\n", prog);
+    fprintf(stderr, "  %s --trace crawl.json https://example.com\n", prog);
+    fprintf(stderr, "  %s --replay 5\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    int resume_mode = 0;
+    int replay_session = 0;
+    int continuous = 0;
+    char *start_url = NULL;
+    const char *backend_name = STORAGE_BACKEND;
+    const char *trace_file = NULL;
+    int trace_summary = 0;
+    const char *sitemaps[16];
+    int sitemap_count = 0;
+
+    // Parse command line arguments
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--resume") == 0)
+        {
+            resume_mode = 1;
+            if (i + 1 < argc && argv[i + 1][0] != '-' && strstr(argv[i + 1], "://") == NULL)
+            {
+                stats.session_id = atoi(argv[++i]);
+            }
+        }
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+        {
+            replay_session = atoi(argv[++i]);
+            if (replay_session <= 0)
+            {
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc)
+        {
+            backend_name = argv[++i];
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+        {
+            trace_file = argv[++i];
+        }
+        else if (strcmp(argv[i], "--continuous") == 0)
+        {
+            continuous = 1;
+        }
+        else if (strcmp(argv[i], "--sitemap") == 0 && i + 1 < argc &&
+                 sitemap_count < (int)(sizeof(sitemaps) / sizeof(sitemaps[0])))
+        {
+            sitemaps[sitemap_count++] = argv[++i];
+        }
+        else if (strcmp(argv[i], "--truncate") == 0 && i + 1 < argc)
+        {
+            crawler_set_truncate_kb(atol(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--max-depth") == 0 && i + 1 < argc)
+        {
+            crawler_set_max_depth(atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--trace-summary") == 0)
+        {
+            trace_summary = 1;
+        }
+        else if (strcmp(argv[i], "--lock-stats") == 0)
+        {
+            lockstat_enable(LOCKSTAT_COLLECT);
+        }
+        else if (argv[i][0] != '-' && !start_url)
+        {
+            start_url = argv[i];
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (replay_session ? (resume_mode || start_url) : resume_mode == (start_url != NULL))
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (!storage_select(backend_name))
+    {
+        fprintf(stderr, "Error: unknown storage backend '%s'\n", backend_name);
+        return 1;
+    }
+
+    // Validate starting URL if not in resume mode
+    if (!resume_mode && start_url)
+    {
+        if (strncmp(start_url, "http://", 7) != 0 && strncmp(start_url, "https://", 8) != 0)
+        {
+            fprintf(stderr, "Error: URL must start with http:// or https://\n");
+            return 1;
+        }
+    }
+
+    if (continuous && !storage->schedule_revisits)
+    {
+        fprintf(stderr, "Error: the %s backend does not support --continuous\n", storage->name);
+        return 1;
+    }
+
+    if (trace_file || trace_summary)
+    {
+        trace_enable();
+    }
+
+    // Initialize storage
+    if (!storage->init())
+    {
+        fprintf(stderr, "Failed to initialize %s storage\n", storage->name);
+        return 1;
+    }
+
+    // Initialize thread pool
+    log_info("Creating thread pool with %d threads\n", MAX_THREADS);
+    thread_pool = thread_pool_create(MAX_THREADS);
+    if (!thread_pool)
+    {
+        fprintf(stderr, "Failed to create thread pool\n");
+        return 1;
+    }
+
+    // Replay stored pages instead of crawling; leaves the session status alone
+    if (replay_session)
+    {
+        int ok = run_replay(replay_session);
+        if (METRICS_TEXTFILE)
+            metrics_write_textfile(METRICS_TEXTFILE);
+        if (trace_summary)
+            trace_print_host_summary(stdout);
+        if (trace_file)
+            trace_write_chrome(trace_file);
+        lockstat_print_report(stdout);
+        thread_pool_destroy(thread_pool);
+        stats.session_id = 0;
+        storage->cleanup(0);
+        return ok ? 0 : 1;
+    }
+
+    // Handle resume mode
+    if (resume_mode)
+    {
+        if (stats.session_id == 0)
+        {
+            // Auto-resume latest session
+            stats.session_id = storage->resume_session();
+            if (stats.session_id == -1)
+            {
+                storage->print_resume_info();
+                storage->cleanup(0);
+                return 1;
+            }
+        }
+
+        // Verify session exists and is active
+        char session_url[MAX_URL_LENGTH];
+        if (!storage->get_session(stats.session_id, session_url, sizeof(session_url), &stats.start_time))
+        {
+            fprintf(stderr, "Session %d not found or not active\n", stats.session_id);
+            storage->print_resume_info();
+            storage->cleanup(0);
+            return 1;
+        }
+
+        start_url = my_strdup(session_url);
+        if (!start_url)
+        {
+            fprintf(stderr, "Failed to allocate memory for start URL\n");
+            storage->cleanup(0);
+            return 1;
+        }
+
+        load_session_stats();
+        snapshot_load(SNAPSHOT_FILE, stats.session_id);
+
+        printf("Resuming crawl session %d\n", stats.session_id);
+        printf("Original start URL: %s\n", start_url);
+    }
+    else
+    {
+        // Create new session
+        stats.session_id = storage->create_session(start_url);
+        if (stats.session_id == -1)
+        {
+            fprintf(stderr, "Failed to create crawl session\n");
+            storage->cleanup(0);
+            return 1;
+        }
+
+        stats.start_time = time(NULL);
+
+        // Add initial URL to queue
+        storage->enqueue(start_url, 0);
+
+        printf("Starting new crawl session %d\n", stats.session_id);
+    }
+
+    // Create pages directory if it doesn't exist
+    if (!create_pages_directory())
+    {
+        fprintf(stderr, "Failed to create pages directory. Continuing without saving pages.\n");
+    }
+
+    // Initialize libraries
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    xmlInitParser();
+    LIBXML_TEST_VERSION;
+
+    // Start/Resume crawling
+    printf("=====================================\n");
+    printf("Session ID: %d\n", stats.session_id);
+    printf("Start URL: %s\n", start_url);
+    printf("Max depth: %d\n", crawler_max_depth());
+    printf("Max URLs: %d\n", MAX_URLS);
+    printf("Delay between requests: %d seconds\n", DELAY_SECONDS);
+    printf("Storage: %s (%s)\n", storage->name, storage == &log_backend ? LOG_STORE_DIR : DB_NAME);
+    if (continuous)
+        printf("Continuous: revisits every %d to %d seconds by change rate\n",
+               REVISIT_MIN_INTERVAL, REVISIT_MAX_INTERVAL);
+    printf("=====================================\n\n");
+
+    // Workers log through the background writer from here on
+    log_init(LOG_LEVEL);
+    dns_init();
+    install_interrupt_handler();
+
+    // Sitemaps from the command line; robots.txt adds its own as hosts load
+    sitemap_init(thread_pool);
+    for (int i = 0; i < sitemap_count; i++)
+    {
+        if (!sitemap_submit(sitemaps[i], sitemaps[i]))
+            fprintf(stderr, "Ignoring sitemap %s\n", sitemaps[i]);
+    }
+
+    // Main crawling loop
+    QueuedURL batch[DEQUEUE_BATCH_SIZE];
+    RetryEntry retries[DEQUEUE_BATCH_SIZE];
+    time_t last_revisit_check = 0;
+
+    // Continuous mode runs until interrupted; --resume picks it up again
+    while (!interrupted && (continuous || metrics_get(METRIC_PAGES_CRAWLED) + metrics_get(METRIC_NOT_MODIFIED) < MAX_URLS))
+    {
+        // Put pages whose next visit is due back into the frontier
+        if (continuous && time(NULL) - last_revisit_check >= REVISIT_POLL_INTERVAL)
+        {
+            int due = storage->schedule_revisits(time(NULL), REVISIT_BATCH_SIZE);
+            if (due > 0)
+            {
+                metrics_add(METRIC_REVISITS, due);
+                log_info("Scheduled %d revisits\n", due);
+            }
+            last_revisit_check = time(NULL);
+        }
+
+        // Keep no more than MAX_THREADS runs queued or running, so URLs
+        // stay in the frontier until a worker can take them. Claim enough
+        // for a full run per free worker, less the held URLs that can
+        // start now. URLs of hosts at their limit look past them, up to
+        // DISPATCH_HELD_MAX held in all.
+        int free_slots = MAX_THREADS - (int)thread_pool_pending(thread_pool);
+        int startable = 0;
+        for (int i = 0; i < held_count; i++)
+            startable += host_slot_free(held[i].url);
+        int take = free_slots > 0 ? free_slots * HOST_RUN_LENGTH - startable : 0;
+        if (take > DEQUEUE_BATCH_SIZE)
+            take = DEQUEUE_BATCH_SIZE;
+        if (take > DISPATCH_HELD_MAX - held_count)
+            take = DISPATCH_HELD_MAX - held_count;
+        if (take < 0)
+            take = 0;
+
+        // Failed fetches whose backoff has passed go before new URLs
+        int retry_count = take > 0 ? retry_pop_due(retries, take, metrics_now_us()) : 0;
+
+        // Claim the next unvisited URLs; storage marks them crawled atomically
+        int batch_size = 0;
+        if (take > retry_count)
+        {
+            long long db_start = metrics_now_us();
+            batch_size = storage->dequeue_batch(batch, take - retry_count);
+            metrics_observe(HIST_DB, metrics_now_us() - db_start);
+        }
+
+        for (int i = 0; i < retry_count; i++)
+        {
+            hold_url(retries[i].url, retries[i].depth, retries[i].attempt);
+            free(retries[i].url);
+        }
+        for (int i = 0; i < batch_size; i++)
+            hold_url(batch[i].url, batch[i].depth, 0);
+
+        int dispatched = dispatch_held(free_slots);
+        print_performance_stats();
+
+        if (dispatched > 0 || batch_size > 0)
+            continue;
+
+        // Workers are busy, or URLs wait on a host slot or a backoff
+        if (thread_pool_pending(thread_pool) > 0 || held_count > 0 || retry_pending() > 0)
+        {
+            usleep(DISPATCH_POLL_US);
+            continue;
+        }
+
+        // Wait a bit and check again, or break if no more work
+        usleep(500000); // 0.5 second
+        if (!continuous && !storage->has_pending() && thread_pool_pending(thread_pool) == 0 &&
+            retry_pending() == 0)
+        {
+            break; // No more work to do
+        }
+    }
+
+    // Claimed URLs never fetched, at MAX_URLS or on an interrupt, go back
+    // to the frontier; dequeue_batch already marked them crawled
+    for (int i = 0; i < held_count; i++)
+    {
+        storage->mark(held[i].url, URL_PENDING);
+        free(held[i].url);
+    }
+    held_count = 0;
+
+    log_info("Waiting for all threads to complete...\n");
+    thread_pool_wait(thread_pool);
+    log_info("All threads completed!\n");
+
+    // So do retries and URLs deferred by a breaker; retries restart from
+    // attempt 0
+    int retry_count;
+    while ((retry_count = retry_pop_due(retries, DEQUEUE_BATCH_SIZE, LLONG_MAX)) > 0)
+    {
+        for (int i = 0; i < retry_count; i++)
+        {
+            storage->mark(retries[i].url, URL_PENDING);
+            free(retries[i].url);
+        }
+    }
+    sitemap_cleanup();
+    dns_cleanup();
+    retry_cleanup();
+    log_shutdown();
+
+    // Cleanup
+    print_stats();
+    if (METRICS_TEXTFILE)
+        metrics_write_textfile(METRICS_TEXTFILE);
+    if (trace_summary)
+        trace_print_host_summary(stdout);
+    if (trace_file)
+        trace_write_chrome(trace_file);
+    thread_pool_destroy(thread_pool);
+
+    if (resume_mode && start_url)
+    {
+        free(start_url);
+    }
+
+    // An interrupted session stays resumable, with its scheduler state saved
+    if (interrupted && snapshot_write(SNAPSHOT_FILE, stats.session_id))
+        printf("\nCrawl interrupted; continue with: --backend %s --resume %d\n", storage->name, stats.session_id);
+    else if (!interrupted)
+        snapshot_remove(SNAPSHOT_FILE, stats.session_id);
+
+    storage->cleanup(!interrupted);
+    xmlCleanupParser();
+    curl_global_cleanup();
+
+    log_info("\nCrawling completed!\n");
+    return 0;
+}
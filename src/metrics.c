@@ -0,0 +1,220 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "../include/config.h"
+#include "../include/lockstat.h"
+#include "../include/metrics.h"
+
+// Histogram bucket upper bounds in microseconds; a final +Inf bucket follows
+static const long long BUCKET_BOUNDS_US[] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+    100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000, 30000000};
+
+#define BUCKET_COUNT (sizeof(BUCKET_BOUNDS_US) / sizeof(BUCKET_BOUNDS_US[0]) + 1)
+
+typedef struct
+{
+    unsigned long buckets[BUCKET_COUNT];
+    unsigned long count;
+    unsigned long long sum_us;
+} Histogram;
+
+// One thread's metrics. Padded so slots of different threads never share a cache line.
+typedef struct
+{
+    long counters[METRIC_COUNTER_COUNT];
+    long gauges[GAUGE_COUNT];
+    Histogram histograms[HIST_COUNT];
+} __attribute__((aligned(64))) MetricsSlot;
+
+static MetricsSlot slots[METRICS_MAX_THREADS];
+static long seeded[METRIC_COUNTER_COUNT];
+static int next_slot = 0;
+static __thread MetricsSlot *thread_slot = NULL;
+
+static const struct
+{
+    const char *name;
+    const char *help;
+} COUNTER_INFO[METRIC_COUNTER_COUNT] = {
+    {"crawler_pages_crawled_total", "Pages downloaded and stored"},
+    {"crawler_links_found_total", "New links added to the frontier"},
+    {"crawler_errors_total", "Failed fetches and parses"},
+    {"crawler_skipped_urls_total", "URLs skipped by filters"},
+    {"crawler_bytes_downloaded_total", "Body bytes received, before content decoding"},
+    {"crawler_not_modified_total", "Revalidated pages answered with 304 Not Modified"},
+    {"crawler_pages_changed_total", "Revisited pages whose content had changed"},
+    {"crawler_revisits_total", "Crawled URLs put back into the frontier for a revisit"},
+    {"crawler_content_skipped_total", "Responses refused at the header phase by content type or size"},
+    {"crawler_robots_disallowed_total", "URLs not queued or not fetched because robots.txt disallows them"},
+    {"crawler_sitemap_urls_total", "New links added to the frontier from sitemaps"},
+    {"crawler_retries_total", "Failed fetches queued for another attempt"},
+    {"crawler_breaker_trips_total", "Times a host's circuit breaker opened"},
+    {"crawler_decoded_bytes_total", "Body bytes kept after content decoding"},
+    {"crawler_pages_truncated_total", "Pages cut off at the truncation limit"},
+    {"crawler_redirects_rewritten_total", "Links and queued URLs replaced by their known redirect or canonical target"},
+    {"crawler_alias_duplicates_total", "Alternate pages and queued aliases not followed because their target is stored"},
+    {"crawler_trap_urls_total", "Links not queued because their shape looks like a crawler trap"},
+    {"crawler_budget_refused_total", "Links not queued because their host's URL or page budget is spent"},
+    {"crawler_connections_total", "Connections opened for page fetches, including those of redirects"},
+    {"crawler_dns_prefetched_total", "Host names resolved by the DNS prefetch threads"},
+    {"crawler_dns_cache_hits_total", "Page and robots.txt fetches given a prefetched address instead of a lookup"},
+};
+
+static const struct
+{
+    const char *name;
+    const char *help;
+} GAUGE_INFO[GAUGE_COUNT] = {
+    {"crawler_queue_depth", "Pending URLs in the frontier"},
+    {"crawler_in_flight", "URLs currently being fetched or parsed"},
+};
+
+static const struct
+{
+    const char *name;
+    const char *help;
+} HISTOGRAM_INFO[HIST_COUNT] = {
+    {"crawler_fetch_seconds", "HTTP transfer time per URL"},
+    {"crawler_parse_seconds", "HTML parse and link extraction time per page"},
+    {"crawler_db_seconds", "Time spent in storage calls"},
+};
+
+// The calling thread's slot. Threads beyond METRICS_MAX_THREADS share the
+// last slot, which stays correct because every update is atomic.
+static MetricsSlot *get_slot(void)
+{
+    if (!thread_slot)
+    {
+        int index = __atomic_fetch_add(&next_slot, 1, __ATOMIC_RELAXED);
+        thread_slot = &slots[index < METRICS_MAX_THREADS ? index : METRICS_MAX_THREADS - 1];
+    }
+    return thread_slot;
+}
+
+void metrics_add(MetricCounter counter, long delta)
+{
+    __atomic_fetch_add(&get_slot()->counters[counter], delta, __ATOMIC_RELAXED);
+}
+
+void metrics_gauge_add(MetricGauge gauge, long delta)
+{
+    __atomic_fetch_add(&get_slot()->gauges[gauge], delta, __ATOMIC_RELAXED);
+}
+
+void metrics_observe(MetricHistogram histogram, long long usec)
+{
+    Histogram *h = &get_slot()->histograms[histogram];
+
+    size_t bucket = 0;
+    while (bucket < BUCKET_COUNT - 1 && usec > BUCKET_BOUNDS_US[bucket])
+        bucket++;
+
+    __atomic_fetch_add(&h->buckets[bucket], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sum_us, (unsigned long long)(usec > 0 ? usec : 0), __ATOMIC_RELAXED);
+}
+
+long metrics_get(MetricCounter counter)
+{
+    long total = __atomic_load_n(&seeded[counter], __ATOMIC_RELAXED);
+    for (int i = 0; i < METRICS_MAX_THREADS; i++)
+        total += __atomic_load_n(&slots[i].counters[counter], __ATOMIC_RELAXED);
+    return total;
+}
+
+long metrics_gauge_get(MetricGauge gauge)
+{
+    long total = 0;
+    for (int i = 0; i < METRICS_MAX_THREADS; i++)
+        total += __atomic_load_n(&slots[i].gauges[gauge], __ATOMIC_RELAXED);
+    return total;
+}
+
+static void merge_histogram(MetricHistogram histogram, Histogram *out)
+{
+    memset(out, 0, sizeof(*out));
+    for (int i = 0; i < METRICS_MAX_THREADS; i++)
+    {
+        const Histogram *h = &slots[i].histograms[histogram];
+        for (size_t b = 0; b < BUCKET_COUNT; b++)
+            out->buckets[b] += __atomic_load_n(&h->buckets[b], __ATOMIC_RELAXED);
+        out->count += __atomic_load_n(&h->count, __ATOMIC_RELAXED);
+        out->sum_us += __atomic_load_n(&h->sum_us, __ATOMIC_RELAXED);
+    }
+}
+
+long long metrics_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+void metrics_seed(const CrawlerStats *counts)
+{
+    __atomic_store_n(&seeded[METRIC_PAGES_CRAWLED], counts->pages_crawled, __ATOMIC_RELAXED);
+    __atomic_store_n(&seeded[METRIC_LINKS_FOUND], counts->links_found, __ATOMIC_RELAXED);
+    __atomic_store_n(&seeded[METRIC_ERRORS], counts->errors, __ATOMIC_RELAXED);
+    __atomic_store_n(&seeded[METRIC_SKIPPED_URLS], counts->skipped_urls, __ATOMIC_RELAXED);
+    metrics_gauge_add(GAUGE_QUEUE_DEPTH, counts->pending_urls);
+}
+
+void metrics_write_prometheus(FILE *out)
+{
+    for (int c = 0; c < METRIC_COUNTER_COUNT; c++)
+    {
+        fprintf(out, "# HELP %s %s\n# TYPE %s counter\n%s %ld\n",
+                COUNTER_INFO[c].name, COUNTER_INFO[c].help, COUNTER_INFO[c].name,
+                COUNTER_INFO[c].name, metrics_get(c));
+    }
+
+    for (int g = 0; g < GAUGE_COUNT; g++)
+    {
+        fprintf(out, "# HELP %s %s\n# TYPE %s gauge\n%s %ld\n",
+                GAUGE_INFO[g].name, GAUGE_INFO[g].help, GAUGE_INFO[g].name,
+                GAUGE_INFO[g].name, metrics_gauge_get(g));
+    }
+
+    for (int h = 0; h < HIST_COUNT; h++)
+    {
+        const char *name = HISTOGRAM_INFO[h].name;
+        Histogram merged;
+        merge_histogram(h, &merged);
+
+        fprintf(out, "# HELP %s %s\n# TYPE %s histogram\n", name, HISTOGRAM_INFO[h].help, name);
+
+        unsigned long cumulative = 0;
+        for (size_t b = 0; b < BUCKET_COUNT - 1; b++)
+        {
+            cumulative += merged.buckets[b];
+            fprintf(out, "%s_bucket{le=\"%g\"} %lu\n", name, BUCKET_BOUNDS_US[b] / 1e6, cumulative);
+        }
+        cumulative += merged.buckets[BUCKET_COUNT - 1];
+        fprintf(out, "%s_bucket{le=\"+Inf\"} %lu\n", name, cumulative);
+        fprintf(out, "%s_sum %.6f\n%s_count %lu\n", name, merged.sum_us / 1e6, name, merged.count);
+    }
+
+    lockstat_write_prometheus(out);
+}
+
+int metrics_write_textfile(const char *path)
+{
+    char tmp_path[512];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    FILE *f = fopen(tmp_path, "w");
+    if (!f)
+        return 0;
+
+    metrics_write_prometheus(f);
+
+    if (fclose(f) != 0 || rename(tmp_path, path) != 0)
+    {
+        remove(tmp_path);
+        return 0;
+    }
+    return 1;
+}
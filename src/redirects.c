@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "../include/config.h"
+#include "../include/crawler.h"
+#include "../include/redirects.h"
+#include "../include/snapshot.h"
+
+// Source URLs and their final URLs; a slot is in use once its source is
+// set, and mapped once its target is
+static char *sources[REDIRECT_TABLE_SIZE];
+static char *targets[REDIRECT_TABLE_SIZE];
+static int recorded = 0;
+
+static unsigned int hash_url(const char *s)
+{
+    unsigned int hash = 2166136261u;
+    for (; *s; s++)
+    {
+        hash ^= (unsigned char)*s;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Slot of source, claimed if create is set; -1 if absent or the table is full
+static int find_slot(const char *source, int create)
+{
+    unsigned int start = hash_url(source);
+    char *copy = NULL;
+
+    // Probe a bounded run so a full table does not cost a scan per link
+    for (int i = 0; i < REDIRECT_PROBE_LIMIT; i++)
+    {
+        int slot = (start + i) & (REDIRECT_TABLE_SIZE - 1);
+        char *current = __atomic_load_n(&sources[slot], __ATOMIC_ACQUIRE);
+
+        if (!current)
+        {
+            if (!create)
+                return -1;
+            if (!copy && !(copy = my_strdup(source)))
+                return -1;
+
+            char *expected = NULL;
+            if (__atomic_compare_exchange_n(&sources[slot], &expected, copy, 0,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+                return slot;
+            current = expected; // Another thread claimed the slot first
+        }
+
+        if (strcmp(current, source) == 0)
+        {
+            free(copy);
+            return slot;
+        }
+    }
+
+    free(copy);
+    return -1;
+}
+
+void redirect_record(const char *source, const char *target)
+{
+    if (!source || !target || strcmp(source, target) == 0)
+        return;
+
+    // A target that itself redirects stands for its own final URL
+    const char *final = redirect_lookup(target);
+    if (final)
+        target = final;
+    if (strcmp(source, target) == 0)
+        return; // A redirect loop back to the source
+
+    int slot = find_slot(source, 1);
+    char *copy = slot >= 0 ? my_strdup(target) : NULL;
+    if (!copy)
+        return;
+
+    char *expected = NULL;
+    if (__atomic_compare_exchange_n(&targets[slot], &expected, copy, 0,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        __atomic_add_fetch(&recorded, 1, __ATOMIC_RELAXED);
+    else
+        free(copy);
+}
+
+const char *redirect_lookup(const char *source)
+{
+    if (!source)
+        return NULL;
+    int slot = find_slot(source, 0);
+    return slot < 0 ? NULL : __atomic_load_n(&targets[slot], __ATOMIC_ACQUIRE);
+}
+
+int redirect_count(void)
+{
+    return __atomic_load_n(&recorded, __ATOMIC_RELAXED);
+}
+
+// Mapped sources, each followed by its target. Written once the workers
+// have stopped, so the count holds.
+void redirects_snapshot_write(FILE *out)
+{
+    uint32_t count = 0;
+    for (int i = 0; i < REDIRECT_TABLE_SIZE; i++)
+        count += __atomic_load_n(&targets[i], __ATOMIC_ACQUIRE) != NULL;
+    snapshot_put(out, &count, sizeof(count));
+
+    for (int i = 0; i < REDIRECT_TABLE_SIZE; i++)
+    {
+        const char *target = __atomic_load_n(&targets[i], __ATOMIC_ACQUIRE);
+        if (!target)
+            continue;
+        snapshot_put_string(out, sources[i]);
+        snapshot_put_string(out, target);
+    }
+}
+
+int redirects_snapshot_read(SnapshotReader *in)
+{
+    char source[MAX_URL_LENGTH], target[MAX_URL_LENGTH];
+    uint32_t count;
+    int before = redirect_count();
+
+    snapshot_get(in, &count, sizeof(count));
+    for (uint32_t i = 0; i < count && !in->failed; i++)
+    {
+        snapshot_get_string(in, source, sizeof(source));
+        snapshot_get_string(in, target, sizeof(target));
+        if (!in->failed)
+            redirect_record(source, target);
+    }
+    return redirect_count() - before;
+}
@@ -0,0 +1,127 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../include/config.h"
+#include "../include/crawler.h"
+#include "../include/metrics.h"
+#include "../include/retry.h"
+
+static RetryEntry heap[RETRY_QUEUE_SIZE];
+static int heap_count = 0;
+static unsigned int jitter_seed = 0;
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void swap_entries(int a, int b)
+{
+    RetryEntry tmp = heap[a];
+    heap[a] = heap[b];
+    heap[b] = tmp;
+}
+
+// Caller holds heap_lock
+static int heap_push(const char *url, int depth, int attempt, long long due_us)
+{
+    if (heap_count == RETRY_QUEUE_SIZE)
+        return 0;
+
+    char *copy = my_strdup(url);
+    if (!copy)
+        return 0;
+
+    int i = heap_count++;
+    heap[i] = (RetryEntry){copy, depth, attempt, due_us};
+    while (i > 0 && heap[(i - 1) / 2].due_us > heap[i].due_us)
+    {
+        swap_entries(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+    return 1;
+}
+
+// Caller holds heap_lock and has checked heap_count
+static RetryEntry heap_pop(void)
+{
+    RetryEntry top = heap[0];
+    heap[0] = heap[--heap_count];
+
+    int i = 0;
+    for (;;)
+    {
+        int smallest = i;
+        int left = 2 * i + 1, right = left + 1;
+        if (left < heap_count && heap[left].due_us < heap[smallest].due_us)
+            smallest = left;
+        if (right < heap_count && heap[right].due_us < heap[smallest].due_us)
+            smallest = right;
+        if (smallest == i)
+            break;
+        swap_entries(i, smallest);
+        i = smallest;
+    }
+    return top;
+}
+
+// Half the doubled delay is fixed and half random ("equal jitter"), so
+// URLs that failed together do not all come back at the same moment
+static long long backoff_us(int attempt)
+{
+    long long delay_ms = RETRY_BASE_DELAY_MS;
+    for (int i = 1; i < attempt && delay_ms < RETRY_MAX_DELAY_MS; i++)
+        delay_ms *= 2;
+    if (delay_ms > RETRY_MAX_DELAY_MS)
+        delay_ms = RETRY_MAX_DELAY_MS;
+
+    if (jitter_seed == 0)
+        jitter_seed = (unsigned int)metrics_now_us() | 1;
+    long long half = delay_ms / 2;
+    return (half + rand_r(&jitter_seed) % (half + 1)) * 1000;
+}
+
+int retry_schedule(const char *url, int depth, int attempt, long long not_before_us)
+{
+    if (!RETRY_FAILED_REQUESTS || attempt > MAX_RETRIES)
+        return 0;
+
+    pthread_mutex_lock(&heap_lock);
+    long long due = metrics_now_us() + backoff_us(attempt);
+    int queued = heap_push(url, depth, attempt, due > not_before_us ? due : not_before_us);
+    pthread_mutex_unlock(&heap_lock);
+    return queued;
+}
+
+int retry_defer(const char *url, int depth, int attempt, long long due_us)
+{
+    pthread_mutex_lock(&heap_lock);
+    int queued = heap_push(url, depth, attempt, due_us);
+    pthread_mutex_unlock(&heap_lock);
+    return queued;
+}
+
+int retry_pop_due(RetryEntry *out, int max, long long now_us)
+{
+    int count = 0;
+    pthread_mutex_lock(&heap_lock);
+    while (count < max && heap_count > 0 && heap[0].due_us <= now_us)
+        out[count++] = heap_pop();
+    pthread_mutex_unlock(&heap_lock);
+    return count;
+}
+
+int retry_pending(void)
+{
+    pthread_mutex_lock(&heap_lock);
+    int count = heap_count;
+    pthread_mutex_unlock(&heap_lock);
+    return count;
+}
+
+void retry_cleanup(void)
+{
+    pthread_mutex_lock(&heap_lock);
+    while (heap_count > 0)
+        free(heap[--heap_count].url);
+    pthread_mutex_unlock(&heap_lock);
+}
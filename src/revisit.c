@@ -0,0 +1,35 @@
+#include <math.h>
+#include "../include/config.h"
+#include "../include/revisit.h"
+
+time_t revisit_interval(const RevisitHistory *history, time_t now)
+{
+    int revisits = history->visits - 1;
+    if (revisits <= 0 || now <= history->first_visit)
+        return REVISIT_INITIAL_INTERVAL;
+
+    // Visits are scheduled, so treat them as roughly evenly spaced
+    double mean_gap = (double)(now - history->first_visit) / revisits;
+    double interval;
+
+    if (history->changes <= 0)
+    {
+        interval = mean_gap * 2;
+    }
+    else
+    {
+        // Cho and Garcia-Molina's change-rate estimator for regular checks.
+        // It stays finite when every revisit found a change, where the naive
+        // changes / elapsed ratio underestimates pages that change between
+        // checks more than once.
+        int changes = history->changes < revisits ? history->changes : revisits;
+        double rate = -log((revisits - changes + 0.5) / (revisits + 0.5)) / mean_gap;
+        interval = 1.0 / rate;
+    }
+
+    if (interval < REVISIT_MIN_INTERVAL)
+        return REVISIT_MIN_INTERVAL;
+    if (interval > REVISIT_MAX_INTERVAL)
+        return REVISIT_MAX_INTERVAL;
+    return (time_t)interval;
+}
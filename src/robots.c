@@ -0,0 +1,587 @@
+#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <curl/curl.h>
+#include "../include/config.h"
+#include "../include/crawler.h"
+#include "../include/dns.h"
+#include "../include/hosts.h"
+#include "../include/log.h"
+#include "../include/robots.h"
+#include "../include/sitemap.h"
+#include "../include/storage.h"
+
+// Trie node for plain rules; a node's children form a sibling list
+typedef struct
+{
+    int child;            // First child, or -1
+    int sibling;          // Next sibling, or -1
+    unsigned char c;      // Byte leading here from the parent
+    signed char rule;     // Rule ending here: 1 allow, 0 disallow, -1 none
+    signed char end_rule; // Same for a rule anchored with '$'
+} TrieNode;
+
+// A rule containing '*'; may end with '$'
+typedef struct
+{
+    char *pattern;
+    int length;
+    int allow;
+} WildcardRule;
+
+struct RobotsRules
+{
+    TrieNode *nodes; // nodes[0] is the root
+    int node_count;
+    int node_capacity;
+    WildcardRule *wildcards;
+    int wildcard_count;
+    long crawl_delay_ms;
+    time_t expires;
+    char **sitemaps; // Sitemap: lines, which belong to no group
+    int sitemap_count;
+};
+
+static int add_node(RobotsRules *rules, unsigned char c)
+{
+    if (rules->node_count == rules->node_capacity)
+    {
+        int new_capacity = rules->node_capacity ? rules->node_capacity * 2 : 64;
+        TrieNode *nodes = realloc(rules->nodes, new_capacity * sizeof(TrieNode));
+        if (!nodes)
+            return -1;
+        rules->nodes = nodes;
+        rules->node_capacity = new_capacity;
+    }
+
+    TrieNode *node = &rules->nodes[rules->node_count];
+    node->child = node->sibling = -1;
+    node->c = c;
+    node->rule = node->end_rule = -1;
+    return rules->node_count++;
+}
+
+static RobotsRules *rules_new(void)
+{
+    RobotsRules *rules = calloc(1, sizeof(RobotsRules));
+    if (rules && add_node(rules, 0) < 0)
+    {
+        free(rules);
+        return NULL;
+    }
+    return rules;
+}
+
+void robots_free(RobotsRules *rules)
+{
+    if (!rules)
+        return;
+    for (int i = 0; i < rules->wildcard_count; i++)
+        free(rules->wildcards[i].pattern);
+    free(rules->wildcards);
+    for (int i = 0; i < rules->sitemap_count; i++)
+        free(rules->sitemaps[i]);
+    free(rules->sitemaps);
+    free(rules->nodes);
+    free(rules);
+}
+
+static int find_child(const RobotsRules *rules, int node, unsigned char c)
+{
+    for (int child = rules->nodes[node].child; child >= 0; child = rules->nodes[child].sibling)
+    {
+        if (rules->nodes[child].c == c)
+            return child;
+    }
+    return -1;
+}
+
+static void rules_add(RobotsRules *rules, const char *pattern, size_t length, int allow)
+{
+    // An empty Disallow allows everything, which is the default anyway
+    if (!rules || length == 0)
+        return;
+
+    if (memchr(pattern, '*', length))
+    {
+        WildcardRule *wildcards = realloc(rules->wildcards, (rules->wildcard_count + 1) * sizeof(WildcardRule));
+        if (!wildcards)
+            return;
+        rules->wildcards = wildcards;
+
+        char *copy = malloc(length + 1);
+        if (!copy)
+            return;
+        memcpy(copy, pattern, length);
+        copy[length] = '\0';
+
+        WildcardRule *rule = &rules->wildcards[rules->wildcard_count++];
+        rule->pattern = copy;
+        rule->length = (int)length;
+        rule->allow = allow;
+        return;
+    }
+
+    int anchored = pattern[length - 1] == '$';
+    if (anchored)
+        length--;
+
+    int node = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        unsigned char c = (unsigned char)pattern[i];
+        int child = find_child(rules, node, c);
+        if (child < 0)
+        {
+            child = add_node(rules, c);
+            if (child < 0)
+                return;
+            rules->nodes[child].sibling = rules->nodes[node].child;
+            rules->nodes[node].child = child;
+        }
+        node = child;
+    }
+
+    // The same path under Allow and Disallow is a tie, which Allow wins
+    signed char *slot = anchored ? &rules->nodes[node].end_rule : &rules->nodes[node].rule;
+    if (*slot != 1)
+        *slot = (signed char)allow;
+}
+
+// Match a '*' pattern, optionally anchored with a final '$', against the
+// start of path. Backtracks only to the most recent '*'.
+static int wildcard_match(const char *pattern, const char *path)
+{
+    const char *p = pattern;
+    const char *s = path;
+    const char *star = NULL;
+    const char *resume = NULL;
+
+    for (;;)
+    {
+        if (*p == '\0')
+            return 1;
+
+        if (*p == '*')
+        {
+            star = ++p;
+            resume = s;
+            continue;
+        }
+
+        if (p[0] == '$' && p[1] == '\0')
+        {
+            if (*s == '\0')
+                return 1;
+        }
+        else if (*s && *p == *s)
+        {
+            p++;
+            s++;
+            continue;
+        }
+
+        if (!star || !*resume)
+            return 0;
+        p = star;
+        s = ++resume;
+    }
+}
+
+// Keep the longest matching rule; Allow wins a tie
+static void consider(int rule, int length, int *best_length, int *best_allow)
+{
+    if (rule >= 0 && (length > *best_length || (length == *best_length && rule == 1)))
+    {
+        *best_length = length;
+        *best_allow = rule;
+    }
+}
+
+int robots_match(const RobotsRules *rules, const char *path)
+{
+    if (!rules || strcmp(path, "/robots.txt") == 0)
+        return 1;
+
+    int best_length = -1;
+    int best_allow = 1;
+
+    // One walk down the trie passes every plain rule that prefixes the path
+    int node = 0;
+    for (int i = 0; path[i]; i++)
+    {
+        node = find_child(rules, node, (unsigned char)path[i]);
+        if (node < 0)
+            break;
+
+        consider(rules->nodes[node].rule, i + 1, &best_length, &best_allow);
+        if (path[i + 1] == '\0')
+            consider(rules->nodes[node].end_rule, i + 2, &best_length, &best_allow);
+    }
+
+    for (int i = 0; i < rules->wildcard_count; i++)
+    {
+        const WildcardRule *rule = &rules->wildcards[i];
+        if (rule->length >= best_length && wildcard_match(rule->pattern, path))
+            consider(rule->allow, rule->length, &best_length, &best_allow);
+    }
+
+    return best_allow;
+}
+
+long robots_crawl_delay_ms(const RobotsRules *rules)
+{
+    return rules ? rules->crawl_delay_ms : 0;
+}
+
+static void rules_add_sitemap(RobotsRules *rules, const char *url, size_t length)
+{
+    if (length == 0 || length >= MAX_URL_LENGTH)
+        return;
+
+    char **sitemaps = realloc(rules->sitemaps, (rules->sitemap_count + 1) * sizeof(char *));
+    if (!sitemaps)
+        return;
+    rules->sitemaps = sitemaps;
+
+    char *copy = malloc(length + 1);
+    if (!copy)
+        return;
+    memcpy(copy, url, length);
+    copy[length] = '\0';
+    rules->sitemaps[rules->sitemap_count++] = copy;
+}
+
+// Trim spaces and tabs from both ends of [*start, *end)
+static void trim(const char **start, const char **end)
+{
+    while (*start < *end && (**start == ' ' || **start == '\t'))
+        (*start)++;
+    while (*end > *start && ((*end)[-1] == ' ' || (*end)[-1] == '\t' || (*end)[-1] == '\r'))
+        (*end)--;
+}
+
+static int key_is(const char *key, size_t length, const char *name)
+{
+    return length == strlen(name) && strncasecmp(key, name, length) == 0;
+}
+
+RobotsRules *robots_compile(const char *body, size_t length, const char *agent)
+{
+    RobotsRules *mine = rules_new(); // Groups naming our agent
+    RobotsRules *any = rules_new();  // Groups for "*"
+    if (!mine || !any)
+    {
+        robots_free(mine);
+        robots_free(any);
+        return NULL;
+    }
+
+    size_t agent_length = strcspn(agent, "/ ");
+    int found_mine = 0;
+    int group_mine = 0;
+    int group_any = 0;
+    int in_agents = 0; // The previous line was a User-agent line
+    RobotsRules *sitemaps = rules_new();
+    if (!sitemaps)
+    {
+        robots_free(mine);
+        robots_free(any);
+        return NULL;
+    }
+
+    if (length > ROBOTS_MAX_SIZE)
+        length = ROBOTS_MAX_SIZE;
+
+    const char *end = body + length;
+    for (const char *line = body; line < end;)
+    {
+        const char *eol = memchr(line, '\n', end - line);
+        if (!eol)
+            eol = end;
+        const char *line_end = memchr(line, '#', eol - line);
+        if (!line_end)
+            line_end = eol;
+
+        const char *colon = memchr(line, ':', line_end - line);
+        if (colon)
+        {
+            const char *key = line, *key_end = colon;
+            const char *value = colon + 1, *value_end = line_end;
+            trim(&key, &key_end);
+            trim(&value, &value_end);
+            size_t key_length = key_end - key;
+            size_t value_length = value_end - value;
+
+            if (key_is(key, key_length, "user-agent"))
+            {
+                // Consecutive User-agent lines share one group
+                if (!in_agents)
+                    group_mine = group_any = 0;
+                in_agents = 1;
+
+                size_t token_length = strcspn(value, "/ \t\r\n");
+                if (token_length > value_length)
+                    token_length = value_length;
+                if (token_length == 1 && value[0] == '*')
+                    group_any = 1;
+                else if (token_length == agent_length && strncasecmp(value, agent, agent_length) == 0)
+                    group_mine = found_mine = 1;
+            }
+            else
+            {
+                in_agents = 0;
+
+                int allow = key_is(key, key_length, "allow");
+                if (allow || key_is(key, key_length, "disallow"))
+                {
+                    if (group_mine)
+                        rules_add(mine, value, value_length, allow);
+                    if (group_any)
+                        rules_add(any, value, value_length, allow);
+                }
+                else if (key_is(key, key_length, "sitemap"))
+                {
+                    rules_add_sitemap(sitemaps, value, value_length);
+                }
+                else if (key_is(key, key_length, "crawl-delay"))
+                {
+                    char number[32];
+                    snprintf(number, sizeof(number), "%.*s", (int)value_length, value);
+                    double seconds = strtod(number, NULL);
+                    if (seconds > ROBOTS_MAX_CRAWL_DELAY)
+                        seconds = ROBOTS_MAX_CRAWL_DELAY;
+                    long delay_ms = seconds > 0 ? (long)(seconds * 1000) : 0;
+                    if (group_mine)
+                        mine->crawl_delay_ms = delay_ms;
+                    if (group_any)
+                        any->crawl_delay_ms = delay_ms;
+                }
+            }
+        }
+
+        line = eol + 1;
+    }
+
+    // Hand the Sitemap: lines to the group that is kept
+    RobotsRules *rules = found_mine ? mine : any;
+    robots_free(found_mine ? any : mine);
+    rules->sitemaps = sitemaps->sitemaps;
+    rules->sitemap_count = sitemaps->sitemap_count;
+    sitemaps->sitemaps = NULL;
+    sitemaps->sitemap_count = 0;
+    robots_free(sitemaps);
+    return rules;
+}
+
+// Path and query of an absolute URL, "/" when empty
+static void url_path(const char *url, char *out, size_t out_size)
+{
+    const char *path = strstr(url, "://");
+    path = path ? path + 3 : url;
+    path += strcspn(path, "/?#");
+    int length = (int)strcspn(path, "#");
+
+    if (*path == '/')
+        snprintf(out, out_size, "%.*s", length, path);
+    else
+        snprintf(out, out_size, "/%.*s", length, path);
+}
+
+static size_t robots_write(char *data, size_t size, size_t nmemb, void *userdata)
+{
+    return write_callback(data, size, nmemb, userdata);
+}
+
+// Download scheme://authority/robots.txt, up to ROBOTS_MAX_SIZE bytes; a
+// longer file is cut off there and parsed as far as it got. The status is 0
+// when the server could not be reached.
+static long fetch_robots(const char *url, char **body, size_t *length)
+{
+    const char *authority = strstr(url, "://");
+    authority = authority ? authority + 3 : url;
+    char robots_url[MAX_URL_LENGTH];
+    snprintf(robots_url, sizeof(robots_url), "%.*s/robots.txt",
+             (int)(authority - url + strcspn(authority, "/?#")), url);
+
+    CURL *curl = curl_easy_init();
+    if (!curl)
+        return 0;
+
+    WebPage page = {0};
+    page.capacity = INITIAL_PAGE_SIZE;
+    page.limit = ROBOTS_MAX_SIZE;
+    page.data = malloc(page.capacity);
+
+    curl_easy_setopt(curl, CURLOPT_URL, robots_url);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, robots_write);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &page);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_MAXREDIRS, MAX_REDIRECTS);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, REQUEST_TIMEOUT);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, USER_AGENT);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, SSL_VERIFY_PEER);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, SSL_VERIFY_HOST);
+    if (ENABLE_COMPRESSION)
+        curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+
+    // Usually the host's first request, so the one the prefetch saves most
+    struct curl_slist *resolve = dns_resolve_list(robots_url);
+    if (resolve)
+        curl_easy_setopt(curl, CURLOPT_RESOLVE, resolve);
+
+    long status = 0;
+    CURLcode res = page.data ? curl_easy_perform(curl) : CURLE_OUT_OF_MEMORY;
+    if (res == CURLE_OK || (res == CURLE_WRITE_ERROR && page.truncated))
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    curl_easy_cleanup(curl);
+    curl_slist_free_all(resolve);
+
+    log_info("Fetched %s (status %ld, %zu bytes)\n", robots_url, status, page.size);
+
+    *body = page.data;
+    *length = page.size;
+    return status;
+}
+
+// How long a robots.txt response is trusted
+static time_t robots_ttl(long status)
+{
+    return status == 0 || status >= 500 ? ROBOTS_ERROR_TTL : ROBOTS_CACHE_TTL;
+}
+
+// Rules for a robots.txt response (RFC 9309): a 2xx body is compiled, other
+// client errors and exhausted redirects allow everything, and server errors
+// or an unreachable server disallow everything until the entry expires
+static RobotsRules *rules_for_response(long status, const char *body, size_t length)
+{
+    if (status >= 200 && status < 300)
+        return robots_compile(body ? body : "", body ? length : 0, USER_AGENT);
+
+    RobotsRules *rules = rules_new();
+    if (status == 0 || status >= 500)
+        rules_add(rules, "/", 1, 0);
+    return rules;
+}
+
+// Load a host's rules from storage if still fresh, otherwise from the network
+static RobotsRules *load_rules(const char *url)
+{
+    char host[256];
+    get_url_host(url, host, sizeof(host));
+
+    time_t now = time(NULL);
+    long status = 0;
+    char *body = NULL;
+    size_t length = 0;
+    time_t fetched = 0;
+
+    if (!storage->load_robots || !storage->load_robots(host, &status, &body, &length, &fetched) ||
+        fetched + robots_ttl(status) <= now)
+    {
+        free(body);
+        status = fetch_robots(url, &body, &length);
+        fetched = now;
+        if (storage->save_robots)
+            storage->save_robots(host, status, body, length, fetched);
+    }
+
+    RobotsRules *rules = rules_for_response(status, body, length);
+    if (rules)
+        rules->expires = fetched + robots_ttl(status);
+    free(body);
+    return rules;
+}
+
+int robots_allowed(const char *url)
+{
+    if (!RESPECT_ROBOTS_TXT)
+        return 1;
+
+    Host *host = host_find(url);
+    RobotsRules *rules = host ? __atomic_load_n(&host->robots, __ATOMIC_ACQUIRE) : NULL;
+    if (!rules)
+        return 1;
+
+    char path[MAX_URL_LENGTH];
+    url_path(url, path, sizeof(path));
+    return robots_match(rules, path);
+}
+
+// Rules for a host without an entry of its own, loaded for this one check.
+// Its Crawl-delay raises the delay shared by all such hosts.
+static int check_uncached(Host *shared, const char *url)
+{
+    RobotsRules *rules = load_rules(url);
+    if (!rules)
+        return 0; // Fail closed
+
+    long delay_ms = __atomic_load_n(&shared->crawl_delay_ms, __ATOMIC_RELAXED);
+    while (rules->crawl_delay_ms > delay_ms &&
+           !__atomic_compare_exchange_n(&shared->crawl_delay_ms, &delay_ms, rules->crawl_delay_ms, 0,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+
+    char path[MAX_URL_LENGTH];
+    url_path(url, path, sizeof(path));
+    int allowed = robots_match(rules, path);
+    robots_free(rules);
+    return allowed;
+}
+
+int robots_check(const char *url)
+{
+    if (!RESPECT_ROBOTS_TXT)
+        return 1;
+
+    Host *host = host_get(url);
+    if (!host)
+        return 1;
+    if (host_is_shared(host))
+        return check_uncached(host, url);
+
+    RobotsRules *rules = __atomic_load_n(&host->robots, __ATOMIC_ACQUIRE);
+    while (!rules || rules->expires <= time(NULL))
+    {
+        int expected = 0;
+        if (__atomic_compare_exchange_n(&host->robots_loading, &expected, 1, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            // Replaced rules are not freed: lock-free readers may still use
+            // them, and a host's rules change at most once per TTL
+            RobotsRules *current = __atomic_load_n(&host->robots, __ATOMIC_ACQUIRE);
+            RobotsRules *loaded = current && current->expires > time(NULL) ? current : load_rules(url);
+            if (loaded)
+            {
+                __atomic_store_n(&host->crawl_delay_ms, loaded->crawl_delay_ms, __ATOMIC_RELAXED);
+                __atomic_store_n(&host->robots, loaded, __ATOMIC_RELEASE);
+                rules = loaded;
+
+                // Each load, at most once per TTL, rereads the host's sitemaps
+                for (int i = 0; SITEMAP_DISCOVERY && loaded != current && i < loaded->sitemap_count; i++)
+                    sitemap_submit(loaded->sitemaps[i], url);
+            }
+            __atomic_store_n(&host->robots_loading, 0, __ATOMIC_RELEASE);
+            break;
+        }
+
+        // Another thread is loading; expired rules serve until it is done
+        if (rules)
+            break;
+        usleep(10000);
+        rules = __atomic_load_n(&host->robots, __ATOMIC_ACQUIRE);
+    }
+
+    if (!rules)
+        return 1;
+
+    char path[MAX_URL_LENGTH];
+    url_path(url, path, sizeof(path));
+    return robots_match(rules, path);
+}
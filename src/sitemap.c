@@ -0,0 +1,425 @@
+#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <zlib.h>
+#include <curl/curl.h>
+#include <libxml/xmlreader.h>
+#include "../include/config.h"
+#include "../include/crawler.h"
+#include "../include/dns.h"
+#include "../include/hosts.h"
+#include "../include/log.h"
+#include "../include/metrics.h"
+#include "../include/robots.h"
+#include "../include/sitemap.h"
+#include "../include/storage.h"
+
+// A sitemap waiting for or being read by a worker
+typedef struct
+{
+    char *url;
+    char scope[256]; // Host its URLs must be on
+    int level;       // 0 for submitted sitemaps, +1 per index
+} SitemapTask;
+
+// Sitemaps read this run and when; also bounds the files fetched
+typedef struct
+{
+    char *url;
+    time_t read_time;
+} SitemapEntry;
+
+static ThreadPool *sitemap_pool = NULL;
+static SitemapEntry sitemaps_read[SITEMAP_MAX_FILES];
+static int sitemaps_read_count = 0;
+static pthread_mutex_t sitemaps_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void sitemap_task_worker(void *arg);
+
+void sitemap_init(ThreadPool *pool)
+{
+    sitemap_pool = pool;
+}
+
+void sitemap_cleanup(void)
+{
+    pthread_mutex_lock(&sitemaps_lock);
+    for (int i = 0; i < sitemaps_read_count; i++)
+        free(sitemaps_read[i].url);
+    sitemaps_read_count = 0;
+    sitemap_pool = NULL;
+    pthread_mutex_unlock(&sitemaps_lock);
+}
+
+// Record url as read now; 0 if it was read recently or there is no room
+static int claim_sitemap(const char *url)
+{
+    time_t now = time(NULL);
+    int claimed = 0;
+
+    pthread_mutex_lock(&sitemaps_lock);
+    int i = 0;
+    while (i < sitemaps_read_count && strcmp(sitemaps_read[i].url, url) != 0)
+        i++;
+
+    if (i < sitemaps_read_count)
+    {
+        if (now - sitemaps_read[i].read_time >= SITEMAP_REFRESH_INTERVAL)
+        {
+            sitemaps_read[i].read_time = now;
+            claimed = 1;
+        }
+    }
+    else if (sitemaps_read_count < SITEMAP_MAX_FILES)
+    {
+        sitemaps_read[i].url = my_strdup(url);
+        if (sitemaps_read[i].url)
+        {
+            sitemaps_read[i].read_time = now;
+            sitemaps_read_count++;
+            claimed = 1;
+        }
+    }
+    else
+    {
+        log_warn("Sitemap limit of %d files reached, ignoring %s\n", SITEMAP_MAX_FILES, url);
+    }
+    pthread_mutex_unlock(&sitemaps_lock);
+    return claimed;
+}
+
+static int submit_level(const char *sitemap_url, const char *scope, int level)
+{
+    if (!sitemap_pool || level > SITEMAP_MAX_NESTING || strlen(sitemap_url) >= MAX_URL_LENGTH ||
+        (strncmp(sitemap_url, "http://", 7) != 0 && strncmp(sitemap_url, "https://", 8) != 0))
+        return 0;
+    if (!claim_sitemap(sitemap_url))
+        return 0;
+
+    SitemapTask *task = malloc(sizeof(SitemapTask));
+    if (!task)
+        return 0;
+    task->url = my_strdup(sitemap_url);
+    snprintf(task->scope, sizeof(task->scope), "%s", scope);
+    task->level = level;
+    if (!task->url || !thread_pool_add_work(sitemap_pool, sitemap_task_worker, task))
+    {
+        free(task->url);
+        free(task);
+        return 0;
+    }
+    return 1;
+}
+
+int sitemap_submit(const char *sitemap_url, const char *scope_url)
+{
+    char scope[256];
+    get_url_host(scope_url, scope, sizeof(scope));
+    return submit_level(sitemap_url, scope, 0);
+}
+
+// W3C datetime as sitemaps use it: YYYY-MM-DD, optionally followed by
+// Thh:mm[:ss[.s]] and Z or +hh:mm. Returns 0 when it does not parse.
+static time_t parse_lastmod(const char *text)
+{
+    struct tm tm = {0};
+    int year, month, day, hour = 0, minute = 0, consumed = 0;
+    double second = 0;
+
+    if (sscanf(text, "%4d-%2d-%2d%n", &year, &month, &day, &consumed) < 3)
+        return 0;
+    text += consumed;
+
+    long offset = 0;
+    if (*text == 'T' && sscanf(text, "T%2d:%2d%n", &hour, &minute, &consumed) == 2)
+    {
+        text += consumed;
+        if (*text == ':' && sscanf(text, ":%lf%n", &second, &consumed) == 1)
+            text += consumed;
+
+        int offset_hours, offset_minutes;
+        if ((*text == '+' || *text == '-') && sscanf(text + 1, "%2d:%2d", &offset_hours, &offset_minutes) == 2)
+            offset = (*text == '-' ? -1 : 1) * (offset_hours * 3600L + offset_minutes * 60L);
+    }
+
+    tm.tm_year = year - 1900;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = day;
+    tm.tm_hour = hour;
+    tm.tm_min = minute;
+    tm.tm_sec = (int)second;
+    time_t t = timegm(&tm);
+    return t == (time_t)-1 ? 0 : t - offset;
+}
+
+// URLs waiting for one frontier insert
+typedef struct
+{
+    char *urls[SITEMAP_BATCH_SIZE];
+    time_t lastmod[SITEMAP_BATCH_SIZE];
+    int count;
+    int found; // <url> entries seen
+    int added; // New frontier URLs
+} SitemapBatch;
+
+static void batch_flush(SitemapBatch *batch)
+{
+    if (batch->count == 0)
+        return;
+
+    int added = 0;
+    if (storage->enqueue_batch)
+    {
+        added = storage->enqueue_batch((const char *const *)batch->urls, batch->lastmod, batch->count, SITEMAP_DEPTH);
+    }
+    else
+    {
+        // Without bulk inserts lastmod is dropped
+        for (int i = 0; i < batch->count; i++)
+            storage->enqueue(batch->urls[i], SITEMAP_DEPTH);
+        added = batch->count;
+    }
+    metrics_add(METRIC_SITEMAP_URLS, added);
+    batch->added += added;
+
+    for (int i = 0; i < batch->count; i++)
+        free(batch->urls[i]);
+    batch->count = 0;
+}
+
+// Filter a <loc> like an extracted link; sitemaps may only list their own host
+static void batch_add(SitemapBatch *batch, const SitemapTask *task, const char *loc, time_t lastmod)
+{
+    batch->found++;
+    if (strlen(loc) >= MAX_URL_LENGTH ||
+        (strncmp(loc, "http://", 7) != 0 && strncmp(loc, "https://", 8) != 0))
+        return;
+
+    char *url = my_strdup(loc);
+    if (!url)
+        return;
+    normalize_url(url);
+
+    char host[256];
+    get_url_host(url, host, sizeof(host));
+    if (strcasecmp(host, task->scope) != 0 || should_skip_url(url) || host_should_defer(url))
+    {
+        metrics_add(METRIC_SKIPPED_URLS, 1);
+        free(url);
+        return;
+    }
+    if (!robots_allowed(url))
+    {
+        metrics_add(METRIC_ROBOTS_DISALLOWED, 1);
+        free(url);
+        return;
+    }
+    UrlAdmission admission = host_admit_url(url);
+    if (admission != URL_ADMITTED)
+    {
+        metrics_add(admission == URL_HOST_BUDGET ? METRIC_BUDGET_REFUSED : METRIC_TRAP_URLS, 1);
+        free(url);
+        return;
+    }
+    host_record_queued(url); // Counted before the batch insert drops known URLs
+    dns_prefetch(url);
+
+    batch->urls[batch->count] = url;
+    batch->lastmod[batch->count] = lastmod;
+    if (++batch->count == SITEMAP_BATCH_SIZE)
+        batch_flush(batch);
+}
+
+// Download body, capped at SITEMAP_MAX_SIZE
+typedef struct
+{
+    FILE *file;
+    size_t size;
+} SitemapDownload;
+
+static size_t sitemap_write(char *data, size_t size, size_t nmemb, void *userdata)
+{
+    SitemapDownload *download = userdata;
+    size_t length = size * nmemb;
+    if (download->size + length > SITEMAP_MAX_SIZE)
+        return 0;
+    download->size += length;
+    return fwrite(data, 1, length, download->file);
+}
+
+// Decompressed input for the XML reader, capped at SITEMAP_MAX_SIZE
+typedef struct
+{
+    gzFile gz;
+    size_t size;
+} SitemapSource;
+
+static int sitemap_read(void *context, char *buffer, int length)
+{
+    SitemapSource *source = context;
+    if (source->size >= SITEMAP_MAX_SIZE)
+        return 0;
+    if ((size_t)length > SITEMAP_MAX_SIZE - source->size)
+        length = (int)(SITEMAP_MAX_SIZE - source->size);
+
+    int n = gzread(source->gz, buffer, (unsigned)length);
+    if (n > 0)
+        source->size += n;
+    return n;
+}
+
+static int sitemap_close(void *context)
+{
+    SitemapSource *source = context;
+    return gzclose(source->gz) == Z_OK ? 0 : -1;
+}
+
+// Fetch the sitemap into an unlinked temporary file; returns it rewound, or
+// NULL unless the server answered 200
+static FILE *fetch_sitemap(const char *url)
+{
+    FILE *file = tmpfile();
+    CURL *curl = curl_easy_init();
+    if (!file || !curl)
+    {
+        if (file)
+            fclose(file);
+        curl_easy_cleanup(curl);
+        return NULL;
+    }
+
+    SitemapDownload download = {file, 0};
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, sitemap_write);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &download);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_MAXREDIRS, MAX_REDIRECTS);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, REQUEST_TIMEOUT);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, USER_AGENT);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, SSL_VERIFY_PEER);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, SSL_VERIFY_HOST);
+    if (ENABLE_COMPRESSION)
+        curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, ""); // A .gz file itself is still read through zlib
+
+    host_pace(url);
+    CURLcode res = curl_easy_perform(curl);
+    long status = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    curl_easy_cleanup(curl);
+
+    if (res != CURLE_OK || status != 200 || fflush(file) != 0)
+    {
+        log_warn("Sitemap %s not read: %s (status %ld)\n", url,
+                 res != CURLE_OK ? curl_easy_strerror(res) : "bad response", status);
+        fclose(file);
+        return NULL;
+    }
+
+    metrics_add(METRIC_BYTES_DOWNLOADED, (long)download.size);
+    rewind(file);
+    return file;
+}
+
+// Copy the text of the reader's current element, trimmed
+static void read_text(xmlTextReaderPtr reader, char *out, size_t out_size)
+{
+    out[0] = '\0';
+    xmlChar *text = xmlTextReaderReadString(reader);
+    if (!text)
+        return;
+
+    const char *start = (const char *)text;
+    while (*start == ' ' || *start == '\t' || *start == '\r' || *start == '\n')
+        start++;
+    size_t length = strlen(start);
+    while (length > 0 && strchr(" \t\r\n", start[length - 1]))
+        length--;
+
+    if (length < out_size)
+    {
+        memcpy(out, start, length);
+        out[length] = '\0';
+    }
+    xmlFree(text);
+}
+
+static void ingest_sitemap(const SitemapTask *task)
+{
+    FILE *file = fetch_sitemap(task->url);
+    if (!file)
+        return;
+
+    // gzread passes uncompressed files through unchanged
+    int fd = dup(fileno(file));
+    fclose(file);
+    SitemapSource source = {fd >= 0 ? gzdopen(fd, "rb") : NULL, 0};
+    if (!source.gz)
+    {
+        if (fd >= 0)
+            close(fd);
+        return;
+    }
+
+    // The reader closes the source
+    xmlTextReaderPtr reader = xmlReaderForIO(sitemap_read, sitemap_close, &source, task->url, NULL,
+                                             XML_PARSE_NONET | XML_PARSE_NOERROR | XML_PARSE_NOWARNING);
+    if (!reader)
+        return; // The source is closed either way
+
+    SitemapBatch *batch = calloc(1, sizeof(SitemapBatch));
+    char loc[MAX_URL_LENGTH] = "";
+    char lastmod[64] = "";
+    int nested = 0;
+    int rc = 0;
+
+    while (batch && (rc = xmlTextReaderRead(reader)) == 1)
+    {
+        int type = xmlTextReaderNodeType(reader);
+        const char *name = (const char *)xmlTextReaderConstLocalName(reader);
+        if (!name)
+            continue;
+
+        if (type == XML_READER_TYPE_ELEMENT)
+        {
+            if (strcmp(name, "url") == 0 || strcmp(name, "sitemap") == 0)
+                loc[0] = lastmod[0] = '\0';
+            else if (strcmp(name, "loc") == 0)
+                read_text(reader, loc, sizeof(loc));
+            else if (strcmp(name, "lastmod") == 0)
+                read_text(reader, lastmod, sizeof(lastmod));
+        }
+        else if (type == XML_READER_TYPE_END_ELEMENT && loc[0])
+        {
+            if (strcmp(name, "url") == 0)
+                batch_add(batch, task, loc, parse_lastmod(lastmod));
+            else if (strcmp(name, "sitemap") == 0)
+                nested += submit_level(loc, task->scope, task->level + 1);
+        }
+    }
+
+    if (batch)
+    {
+        batch_flush(batch);
+        if (rc < 0)
+            log_warn("Sitemap %s: XML error after %d URLs\n", task->url, batch->found);
+        log_info("Sitemap %s: %d URLs, %d new, %d nested sitemaps (%zu bytes parsed)\n",
+                 task->url, batch->found, batch->added, nested, source.size);
+        free(batch);
+    }
+    xmlFreeTextReader(reader);
+}
+
+static void sitemap_task_worker(void *arg)
+{
+    SitemapTask *task = arg;
+    ingest_sitemap(task);
+    free(task->url);
+    free(task);
+}
@@ -0,0 +1,163 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../include/config.h"
+#include "../include/hosts.h"
+#include "../include/redirects.h"
+#include "../include/snapshot.h"
+#include "../include/storage.h"
+
+#define SNAPSHOT_MAGIC "CRAWLSNP"
+#define SNAPSHOT_TRAILER "SNAPEND1" // Marks a snapshot written to the end
+#define SNAPSHOT_VERSION 1
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    int32_t session_id;
+    int64_t written_at;
+    char backend[16]; // storage->name of the writer
+} SnapshotHeader;
+
+void snapshot_put(FILE *out, const void *data, size_t size)
+{
+    fwrite(data, 1, size, out);
+}
+
+void snapshot_put_string(FILE *out, const char *s)
+{
+    uint32_t len = (uint32_t)strlen(s);
+    snapshot_put(out, &len, sizeof(len));
+    snapshot_put(out, s, len);
+}
+
+void snapshot_get(SnapshotReader *in, void *data, size_t size)
+{
+    if (in->failed || (size_t)(in->end - in->pos) < size)
+    {
+        in->failed = 1;
+        memset(data, 0, size);
+        return;
+    }
+    memcpy(data, in->pos, size);
+    in->pos += size;
+}
+
+void snapshot_get_string(SnapshotReader *in, char *buf, size_t buf_size)
+{
+    uint32_t len = 0;
+    snapshot_get(in, &len, sizeof(len));
+    if (in->failed || len >= buf_size || (size_t)(in->end - in->pos) < len)
+    {
+        in->failed = 1;
+        if (buf_size > 0)
+            buf[0] = '\0';
+        return;
+    }
+    memcpy(buf, in->pos, len);
+    buf[len] = '\0';
+    in->pos += len;
+}
+
+int snapshot_write(const char *path, int session_id)
+{
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    FILE *f = fopen(tmp, "wb");
+    if (!f)
+    {
+        perror("Failed to write crawl snapshot");
+        return 0;
+    }
+
+    SnapshotHeader header = {0};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.session_id = session_id;
+    header.written_at = (int64_t)time(NULL);
+    snprintf(header.backend, sizeof(header.backend), "%s", storage->name);
+    snapshot_put(f, &header, sizeof(header));
+
+    hosts_snapshot_write(f);
+    redirects_snapshot_write(f);
+    snapshot_put(f, SNAPSHOT_TRAILER, 8);
+
+    int ok = !ferror(f);
+    if (fclose(f) != 0 || !ok || rename(tmp, path) != 0)
+    {
+        fprintf(stderr, "Failed to write crawl snapshot %s\n", path);
+        remove(tmp);
+        return 0;
+    }
+    return 1;
+}
+
+int snapshot_load(const char *path, int session_id)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)(sizeof(SnapshotHeader) + 8))
+    {
+        close(fd);
+        return 0;
+    }
+    const char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return 0;
+
+    SnapshotHeader header;
+    memcpy(&header, map, sizeof(header));
+    header.backend[sizeof(header.backend) - 1] = '\0';
+
+    // A snapshot of another session or backend, or one cut short, is stale
+    int ok = memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) == 0 &&
+             header.version == SNAPSHOT_VERSION && header.session_id == session_id &&
+             strcmp(header.backend, storage->name) == 0 &&
+             memcmp(map + st.st_size - 8, SNAPSHOT_TRAILER, 8) == 0;
+
+    if (ok)
+    {
+        SnapshotReader in = {map + sizeof(header), map + st.st_size - 8, 0};
+        int hosts = hosts_snapshot_read(&in);
+        int redirects = redirects_snapshot_read(&in);
+        if (in.failed)
+            fprintf(stderr, "Crawl snapshot %s is corrupt; restored what was readable\n", path);
+        printf("Restored crawl snapshot: %d hosts, %d redirects\n", hosts, redirects);
+    }
+    munmap((void *)map, st.st_size);
+    return ok;
+}
+
+int snapshot_remove(const char *path, int session_id)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return 0;
+
+    SnapshotHeader header;
+    int read = fread(&header, sizeof(header), 1, f) == 1;
+    fclose(f);
+    if (!read)
+        return 0;
+    header.backend[sizeof(header.backend) - 1] = '\0';
+
+    // Another session's snapshot keeps it resumable
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+        header.session_id != session_id || strcmp(header.backend, storage->name) != 0)
+        return 0;
+    return remove(path) == 0;
+}
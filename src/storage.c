@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "../include/storage.h"
+#include "../include/lockstat.h"
+#include "../include/log.h"
+#include "../include/metrics.h"
+#include "../include/hosts.h"
+#include "../include/redirects.h"
+
+CrawlerStats stats = {0};
+
+const StorageBackend *storage = &sqlite_backend;
+
+int storage_select(const char *name)
+{
+    const StorageBackend *backends[] = {&sqlite_backend, &log_backend, NULL};
+
+    for (int i = 0; backends[i] != NULL; i++)
+    {
+        if (strcmp(backends[i]->name, name) == 0)
+        {
+            storage = backends[i];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Seed the live metrics with what storage already holds for the session.
+// This is the only stats query; monitoring afterwards never touches storage.
+void load_session_stats(void)
+{
+    CrawlerStats counts = {0};
+    storage->stats(&counts);
+    metrics_seed(&counts);
+}
+
+// Print crawler statistics
+void print_stats(void)
+{
+    time_t end_time = time(NULL);
+    double elapsed = difftime(end_time, stats.start_time);
+    long pages_crawled = metrics_get(METRIC_PAGES_CRAWLED);
+
+    printf("\n=== Crawler Statistics ===\n");
+    printf("Storage backend: %s\n", storage->name);
+    printf("Session ID: %d\n", stats.session_id);
+    printf("Pages crawled: %ld\n", pages_crawled);
+    if (metrics_get(METRIC_NOT_MODIFIED) > 0)
+        printf("Pages not modified: %ld\n", metrics_get(METRIC_NOT_MODIFIED));
+    if (metrics_get(METRIC_REVISITS) > 0)
+        printf("Revisits: %ld (%ld changed)\n", metrics_get(METRIC_REVISITS), metrics_get(METRIC_PAGES_CHANGED));
+    printf("Links found: %ld\n", metrics_get(METRIC_LINKS_FOUND));
+    printf("URLs skipped: %ld\n", metrics_get(METRIC_SKIPPED_URLS));
+    if (metrics_get(METRIC_CONTENT_SKIPPED) > 0)
+        printf("Responses skipped by content type or size: %ld\n", metrics_get(METRIC_CONTENT_SKIPPED));
+    if (metrics_get(METRIC_ROBOTS_DISALLOWED) > 0)
+        printf("URLs disallowed by robots.txt: %ld\n", metrics_get(METRIC_ROBOTS_DISALLOWED));
+    if (metrics_get(METRIC_SITEMAP_URLS) > 0)
+        printf("URLs queued from sitemaps: %ld\n", metrics_get(METRIC_SITEMAP_URLS));
+    if (metrics_get(METRIC_RETRIES) > 0)
+        printf("Retries: %ld\n", metrics_get(METRIC_RETRIES));
+    if (metrics_get(METRIC_BREAKER_TRIPS) > 0)
+        printf("Circuit breaker trips: %ld\n", metrics_get(METRIC_BREAKER_TRIPS));
+    if (redirect_count() > 0)
+        printf("Redirecting or non-canonical URLs: %d (%ld links rewritten to their target)\n",
+               redirect_count(), metrics_get(METRIC_REDIRECTS_REWRITTEN));
+    if (metrics_get(METRIC_ALIAS_DUPLICATES) > 0)
+        printf("Aliases of stored pages not followed: %ld\n", metrics_get(METRIC_ALIAS_DUPLICATES));
+    if (metrics_get(METRIC_TRAP_URLS) + metrics_get(METRIC_BUDGET_REFUSED) > 0)
+        printf("URLs refused as traps: %ld, over host budget: %ld\n", metrics_get(METRIC_TRAP_URLS),
+               metrics_get(METRIC_BUDGET_REFUSED));
+    if (metrics_get(METRIC_PAGES_TRUNCATED) > 0)
+        printf("Pages truncated: %ld\n", metrics_get(METRIC_PAGES_TRUNCATED));
+    if (metrics_get(METRIC_BYTES_DECODED) > 0)
+        printf("Transferred: %.1f MB for %.1f MB decoded\n", metrics_get(METRIC_BYTES_DOWNLOADED) / 1048576.0,
+               metrics_get(METRIC_BYTES_DECODED) / 1048576.0);
+    if (metrics_get(METRIC_CONNECTIONS) > 0)
+        printf("Connections opened: %ld\n", metrics_get(METRIC_CONNECTIONS));
+    if (metrics_get(METRIC_DNS_PREFETCHED) > 0)
+        printf("Host names prefetched: %ld, used by %ld fetches\n", metrics_get(METRIC_DNS_PREFETCHED),
+               metrics_get(METRIC_DNS_CACHE_HITS));
+    printf("Errors: %ld\n", metrics_get(METRIC_ERRORS));
+    if (log_dropped() > 0)
+        printf("Log messages dropped: %lu\n", log_dropped());
+    printf("Time elapsed: %.2f seconds\n", elapsed);
+    if (elapsed > 0)
+    {
+        printf("Average pages/second: %.2f\n", pages_crawled / elapsed);
+    }
+
+    hosts_print_skip_report(stdout);
+    hosts_print_trap_report(stdout);
+    hosts_print_concurrency_report(stdout);
+    hosts_print_transfer_report(stdout);
+    lockstat_print_report(stdout);
+}
@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include "../include/lockstat.h"
 #include "../include/threads.h"
 
 // Create a new work item
@@ -43,11 +44,11 @@ static void *worker(void *arg)
 
     while (1)
     {
-        pthread_mutex_lock(&pool->work_mutex);
+        lock_acquire(&pool->work_mutex, LOCK_WORK_QUEUE);
 
         while (pool->work_first == NULL && !pool->stop)
         {
-            pthread_cond_wait(&pool->work_cond, &pool->work_mutex);
+            lock_cond_wait(&pool->work_cond, &pool->work_mutex, LOCK_WORK_QUEUE);
         }
 
         if (pool->stop)
@@ -55,7 +56,7 @@ static void *worker(void *arg)
 
         work = work_get(pool);
         pool->working_count++;
-        pthread_mutex_unlock(&pool->work_mutex);
+        lock_release(&pool->work_mutex, LOCK_WORK_QUEUE);
 
         if (work)
         {
@@ -63,18 +64,18 @@ static void *worker(void *arg)
             free(work);
         }
 
-        pthread_mutex_lock(&pool->work_mutex);
+        lock_acquire(&pool->work_mutex, LOCK_WORK_QUEUE);
         pool->working_count--;
         if (!pool->stop && pool->working_count == 0 && pool->work_first == NULL)
         {
             pthread_cond_signal(&pool->working_cond);
         }
-        pthread_mutex_unlock(&pool->work_mutex);
+        lock_release(&pool->work_mutex, LOCK_WORK_QUEUE);
     }
 
     pool->thread_count--;
     pthread_cond_signal(&pool->working_cond);
-    pthread_mutex_unlock(&pool->work_mutex);
+    lock_release(&pool->work_mutex, LOCK_WORK_QUEUE);
     return NULL;
 }
 
@@ -114,10 +115,10 @@ void thread_pool_destroy(ThreadPool *pool)
     if (!pool)
         return;
 
-    pthread_mutex_lock(&pool->work_mutex);
+    lock_acquire(&pool->work_mutex, LOCK_WORK_QUEUE);
     pool->stop = true;
     pthread_cond_broadcast(&pool->work_cond);
-    pthread_mutex_unlock(&pool->work_mutex);
+    lock_release(&pool->work_mutex, LOCK_WORK_QUEUE);
 
     for (size_t i = 0; i < pool->thread_count; i++)
     {
@@ -139,7 +140,7 @@ bool thread_pool_add_work(ThreadPool *pool, void (*func)(void *), void *arg)
     if (!work)
         return false;
 
-    pthread_mutex_lock(&pool->work_mutex);
+    lock_acquire(&pool->work_mutex, LOCK_WORK_QUEUE);
     if (pool->work_first == NULL)
     {
         pool->work_first = work;
@@ -152,7 +153,7 @@ bool thread_pool_add_work(ThreadPool *pool, void (*func)(void *), void *arg)
     }
 
     pthread_cond_broadcast(&pool->work_cond);
-    pthread_mutex_unlock(&pool->work_mutex);
+    lock_release(&pool->work_mutex, LOCK_WORK_QUEUE);
 
     return true;
 }
@@ -160,14 +161,25 @@ bool thread_pool_add_work(ThreadPool *pool, void (*func)(void *), void *arg)
 // Wait for all work to complete
 void thread_pool_wait(ThreadPool *pool)
 {
-    pthread_mutex_lock(&pool->work_mutex);
+    lock_acquire(&pool->work_mutex, LOCK_WORK_QUEUE);
     while (pool->work_first != NULL ||
            (!pool->stop && pool->working_count != 0) ||
            (pool->stop && pool->thread_count != 0))
     {
-        pthread_cond_wait(&pool->working_cond, &pool->work_mutex);
+        lock_cond_wait(&pool->working_cond, &pool->work_mutex, LOCK_WORK_QUEUE);
     }
-    pthread_mutex_unlock(&pool->work_mutex);
+    lock_release(&pool->work_mutex, LOCK_WORK_QUEUE);
+}
+
+// Count work items queued or running
+size_t thread_pool_pending(ThreadPool *pool)
+{
+    lock_acquire(&pool->work_mutex, LOCK_WORK_QUEUE);
+    size_t pending = pool->working_count;
+    for (Work *work = pool->work_first; work; work = work->next)
+        pending++;
+    lock_release(&pool->work_mutex, LOCK_WORK_QUEUE);
+    return pending;
 }
 
 // Check if thread pool has active work
@@ -176,9 +188,9 @@ bool thread_pool_is_working(ThreadPool *pool)
     if (!pool)
         return false;
 
-    pthread_mutex_lock(&pool->work_mutex);
+    lock_acquire(&pool->work_mutex, LOCK_WORK_QUEUE);
     bool is_working = (pool->working_count > 0 || pool->work_first != NULL);
-    pthread_mutex_unlock(&pool->work_mutex);
+    lock_release(&pool->work_mutex, LOCK_WORK_QUEUE);
 
     return is_working;
 }
\ No newline at end of file
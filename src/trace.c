@@ -0,0 +1,333 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/config.h"
+#include "../include/crawler.h"
+#include "../include/lockstat.h"
+#include "../include/metrics.h"
+#include "../include/trace.h"
+
+// One thread's records. Only the owning thread writes; head counts records
+// ever published and is read by the exporters once the workers are done.
+typedef struct
+{
+    TraceRecord records[TRACE_RING_SIZE];
+    unsigned long head;
+} TraceRing;
+
+static int enabled = 0;
+static TraceRing *rings[TRACE_MAX_THREADS];
+static int next_ring = 0;
+static long long trace_epoch_us = 0;
+
+static __thread TraceRing *thread_ring = NULL;
+static __thread int thread_index = -1;
+static __thread TraceRecord *current = NULL;
+
+int trace_enable(void)
+{
+    enabled = 1;
+    trace_epoch_us = metrics_now_us();
+    lockstat_enable(LOCKSTAT_TRACE_WAITS);
+    return 1;
+}
+
+int trace_is_enabled(void)
+{
+    return enabled;
+}
+
+// The calling thread's ring, allocated on first use. Threads beyond
+// TRACE_MAX_THREADS are not traced.
+static TraceRing *get_ring(void)
+{
+    if (thread_ring || thread_index >= TRACE_MAX_THREADS)
+        return thread_ring;
+
+    thread_index = __atomic_fetch_add(&next_ring, 1, __ATOMIC_RELAXED);
+    if (thread_index >= TRACE_MAX_THREADS)
+        return NULL;
+
+    thread_ring = calloc(1, sizeof(TraceRing));
+    __atomic_store_n(&rings[thread_index], thread_ring, __ATOMIC_RELEASE);
+    return thread_ring;
+}
+
+TraceRecord *trace_begin(const char *url)
+{
+    if (!enabled)
+        return NULL;
+
+    TraceRing *ring = get_ring();
+    if (!ring)
+        return NULL;
+
+    current = &ring->records[ring->head % TRACE_RING_SIZE];
+    memset(current, 0, sizeof(*current));
+    snprintf(current->url, sizeof(current->url), "%s", url);
+    get_url_host(url, current->host, sizeof(current->host));
+    current->start_us = metrics_now_us();
+    current->thread = thread_index;
+    return current;
+}
+
+TraceRecord *trace_current(void)
+{
+    return current;
+}
+
+void trace_set_curl_times(TraceRecord *record, CURL *curl)
+{
+    curl_off_t t;
+
+    if (!record)
+        return;
+
+    if (curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &t) == CURLE_OK)
+        record->namelookup_us = t;
+    if (curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &t) == CURLE_OK)
+        record->connect_us = t;
+    if (curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &t) == CURLE_OK)
+        record->appconnect_us = t;
+    if (curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &t) == CURLE_OK)
+        record->starttransfer_us = t;
+    if (curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &t) == CURLE_OK)
+        record->total_us = t;
+}
+
+void trace_end(void)
+{
+    if (!current)
+        return;
+
+    __atomic_store_n(&thread_ring->head, thread_ring->head + 1, __ATOMIC_RELEASE);
+    current = NULL;
+}
+
+void trace_add_lock_wait(long long usec)
+{
+    if (current)
+        current->lock_wait_us += usec;
+}
+
+// Stage durations derived from the cumulative curl offsets
+typedef enum
+{
+    STAGE_DNS,
+    STAGE_CONNECT,
+    STAGE_TLS,
+    STAGE_TTFB,
+    STAGE_TRANSFER,
+    STAGE_PARSE,
+    STAGE_DB,
+    STAGE_LOCK_WAIT,
+    STAGE_COUNT
+} TraceStage;
+
+static const char *STAGE_NAMES[STAGE_COUNT] = {
+    "dns", "connect", "tls", "ttfb", "transfer", "parse", "db", "lock_wait"};
+
+static long long clamp(long long value)
+{
+    return value > 0 ? value : 0;
+}
+
+static void get_stages(const TraceRecord *r, long long stages[STAGE_COUNT])
+{
+    long long handshake_end = r->appconnect_us > r->connect_us ? r->appconnect_us : r->connect_us;
+
+    stages[STAGE_DNS] = clamp(r->namelookup_us);
+    stages[STAGE_CONNECT] = clamp(r->connect_us - r->namelookup_us);
+    stages[STAGE_TLS] = r->appconnect_us > 0 ? clamp(r->appconnect_us - r->connect_us) : 0;
+    stages[STAGE_TTFB] = clamp(r->starttransfer_us - handshake_end);
+    stages[STAGE_TRANSFER] = clamp(r->total_us - r->starttransfer_us);
+    stages[STAGE_PARSE] = r->parse_us;
+    stages[STAGE_DB] = r->db_us;
+    stages[STAGE_LOCK_WAIT] = r->lock_wait_us;
+}
+
+// Copy every published record into one array; caller frees
+static TraceRecord *collect_records(size_t *count)
+{
+    size_t total = 0;
+    for (int i = 0; i < TRACE_MAX_THREADS; i++)
+    {
+        TraceRing *ring = __atomic_load_n(&rings[i], __ATOMIC_ACQUIRE);
+        if (ring)
+        {
+            unsigned long head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+            total += head < TRACE_RING_SIZE ? head : TRACE_RING_SIZE;
+        }
+    }
+
+    *count = 0;
+    if (total == 0)
+        return NULL;
+
+    TraceRecord *all = malloc(total * sizeof(TraceRecord));
+    if (!all)
+        return NULL;
+
+    for (int i = 0; i < TRACE_MAX_THREADS; i++)
+    {
+        TraceRing *ring = __atomic_load_n(&rings[i], __ATOMIC_ACQUIRE);
+        if (!ring)
+            continue;
+
+        unsigned long head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        unsigned long first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+        for (unsigned long n = first; n < head && *count < total; n++)
+            all[(*count)++] = ring->records[n % TRACE_RING_SIZE];
+    }
+    return all;
+}
+
+static void write_json_string(FILE *f, const char *s)
+{
+    fputc('"', f);
+    for (; *s; s++)
+    {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\')
+            fprintf(f, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(f, "\\u%04x", c);
+        else
+            fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+static void write_event(FILE *f, int *first, const char *name, int tid, long long ts, long long dur)
+{
+    fprintf(f, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld}",
+            *first ? "" : ",", name, tid, ts, dur);
+    *first = 0;
+}
+
+// Chrome trace-event JSON, loadable in chrome://tracing or Perfetto. Each URL
+// is one event on its worker's track with its stages nested beneath it.
+// Parsing and storage calls interleave, so they are drawn back to back.
+int trace_write_chrome(const char *path)
+{
+    size_t count;
+    TraceRecord *records = collect_records(&count);
+
+    FILE *f = fopen(path, "w");
+    if (!f)
+    {
+        fprintf(stderr, "Failed to open trace file %s\n", path);
+        free(records);
+        return 0;
+    }
+
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    int first = 1;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const TraceRecord *r = &records[i];
+        long long stages[STAGE_COUNT];
+        get_stages(r, stages);
+
+        long long ts = r->start_us - trace_epoch_us;
+        long long dur = r->total_us + r->parse_us + r->db_us;
+
+        fprintf(f, "%s\n{\"name\":", first ? "" : ",");
+        write_json_string(f, r->url);
+        fprintf(f, ",\"cat\":\"url\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld,"
+                   "\"args\":{\"host\":",
+                r->thread, ts, dur);
+        write_json_string(f, r->host);
+        fprintf(f, ",\"status\":%ld,\"bytes\":%zu,\"lock_wait_us\":%lld}}",
+                r->response_code, r->bytes, r->lock_wait_us);
+        first = 0;
+
+        // Network stages in transfer order, then processing
+        long long offset = ts;
+        for (int s = STAGE_DNS; s <= STAGE_DB; s++)
+        {
+            if (stages[s] > 0)
+                write_event(f, &first, STAGE_NAMES[s], r->thread, offset, stages[s]);
+            offset += stages[s];
+        }
+    }
+
+    fprintf(f, "\n]}\n");
+    int ok = fclose(f) == 0;
+    free(records);
+
+    if (ok)
+        printf("Wrote %zu trace records to %s\n", count, path);
+    return ok;
+}
+
+static int compare_by_host(const void *a, const void *b)
+{
+    return strcmp(((const TraceRecord *)a)->host, ((const TraceRecord *)b)->host);
+}
+
+static int compare_long_long(const void *a, const void *b)
+{
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of a sorted array
+static long long percentile(const long long *sorted, size_t n, int pct)
+{
+    size_t rank = (n * pct + 99) / 100;
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+void trace_print_host_summary(FILE *out)
+{
+    size_t count;
+    TraceRecord *records = collect_records(&count);
+    if (!records)
+        return;
+
+    qsort(records, count, sizeof(TraceRecord), compare_by_host);
+
+    long long *values = malloc(count * sizeof(long long));
+    if (!values)
+    {
+        free(records);
+        return;
+    }
+
+    fprintf(out, "\n=== Latency by Host (ms) ===\n");
+
+    size_t start = 0;
+    while (start < count)
+    {
+        size_t end = start;
+        while (end < count && strcmp(records[end].host, records[start].host) == 0)
+            end++;
+        size_t n = end - start;
+
+        fprintf(out, "%s (%zu requests)\n", records[start].host[0] ? records[start].host : "(none)", n);
+        fprintf(out, "  %-10s %9s %9s %9s %9s\n", "stage", "p50", "p90", "p99", "max");
+
+        for (int s = 0; s < STAGE_COUNT; s++)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                long long stages[STAGE_COUNT];
+                get_stages(&records[start + i], stages);
+                values[i] = stages[s];
+            }
+            qsort(values, n, sizeof(long long), compare_long_long);
+
+            fprintf(out, "  %-10s %9.2f %9.2f %9.2f %9.2f\n", STAGE_NAMES[s],
+                    percentile(values, n, 50) / 1000.0, percentile(values, n, 90) / 1000.0,
+                    percentile(values, n, 99) / 1000.0, values[n - 1] / 1000.0);
+        }
+        start = end;
+    }
+
+    free(values);
+    free(records);
+}